@@ -162,6 +162,88 @@ STATIC EFI_STATUS EFIAPI vdisk_decompress_vdisk(IN EFI_LOADED_IMAGE_PROTOCOL *pI
     return EFI_SUCCESS;
 }
 
+STATIC EFI_STATUS EFIAPI vdisk_find_raw_disk(IN EFI_HANDLE ImageHandle)
+{
+    UINTN i = 0;
+    UINTN Count = 0;
+    UINT64 DiskSize = 0;
+    UINT8 *pBuffer = NULL;
+    EFI_HANDLE *Handles;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_BLOCK_IO_PROTOCOL *pBlockIo;
+
+    pBuffer = AllocatePool(4096);
+    if (!pBuffer)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = gBS->LocateHandleBuffer(ByProtocol, &gEfiBlockIoProtocolGuid,
+                                     NULL, &Count, &Handles);
+    if (EFI_ERROR(Status))
+    {
+        FreePool(pBuffer);
+        return Status;
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        Status = gBS->HandleProtocol(Handles[i], &gEfiBlockIoProtocolGuid, (VOID **)&pBlockIo);
+        if (EFI_ERROR(Status))
+        {
+            continue;
+        }
+
+        DiskSize = MultU64x32(pBlockIo->Media->LastBlock + 1, pBlockIo->Media->BlockSize);
+        if (g_vdisk_chain->disk_size != DiskSize ||
+            g_vdisk_chain->disk_sector_size != pBlockIo->Media->BlockSize)
+        {
+            continue;
+        }
+
+        Status = pBlockIo->ReadBlocks(pBlockIo, pBlockIo->Media->MediaId, 0, pBlockIo->Media->BlockSize, pBuffer);
+        if (EFI_ERROR(Status))
+        {
+            debug("ReadBlocks failed %r", Status);
+            continue;
+        }
+
+        if (CompareMem(g_vdisk_chain->disk_guid, pBuffer + 0x180, 16) == 0 &&
+            CompareMem(g_vdisk_chain->disk_signature, pBuffer + 0x1b8, 4) == 0)
+        {
+            gVDiskBlockData.RawBlockIoHandle = Handles[i];
+            gVDiskBlockData.pRawBlockIo = pBlockIo;
+            gVDiskBlockData.pDiskDevPath = NULL;
+            gBS->OpenProtocol(Handles[i], &gEfiDevicePathProtocolGuid,
+                              (VOID **)&(gVDiskBlockData.pDiskDevPath),
+                              ImageHandle,
+                              Handles[i],
+                              EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+
+            if (gVDiskBlockData.pDiskDevPath)
+            {
+                debug("Find Ventoy Disk Handle:%p DP:%s", Handles[i],
+                    ConvertDevicePathToText(gVDiskBlockData.pDiskDevPath, FALSE, FALSE));
+            }
+            else
+            {
+                debug("Find Ventoy Disk Handle:%p without device path", Handles[i]);
+            }
+            break;
+        }
+    }
+
+    FreePool(Handles);
+    FreePool(pBuffer);
+
+    if (i >= Count)
+    {
+        return EFI_NOT_FOUND;
+    }
+
+    return EFI_SUCCESS;
+}
+
 STATIC EFI_STATUS vdisk_patch_vdisk_path(CHAR16 *pos)
 {
     UINTN i;
@@ -300,6 +382,37 @@ STATIC EFI_STATUS EFIAPI vdisk_parse_cmdline(IN EFI_HANDLE ImageHandle)
     debug("cmdline:<%s>", pCmdLine);
     vdisk_debug_pause();
 
+    /*
+     * uncompressed vdisk file, read from the ventoy disk on demand
+     * (built by vt_vdisk_chain_data in grub).
+     * Here the block device is the user's vdisk itself, not the embedded
+     * boot template, so there is no vdisk path to fill by vdisk_patch_vdisk_path.
+     */
+    Pos = StrStr(pCmdLine, L"vdisk_chain=");
+    if (Pos)
+    {
+        g_vdisk_chain = (vdisk_chain_head *)StrHexToUintn(Pos + StrLen(L"vdisk_chain="));
+        debug("vdisk_chain:%p", g_vdisk_chain);
+
+        Status = vdisk_find_raw_disk(ImageHandle);
+        if (EFI_ERROR(Status))
+        {
+            VDiskDebug("Ventoy disk not found %r\n", Status);
+        }
+        else
+        {
+            Status = vdisk_stream_init();
+        }
+
+        if (!EFI_ERROR(Status) && StrStr(pCmdLine, L"secureboot=off"))
+        {
+            vdisk_disable_secure_boot(ImageHandle);
+        }
+
+        FreePool(pCmdLine);
+        return Status;
+    }
+
     Pos = StrStr(pCmdLine, L"vdisk=");
     if (NULL == Pos || NULL == StrStr(pCmdLine, L".vtoy"))
     {
@@ -457,6 +570,8 @@ EFI_STATUS EFIAPI VDiskChainEfiMain
             &gEfiDevicePathProtocolGuid, gVDiskBlockData.Path,
             NULL);
 
+    vdisk_stream_fini();
+
     if (EFI_NOT_FOUND == Status)
     {
         gST->ConOut->OutputString(gST->ConOut, L"No bootfile found for UEFI!\r\n");
@@ -23,6 +23,10 @@
 
 #define VDISK_MAGIC_LEN  32
 
+/* streaming mode read cache */
+#define VDISK_CACHE_BLOCK  (64 * 1024)
+#define VDISK_CACHE_NUM    32
+
 #define VDISK_BLOCK_DEVICE_PATH_GUID					\
 	{ 0x6ed2134e, 0xc2ea, 0x4943, { 0x99, 0x54, 0xa7, 0x76, 0xe5, 0x9c, 0x12, 0xc3 }}
 
@@ -41,6 +45,35 @@
   #error Unknown Processor Type
 #endif
 
+#pragma pack(1)
+
+/*
+ * Streaming mode (vdisk_chain=0xADDR on the cmdline).
+ * The loader passes the physical location of an uncompressed vdisk file
+ * and the vdisk is read from the ventoy disk on demand instead of being
+ * kept in memory.
+ */
+typedef struct vdisk_chain_head
+{
+    UINT8  disk_guid[16];       /* ventoy disk MBR 0x180 */
+    UINT8  disk_signature[4];   /* ventoy disk MBR 0x1b8 */
+    UINT64 disk_size;           /* ventoy disk size in bytes */
+    UINT32 disk_sector_size;    /* ventoy disk sector size */
+
+    UINT64 vdisk_size;          /* virtual disk size in bytes */
+    UINT32 chunk_offset;        /* vdisk_chunk array offset from this head */
+    UINT32 chunk_num;           /* sorted by vdisk_start_sector */
+}vdisk_chain_head;
+
+typedef struct vdisk_chunk
+{
+    UINT64 vdisk_start_sector;  /* 512 bytes sector in vdisk */
+    UINT64 vdisk_end_sector;
+    UINT64 disk_start_sector;   /* disk_sector_size sector in ventoy disk */
+}vdisk_chunk;
+
+#pragma pack()
+
 typedef struct vdisk_block_data 
 {
 	EFI_HANDLE Handle;
@@ -89,6 +122,11 @@ EFI_STATUS EFIAPI vdisk_block_io_read
 
 extern UINT8 *g_disk_buf_addr;
 extern UINT64 g_disk_buf_size;
+extern BOOLEAN gVDiskStream;
+extern vdisk_chain_head *g_vdisk_chain;
+extern vdisk_chunk *g_vdisk_chunk;
+EFI_STATUS EFIAPI vdisk_stream_init(VOID);
+VOID EFIAPI vdisk_stream_fini(VOID);
 extern vdisk_block_data gVDiskBlockData;
 EFI_STATUS EFIAPI vdisk_install_blockio(IN EFI_HANDLE ImageHandle, IN UINT64 ImgSize);
 int vdisk_get_vdisk_raw(UINT8 **buf, UINT32 *size);
@@ -39,6 +39,232 @@
 /* EFI block device vendor device path GUID */
 EFI_GUID gVDiskBlockDevicePathGuid = VDISK_BLOCK_DEVICE_PATH_GUID;
 
+BOOLEAN gVDiskStream = FALSE;
+vdisk_chain_head *g_vdisk_chain = NULL;
+vdisk_chunk *g_vdisk_chunk = NULL;
+
+STATIC UINT8 *g_vdisk_cache_buf = NULL;
+STATIC UINT64 g_vdisk_cache_tag[VDISK_CACHE_NUM];
+STATIC UINT64 g_vdisk_cache_stamp[VDISK_CACHE_NUM];
+STATIC UINT64 g_vdisk_stamp = 0;
+STATIC UINT64 g_vdisk_cache_hit = 0;
+STATIC UINT64 g_vdisk_cache_miss = 0;
+STATIC UINT64 g_vdisk_direct = 0;
+
+/* first chunk whose end is not before Sector, chunk_num if none */
+STATIC UINT32 vdisk_find_chunk(IN UINT64 Sector)
+{
+    UINT32 Low = 0;
+    UINT32 Mid = 0;
+    UINT32 High = g_vdisk_chain->chunk_num;
+
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (g_vdisk_chunk[Mid].vdisk_end_sector < Sector)
+        {
+            Low = Mid + 1;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+
+    return Low;
+}
+
+/*
+ * Read vdisk [Offset, Offset + Size) from the ventoy disk.
+ * Offset and Size must be aligned to the ventoy disk sector size.
+ * Areas not covered by any chunk (holes, after the end) read as zero.
+ */
+STATIC EFI_STATUS vdisk_stream_read_raw(IN UINT64 Offset, IN UINTN Size, OUT UINT8 *Buffer)
+{
+    UINT32 i = 0;
+    UINTN Len = 0;
+    UINT64 Sector = 0;
+    UINT64 ChunkStart = 0;
+    UINT64 ChunkEnd = 0;
+    UINT64 End = Offset + Size;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gVDiskBlockData.pRawBlockIo;
+
+    while (Offset < End)
+    {
+        Sector = DivU64x32(Offset, 512);
+        i = vdisk_find_chunk(Sector);
+
+        if (i >= g_vdisk_chain->chunk_num || g_vdisk_chunk[i].vdisk_start_sector > Sector)
+        {
+            ChunkEnd = (i >= g_vdisk_chain->chunk_num) ? End : MultU64x32(g_vdisk_chunk[i].vdisk_start_sector, 512);
+            Len = (UINTN)(((ChunkEnd < End) ? ChunkEnd : End) - Offset);
+            SetMem(Buffer, Len, 0);
+        }
+        else
+        {
+            ChunkStart = MultU64x32(g_vdisk_chunk[i].vdisk_start_sector, 512);
+            ChunkEnd = MultU64x32(g_vdisk_chunk[i].vdisk_end_sector + 1, 512);
+            Len = (UINTN)(((ChunkEnd < End) ? ChunkEnd : End) - Offset);
+
+            Status = pRawBlockIo->ReadBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
+                g_vdisk_chunk[i].disk_start_sector + DivU64x32(Offset - ChunkStart, g_vdisk_chain->disk_sector_size),
+                Len, Buffer);
+            if (EFI_ERROR(Status))
+            {
+                debug("raw read %lu %lu failed %r", Offset, (UINT64)Len, Status);
+                return Status;
+            }
+        }
+
+        Buffer += Len;
+        Offset += Len;
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC UINT8 * vdisk_cache_get(IN UINT64 Block)
+{
+    UINT32 i = 0;
+    UINT32 Slot = 0;
+    UINT8 *pData = NULL;
+
+    for (i = 0; i < VDISK_CACHE_NUM; i++)
+    {
+        if (g_vdisk_cache_tag[i] == Block)
+        {
+            Slot = i;
+            break;
+        }
+
+        if (g_vdisk_cache_stamp[i] < g_vdisk_cache_stamp[Slot])
+        {
+            Slot = i;
+        }
+    }
+
+    pData = g_vdisk_cache_buf + Slot * VDISK_CACHE_BLOCK;
+    if (i < VDISK_CACHE_NUM)
+    {
+        g_vdisk_cache_hit++;
+    }
+    else
+    {
+        g_vdisk_cache_miss++;
+        g_vdisk_cache_tag[Slot] = MAX_UINT64;
+        if (EFI_ERROR(vdisk_stream_read_raw(MultU64x32(Block, VDISK_CACHE_BLOCK), VDISK_CACHE_BLOCK, pData)))
+        {
+            return NULL;
+        }
+        g_vdisk_cache_tag[Slot] = Block;
+    }
+
+    g_vdisk_cache_stamp[Slot] = ++g_vdisk_stamp;
+    return pData;
+}
+
+STATIC EFI_STATUS vdisk_stream_read(IN EFI_LBA Lba, IN UINTN BufferSize, OUT UINT8 *Buffer)
+{
+    UINT32 Pos = 0;
+    UINTN Len = 0;
+    UINT64 Block = 0;
+    UINT64 Offset = MultU64x32(Lba, 512);
+    UINT64 End = Offset + BufferSize;
+    UINT8 *pData = NULL;
+    UINT32 SectorSize = g_vdisk_chain->disk_sector_size;
+    UINT32 IoAlign = gVDiskBlockData.pRawBlockIo->Media->IoAlign;
+
+    /* large aligned reads bypass the cache */
+    if (BufferSize >= VDISK_CACHE_BLOCK && (Offset % SectorSize) == 0 && (BufferSize % SectorSize) == 0 &&
+        (IoAlign <= 1 || ((UINTN)Buffer & (IoAlign - 1)) == 0))
+    {
+        g_vdisk_direct++;
+        return vdisk_stream_read_raw(Offset, BufferSize, Buffer);
+    }
+
+    while (Offset < End)
+    {
+        Block = DivU64x32Remainder(Offset, VDISK_CACHE_BLOCK, &Pos);
+        Len = VDISK_CACHE_BLOCK - Pos;
+        if (Len > End - Offset)
+        {
+            Len = (UINTN)(End - Offset);
+        }
+
+        pData = vdisk_cache_get(Block);
+        if (!pData)
+        {
+            return EFI_DEVICE_ERROR;
+        }
+
+        CopyMem(Buffer, pData + Pos, Len);
+        Buffer += Len;
+        Offset += Len;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI vdisk_stream_init(VOID)
+{
+    UINT32 i = 0;
+    UINT32 SectorSize = g_vdisk_chain->disk_sector_size;
+
+    if (SectorSize < 512 || (VDISK_CACHE_BLOCK % SectorSize) || (SectorSize % 512) ||
+        g_vdisk_chain->vdisk_size < 512 || g_vdisk_chain->chunk_num == 0)
+    {
+        debug("invalid vdisk chain %u %lu %u", SectorSize, g_vdisk_chain->vdisk_size, g_vdisk_chain->chunk_num);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    /* every chunk must start and end on a ventoy disk sector boundary */
+    g_vdisk_chunk = (vdisk_chunk *)((UINT8 *)g_vdisk_chain + g_vdisk_chain->chunk_offset);
+    for (i = 0; i < g_vdisk_chain->chunk_num; i++)
+    {
+        if (g_vdisk_chunk[i].vdisk_end_sector < g_vdisk_chunk[i].vdisk_start_sector ||
+            (i > 0 && g_vdisk_chunk[i].vdisk_start_sector <= g_vdisk_chunk[i - 1].vdisk_end_sector) ||
+            (MultU64x32(g_vdisk_chunk[i].vdisk_start_sector, 512) % SectorSize) ||
+            (MultU64x32(g_vdisk_chunk[i].vdisk_end_sector + 1, 512) % SectorSize))
+        {
+            debug("invalid vdisk chunk %u", i);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    g_vdisk_cache_buf = AllocatePages(EFI_SIZE_TO_PAGES(VDISK_CACHE_BLOCK * VDISK_CACHE_NUM));
+    if (!g_vdisk_cache_buf)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (i = 0; i < VDISK_CACHE_NUM; i++)
+    {
+        g_vdisk_cache_tag[i] = MAX_UINT64;
+        g_vdisk_cache_stamp[i] = 0;
+    }
+
+    g_disk_buf_size = g_vdisk_chain->vdisk_size;
+    gVDiskStream = TRUE;
+
+    debug("vdisk stream size:%lu chunk:%u sector:%u", g_disk_buf_size, g_vdisk_chain->chunk_num, SectorSize);
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI vdisk_stream_fini(VOID)
+{
+    if (!gVDiskStream)
+    {
+        return;
+    }
+
+    debug("vdisk cache hit:%lu miss:%lu direct:%lu", g_vdisk_cache_hit, g_vdisk_cache_miss, g_vdisk_direct);
+
+    FreePages(g_vdisk_cache_buf, EFI_SIZE_TO_PAGES(VDISK_CACHE_BLOCK * VDISK_CACHE_NUM));
+    g_vdisk_cache_buf = NULL;
+    gVDiskStream = FALSE;
+}
+
 EFI_STATUS EFIAPI vdisk_block_io_reset 
 (
     IN EFI_BLOCK_IO_PROTOCOL          *This,
@@ -69,6 +295,12 @@ EFI_STATUS EFIAPI vdisk_block_io_read
     (VOID)MediaId;
 
     debug("vdisk_block_io_read %lu %lu\n", Lba, BufferSize / 512);
+
+    if (gVDiskStream)
+    {
+        return vdisk_stream_read(Lba, BufferSize, Buffer);
+    }
+
     CopyMem(Buffer, g_disk_buf_addr + (Lba * 512), BufferSize);
 
     return EFI_SUCCESS;
@@ -32,6 +32,7 @@
 #include <Guid/FileInfo.h>
 #include <Guid/FileSystemInfo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/RamDisk.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/DriverBinding.h>
@@ -46,6 +47,7 @@ ventoy_ram_disk g_ramdisk_param;
 ventoy_chain_head *g_chain;
 void *g_vtoy_img_location_buf;
 ventoy_img_chunk *g_chunk;
+STATIC ventoy_img_chunk *g_chunk_map_buf = NULL;
 UINT8 *g_os_param_reserved;
 UINT32 g_img_chunk_num;
 ventoy_override_chunk *g_override_chunk;
@@ -128,6 +130,118 @@ VOID EFIAPI ventoy_clear_input(VOID)
     gST->ConIn->Reset(gST->ConIn, FALSE);
 }
 
+STATIC INT32 ventoy_chunk_map_get(UINT8 *data, UINT32 size, UINT32 *pos, UINT64 *value)
+{
+    INT32 shift = 0;
+    UINT8 byte;
+    UINT64 ret = 0;
+
+    do
+    {
+        if (*pos >= size || shift > 63)
+        {
+            return 1;
+        }
+
+        byte = data[(*pos)++];
+        ret |= LShiftU64(byte & 0x7F, shift);
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = ret;
+    return 0;
+}
+
+/*
+ * A heavily fragmented image is passed with the compact chunk map.
+ * Memory is not so limited here, so just decode it to a plain array.
+ */
+STATIC EFI_STATUS ventoy_decode_chunk_map(VOID)
+{
+    UINT32 i = 0;
+    UINT32 j = 0;
+    UINT32 pos = 0;
+    UINT32 img_end = 0;
+    UINT64 disk_end = 0;
+    UINT64 value[5];
+    INT64 disk_gap = 0;
+    INT64 disk_extra = 0;
+    ventoy_img_chunk *chunk = NULL;
+    ventoy_chunk_map_head *head = (ventoy_chunk_map_head *)g_chunk;
+    ventoy_chunk_map_index *index = (ventoy_chunk_map_index *)(head + 1);
+    UINT8 *data = (UINT8 *)(index + head->index_num);
+
+    if (CompareMem(head->magic, VTOY_CHUNK_MAP_MAGIC, sizeof(head->magic)) != 0)
+    {
+        return EFI_SUCCESS;
+    }
+
+    if (head->version != VTOY_CHUNK_MAP_VERSION || head->group_size == 0 || head->chunk_num != g_img_chunk_num)
+    {
+        debug("invalid chunk map %u %u %u", head->version, head->group_size, head->chunk_num);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    chunk = AllocatePool(head->chunk_num * sizeof(ventoy_img_chunk));
+    if (!chunk)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    while (i < head->chunk_num)
+    {
+        /* a record never cross a group */
+        if (i % head->group_size == 0)
+        {
+            if (i / head->group_size >= head->index_num)
+            {
+                goto fail;
+            }
+
+            pos = index[i / head->group_size].data_offset;
+            img_end = index[i / head->group_size].img_start_sector - 1;
+            disk_end = index[i / head->group_size].disk_start_sector - 1;
+        }
+
+        for (j = 0; j < 5; j++)
+        {
+            if (ventoy_chunk_map_get(data, head->data_size, &pos, value + j))
+            {
+                goto fail;
+            }
+        }
+
+        if (value[0] == 0 || value[2] == 0 || value[0] > head->chunk_num - i)
+        {
+            goto fail;
+        }
+
+        disk_gap = (INT64)RShiftU64(value[3], 1) ^ (-(INT64)(value[3] & 1));
+        disk_extra = (INT64)RShiftU64(value[4], 1) ^ (-(INT64)(value[4] & 1));
+
+        for (j = 0; j < (UINT32)value[0]; j++, i++)
+        {
+            chunk[i].img_start_sector = img_end + 1 + (UINT32)value[1];
+            chunk[i].img_end_sector = chunk[i].img_start_sector + (UINT32)value[2] - 1;
+            chunk[i].disk_start_sector = disk_end + 1 + (UINT64)disk_gap;
+            chunk[i].disk_end_sector = chunk[i].disk_start_sector + (UINT64)((INT64)value[2] * 4 + disk_extra) - 1;
+            img_end = chunk[i].img_end_sector;
+            disk_end = chunk[i].disk_end_sector;
+        }
+    }
+
+    debug("chunk map decoded, chunk:%u data:%u", head->chunk_num, head->data_size);
+
+    g_chunk_map_buf = chunk;
+    g_chunk = chunk;
+    return EFI_SUCCESS;
+
+fail:
+    debug("chunk map decode failed at %u", i);
+    FreePool(chunk);
+    return EFI_INVALID_PARAMETER;
+}
+
 static void EFIAPI ventoy_dump_img_chunk(ventoy_chain_head *chain)
 {
     UINT32 i;
@@ -135,11 +249,12 @@ static void EFIAPI ventoy_dump_img_chunk(ventoy_chain_head *chain)
     UINT64 img_sec = 0;
     ventoy_img_chunk *chunk;
 
-    chunk = (ventoy_img_chunk *)((char *)chain + chain->img_chunk_offset);
+    (VOID)chain;
+    chunk = g_chunk;
 
     debug("##################### ventoy_dump_img_chunk #######################");
 
-    for (i = 0; i < chain->img_chunk_num; i++)
+    for (i = 0; i < g_img_chunk_num; i++)
     {
         debug("%2u: [ %u - %u ] <==> [ %llu - %llu ]",
                i, chunk[i].img_start_sector, chunk[i].img_end_sector,
@@ -250,6 +365,8 @@ static void EFIAPI ventoy_dump_chain(ventoy_chain_head *chain)
     debug("chain->img_chunk_num=%u",         chain->img_chunk_num);
     debug("chain->override_chunk_offset=%u", chain->override_chunk_offset);
     debug("chain->override_chunk_num=%u",    chain->override_chunk_num);
+    debug("chain->uefi_cache_size=%u",       chain->uefi_cache_size);
+    debug("chain->io_trace_num=%u",          chain->io_trace_num);
 
     ventoy_debug_pause();
 
@@ -594,6 +711,10 @@ STATIC EFI_STATUS EFIAPI ventoy_find_iso_disk(IN EFI_HANDLE ImageHandle)
 
             gBlockData.RawBlockIoHandle = Handles[i];
             gBlockData.pRawBlockIo = pBlockIo;
+            if (EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiBlockIo2ProtocolGuid, (VOID **)&(gBlockData.pRawBlockIo2))))
+            {
+                gBlockData.pRawBlockIo2 = NULL;
+            }
             gBS->OpenProtocol(Handles[i], &gEfiDevicePathProtocolGuid,
                               (VOID **)&(gBlockData.pDiskDevPath),
                               ImageHandle,
@@ -971,6 +1092,29 @@ STATIC EFI_STATUS EFIAPI ventoy_parse_cmdline(IN EFI_HANDLE ImageHandle)
         g_chain = chain;
         g_os_param_reserved = (UINT8 *)(g_chain->os_param.vtoy_reserved);
         gMemdiskMode = TRUE;
+
+        if (CompareMem(g_iso_data_buf, VTOY_CMEM_MAGIC, 8) == 0)
+        {
+            if (EFI_ERROR(ventoy_cmem_init(g_iso_data_buf)))
+            {
+                return EFI_INVALID_PARAMETER;
+            }
+            g_iso_buf_size = (UINTN)((ventoy_cmem_head *)g_iso_data_buf)->img_size;
+        }
+        /* image not loaded by grub, chunk list is after the image area */
+        else if (g_chain->img_chunk_num > 0)
+        {
+            g_chunk = (ventoy_img_chunk *)((char *)g_chain + g_chain->img_chunk_offset);
+            g_img_chunk_num = g_chain->img_chunk_num;
+            if (EFI_ERROR(ventoy_decode_chunk_map()))
+            {
+                return EFI_INVALID_PARAMETER;
+            }
+            ventoy_chunk_index_init();
+
+            gMemdiskLazy = TRUE;
+            debug("lazy memdisk mode chunk:%u", g_img_chunk_num);
+        }
     }
     else
     {
@@ -980,6 +1124,12 @@ STATIC EFI_STATUS EFIAPI ventoy_parse_cmdline(IN EFI_HANDLE ImageHandle)
 
         g_chunk = (ventoy_img_chunk *)((char *)g_chain + g_chain->img_chunk_offset);
         g_img_chunk_num = g_chain->img_chunk_num;
+        if (EFI_ERROR(ventoy_decode_chunk_map()))
+        {
+            return EFI_INVALID_PARAMETER;
+        }
+        ventoy_chunk_index_init();
+
         g_override_chunk = (ventoy_override_chunk *)((char *)g_chain + g_chain->override_chunk_offset);
         g_override_chunk_num = g_chain->override_chunk_num;
         g_virt_chunk = (ventoy_virt_chunk *)((char *)g_chain + g_chain->virt_chunk_offset);
@@ -1042,8 +1192,14 @@ STATIC EFI_STATUS EFIAPI ventoy_parse_cmdline(IN EFI_HANDLE ImageHandle)
 
 EFI_STATUS EFIAPI ventoy_clean_env(VOID)
 {
-    FreePool(g_sector_flag);
-    g_sector_flag_num = 0;
+    ventoy_dump_chunk_stat();
+    ventoy_dump_cache_stat();
+    ventoy_dump_bounce_stat();
+    ventoy_dump_trace_stat();
+
+    ventoy_free_range_index();
+    ventoy_cache_free();
+    ventoy_bounce_free();
 
     if (gLoadIsoEfi && gBlockData.IsoDriverImage)
     {
@@ -1054,6 +1210,7 @@ EFI_STATUS EFIAPI ventoy_clean_env(VOID)
 
     gBS->UninstallMultipleProtocolInterfaces(gBlockData.Handle,
             &gEfiBlockIoProtocolGuid, &gBlockData.BlockIo,
+            &gEfiBlockIo2ProtocolGuid, &gBlockData.BlockIo2,
             &gEfiDevicePathProtocolGuid, gBlockData.Path,
             NULL);
 
@@ -1069,6 +1226,12 @@ EFI_STATUS EFIAPI ventoy_clean_env(VOID)
         FreePool(g_chain);
     }
 
+    if (g_chunk_map_buf)
+    {
+        FreePool(g_chunk_map_buf);
+        g_chunk_map_buf = NULL;
+    }
+
     return EFI_SUCCESS;
 }
 
@@ -1240,14 +1403,6 @@ EFI_STATUS EFIAPI VentoyEfiMain
     EFI_STATUS Status = EFI_SUCCESS;
     EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL *Protocol;
 
-    g_sector_flag_num = 512; /* initial value */
-
-    g_sector_flag = AllocatePool(g_sector_flag_num * sizeof(ventoy_sector_flag));
-    if (NULL == g_sector_flag)
-    {
-        return EFI_OUT_OF_RESOURCES;
-    }
-
     Status = gBS->HandleProtocol(gST->ConsoleInHandle, &gEfiSimpleTextInputExProtocolGuid, (VOID **)&Protocol);
     if (EFI_SUCCESS == Status)
     {
@@ -1272,24 +1427,57 @@ EFI_STATUS EFIAPI VentoyEfiMain
 
     if (gMemdiskMode)
     {
-        g_ramdisk_param.PhyAddr = (UINT64)(UINTN)g_iso_data_buf;
-        g_ramdisk_param.DiskSize = (UINT64)g_iso_buf_size;
+        /* the OS can't use a compressed memdisk */
+        if (!gMemdiskCompressed)
+        {
+            g_ramdisk_param.PhyAddr = (UINT64)(UINTN)g_iso_data_buf;
+            g_ramdisk_param.DiskSize = (UINT64)g_iso_buf_size;
 
-        ventoy_save_ramdisk_param();
+            ventoy_save_ramdisk_param();
+        }
+
+        if (gMemdiskLazy)
+        {
+            Status = ventoy_find_iso_disk(ImageHandle);
+            if (!EFI_ERROR(Status))
+            {
+                Status = ventoy_memdisk_lazy_start();
+            }
+        }
 
         if (gLoadIsoEfi)
         {
-            ventoy_find_iso_disk(ImageHandle);
+            if (!gMemdiskLazy)
+            {
+                ventoy_find_iso_disk(ImageHandle);
+            }
             ventoy_find_iso_disk_fs(ImageHandle);
             ventoy_load_isoefi_driver(ImageHandle);
         }
 
-        ventoy_install_blockio(ImageHandle, g_iso_buf_size);
-        ventoy_debug_pause();
+        if (!EFI_ERROR(Status))
+        {
+            ventoy_install_blockio(ImageHandle, g_iso_buf_size);
+            ventoy_debug_pause();
 
-        Status = ventoy_boot(ImageHandle);
+            Status = ventoy_boot(ImageHandle);
+        }
 
-        ventoy_delete_ramdisk_param();
+        ventoy_memdisk_lazy_stop();
+        if (gMemdiskCompressed)
+        {
+            ventoy_cmem_fini();
+        }
+        else
+        {
+            ventoy_delete_ramdisk_param();
+        }
+
+        if (g_chunk_map_buf)
+        {
+            FreePool(g_chunk_map_buf);
+            g_chunk_map_buf = NULL;
+        }
 
         if (gLoadIsoEfi && gBlockData.IsoDriverImage)
         {
@@ -1299,6 +1487,7 @@ EFI_STATUS EFIAPI VentoyEfiMain
         gBS->DisconnectController(gBlockData.Handle, NULL, NULL);
         gBS->UninstallMultipleProtocolInterfaces(gBlockData.Handle,
                 &gEfiBlockIoProtocolGuid, &gBlockData.BlockIo,
+                &gEfiBlockIo2ProtocolGuid, &gBlockData.BlockIo2,
                 &gEfiDevicePathProtocolGuid, gBlockData.Path,
                 NULL);
     }
@@ -135,6 +135,9 @@ typedef struct ventoy_chain_head
 
     UINT32 virt_chunk_offset;
     UINT32 virt_chunk_num;
+
+    UINT32 uefi_cache_size; /* UEFI read cache size in KB, 0: disabled */
+    UINT32 io_trace_num;    /* UEFI I/O trace ring entries, 0: disabled */
 }ventoy_chain_head;
 
 
@@ -147,6 +150,47 @@ typedef struct ventoy_img_chunk
     UINT64 disk_end_sector;
 }ventoy_img_chunk;
 
+/* compact image chunk map, same format as grub/ventoy.h in GRUB2 */
+#define VTOY_CHUNK_MAP_MAGIC    "VTOYCMAP"
+#define VTOY_CHUNK_MAP_VERSION  1
+
+typedef struct ventoy_chunk_map_head
+{
+    CHAR8  magic[8];
+    UINT32 version;
+    UINT32 head_size;
+    UINT32 chunk_num;
+    UINT32 group_size;
+    UINT32 index_num;
+    UINT32 data_size;
+}ventoy_chunk_map_head;
+
+typedef struct ventoy_chunk_map_index
+{
+    UINT32 img_start_sector;
+    UINT32 data_offset;
+    UINT64 disk_start_sector;
+}ventoy_chunk_map_index;
+
+/* compressed memdisk, same format as grub/ventoy.h in GRUB2 */
+#define VTOY_CMEM_MAGIC         "VTOYCMEM"
+
+typedef struct ventoy_cmem_head
+{
+    CHAR8  magic[8];
+    UINT32 block_size;
+    UINT32 block_num;
+    UINT64 img_size;
+    UINT64 mem_size;
+}ventoy_cmem_head;
+
+typedef struct ventoy_cmem_block
+{
+    UINT64 addr;
+    UINT32 size;
+    UINT32 reserved;
+}ventoy_cmem_block;
+
 
 typedef struct ventoy_override_chunk
 {
@@ -198,11 +242,102 @@ typedef struct ventoy_virt_chunk
 #define VENTOY_DEVICE_WARN 1
 #define VTOY_WARNING  L"!!!!!!!!!!!!! WARNING !!!!!!!!!!!!!"
 
-typedef struct ventoy_sector_flag
+#define VTOY_VIRT_RANGE_MEM     1
+#define VTOY_VIRT_RANGE_REMAP   2
+
+typedef struct ventoy_virt_range
 {
-    UINT8 flag; // 0:init   1:mem  2:remap
-    UINT64 remap_lba;
-}ventoy_sector_flag;
+    UINT32 start; /* 2048 sector, [start, end) */
+    UINT32 end;
+    UINT32 type;  /* VTOY_VIRT_RANGE_XXX */
+    UINT32 chunk; /* index in g_virt_chunk */
+}ventoy_virt_range;
+
+/* raw disk read cache, LRU of aligned extents */
+#define VTOY_CACHE_EXTENT_SIZE  (64 * 1024)
+#define VTOY_CACHE_RA_MAX       4           /* prefetch up to 256KB */
+#define VTOY_CACHE_MAX_KB       (256 * 1024)
+#define VTOY_CACHE_NONE         MAX_UINT32
+
+/* demand paged memdisk */
+#define VTOY_MEMDISK_BLOCK      (1024 * 1024)
+#define VTOY_MEMDISK_FILL_TICK  100000      /* 10ms, 100ns unit */
+
+/* compressed memdisk */
+#define VTOY_CMEM_LRU_NUM       16
+#define VTOY_CMEM_MAX_BLOCK     (1024 * 1024)
+
+/* aligned bounce buffers for unaligned caller buffers, sorted by size */
+#define VTOY_BOUNCE_SMALL       (64 * 1024)
+#define VTOY_BOUNCE_SMALL_NUM   4
+#define VTOY_BOUNCE_LARGE       (1024 * 1024)
+#define VTOY_BOUNCE_LARGE_NUM   2
+#define VTOY_BOUNCE_NUM         (VTOY_BOUNCE_SMALL_NUM + VTOY_BOUNCE_LARGE_NUM)
+
+/*
+ * I/O trace, enabled by io_trace_num in the chain head.
+ * The buffer address is published in the VentoyIoTrace variable so that
+ * VtoyUtil (feature=io_trace_dump) can save it after the boot returns.
+ * All fields are fixed size so that the dump file can be parsed anywhere.
+ */
+#define VTOY_IO_TRACE_MAGIC     0x434152544F495456ULL /* "VTIOTRAC" */
+#define VTOY_IO_TRACE_VERSION   1
+#define VTOY_IO_TRACE_MAX_NUM   (256 * 1024)
+#define VTOY_IO_HIST_NUM        32
+
+#define VTOY_IO_TRACE_OVERRIDE  0x01    /* override data copied */
+#define VTOY_IO_TRACE_VIRT      0x02    /* virt chunk area read */
+#define VTOY_IO_TRACE_BOUNCE    0x04    /* caller buffer not aligned */
+#define VTOY_IO_TRACE_ERROR     0x08
+#define VTOY_IO_TRACE_ASYNC     0x10    /* BlockIo2 read sent to the raw disk */
+
+#if defined (MDE_CPU_IA32) || defined (MDE_CPU_X64)
+#define ventoy_read_tsc()  AsmReadTsc()
+#else
+#define ventoy_read_tsc()  0
+#endif
+
+typedef struct ventoy_io_trace_entry
+{
+    UINT64 lba;         /* virtual disk block */
+    UINT32 size;        /* bytes */
+    UINT32 time_us;     /* the whole request */
+    UINT32 raw_us;      /* raw disk reads */
+    UINT32 raw_num;     /* raw disk read count */
+    UINT32 chunks;      /* image chunks visited */
+    UINT32 flags;       /* VTOY_IO_TRACE_XXX */
+}ventoy_io_trace_entry;
+
+typedef struct ventoy_io_trace_head
+{
+    UINT64 magic;
+    UINT64 version;
+    UINT64 entry_num;   /* ring size */
+    UINT64 next;        /* requests recorded, the ring wraps at entry_num */
+    UINT64 tsc_per_ms;  /* 0: no time stamp counter, all times are 0 */
+    UINT64 block_size;
+    UINT64 total_bytes;
+    UINT64 total_us;
+    UINT64 raw_us;
+    UINT64 hist_us[VTOY_IO_HIST_NUM];   /* requests by log2 of latency in us */
+    UINT64 hist_kb[VTOY_IO_HIST_NUM];   /* requests by log2 of size in KB */
+}ventoy_io_trace_head;
+
+typedef struct ventoy_bounce_buf
+{
+    UINT8 *data;
+    UINT32 size;
+    BOOLEAN busy;
+}ventoy_bounce_buf;
+
+typedef struct ventoy_cache_slot
+{
+    UINT64 extent; /* raw disk offset / VTOY_CACHE_EXTENT_SIZE, MAX_UINT64: unused */
+    UINT32 prev;   /* LRU list, head is the most recently used */
+    UINT32 next;
+    UINT32 hnext;  /* hash chain */
+    UINT8 *data;
+}ventoy_cache_slot;
 
 
 typedef struct vtoy_block_data
@@ -210,12 +345,14 @@ typedef struct vtoy_block_data
 	EFI_HANDLE Handle;
 	EFI_BLOCK_IO_MEDIA Media;       /* Media descriptor */
 	EFI_BLOCK_IO_PROTOCOL BlockIo;	/* Block I/O protocol */
+	EFI_BLOCK_IO2_PROTOCOL BlockIo2;	/* Block I/O 2 protocol */
 
     UINTN DevicePathCompareLen;
 	EFI_DEVICE_PATH_PROTOCOL *Path;	/* Device path protocol */
 
     EFI_HANDLE RawBlockIoHandle;
     EFI_BLOCK_IO_PROTOCOL *pRawBlockIo;
+    EFI_BLOCK_IO2_PROTOCOL *pRawBlockIo2;  /* NULL if the raw disk doesn't support it */
     EFI_DEVICE_PATH_PROTOCOL *pDiskDevPath;
 
     /* ventoy disk part2 ESP */
@@ -226,6 +363,19 @@ typedef struct vtoy_block_data
     EFI_HANDLE IsoDriverImage;
 }vtoy_block_data;
 
+/* one BlockIo2 read split into raw disk reads, one sub token for each chunk */
+typedef struct ventoy_io2_request
+{
+    EFI_BLOCK_IO2_TOKEN *Token;
+    UINT32 Pending;
+    EFI_STATUS Status;
+    UINT32 SubNum;
+    EFI_LBA Lba;
+    UINTN Size;
+    UINT64 Tsc;
+    EFI_BLOCK_IO2_TOKEN SubToken[1];
+}ventoy_io2_request;
+
 
 #define debug(expr, ...) if (gDebugPrint) VtoyDebug("[VTOY] "expr"\r\n", ##__VA_ARGS__)
 #define trace(expr, ...) VtoyDebug("[VTOY] "expr"\r\n", ##__VA_ARGS__)
@@ -384,6 +534,23 @@ typedef struct DriverBindWrapper
 extern BOOLEAN gDebugPrint;
 VOID EFIAPI VtoyDebug(IN CONST CHAR8  *Format, ...);
 EFI_STATUS EFIAPI ventoy_wrapper_system(VOID);
+VOID EFIAPI ventoy_dump_chunk_stat(VOID);
+VOID EFIAPI ventoy_chunk_index_init(VOID);
+EFI_STATUS EFIAPI ventoy_build_range_index(VOID);
+VOID EFIAPI ventoy_free_range_index(VOID);
+EFI_STATUS EFIAPI ventoy_cache_init(VOID);
+VOID EFIAPI ventoy_cache_free(VOID);
+VOID EFIAPI ventoy_dump_cache_stat(VOID);
+EFI_STATUS EFIAPI ventoy_bounce_init(VOID);
+VOID EFIAPI ventoy_bounce_free(VOID);
+VOID EFIAPI ventoy_dump_bounce_stat(VOID);
+EFI_STATUS EFIAPI ventoy_trace_init(VOID);
+VOID EFIAPI ventoy_dump_trace_stat(VOID);
+EFI_STATUS EFIAPI ventoy_memdisk_lazy_start(VOID);
+VOID EFIAPI ventoy_memdisk_lazy_stop(VOID);
+EFI_STATUS EFIAPI ventoy_cmem_init(IN VOID *Head);
+VOID EFIAPI ventoy_cmem_fini(VOID);
+INT32 EFIAPI ventoy_lz4_decompress(IN CONST UINT8 *Src, IN UINT32 SrcLen, OUT UINT8 *Dst, IN UINT32 DstLen);
 EFI_STATUS EFIAPI ventoy_block_io_read
 (
     IN EFI_BLOCK_IO_PROTOCOL          *This,
@@ -397,6 +564,17 @@ EFI_STATUS EFIAPI ventoy_block_io_read
 extern ventoy_chain_head *g_chain;
 extern ventoy_img_chunk *g_chunk;
 extern UINT32 g_img_chunk_num;
+extern UINT64 g_chunk_lookup_num;
+extern UINT64 g_chunk_probe_num;
+extern UINT64 g_chunk_cursor_hit;
+extern UINT32 g_cache_slot_num;
+extern UINT64 g_cache_hit;
+extern UINT64 g_cache_miss;
+extern UINT64 g_cache_prefetch;
+extern UINT64 g_cache_bypass;
+extern UINT64 g_bounce_read;
+extern UINT64 g_bounce_split;
+extern UINT64 g_bounce_alloc;
 extern ventoy_override_chunk *g_override_chunk;
 extern UINT32 g_override_chunk_num;
 extern ventoy_virt_chunk *g_virt_chunk;
@@ -404,10 +582,10 @@ extern UINT32 g_virt_chunk_num;
 extern vtoy_block_data gBlockData;
 extern ventoy_efi_file_replace g_efi_file_replace;
 extern ventoy_efi_file_replace g_img_file_replace[VTOY_MAX_CONF_REPLACE];
-extern ventoy_sector_flag *g_sector_flag;
-extern UINT32 g_sector_flag_num;
 extern BOOLEAN gMemdiskMode;
 extern BOOLEAN gSector512Mode;
+extern BOOLEAN gMemdiskLazy;
+extern BOOLEAN gMemdiskCompressed;
 extern UINTN g_iso_buf_size;
 extern UINT8 *g_iso_data_buf;
 extern ventoy_grub_param_file_replace *g_file_replace_list;
@@ -32,6 +32,7 @@
 #include <Guid/FileInfo.h>
 #include <Guid/FileSystemInfo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/RamDisk.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/DriverBinding.h>
@@ -227,3 +228,36 @@ EFI_STATUS EFIAPI ventoy_wrapper_system(VOID)
     return EFI_SUCCESS;
 }
 
+
+VOID EFIAPI ventoy_dump_chunk_stat(VOID)
+{
+    UINT64 Avg = 0;
+
+    if (g_chunk_lookup_num > 0)
+    {
+        Avg = DivU64x64Remainder(MultU64x32(g_chunk_probe_num, 100), g_chunk_lookup_num, NULL);
+    }
+
+    debug("chunk lookup:%lu probe:%lu cursor hit:%lu chunk:%u avg probe:%lu.%02lu",
+          g_chunk_lookup_num, g_chunk_probe_num, g_chunk_cursor_hit, g_img_chunk_num,
+          DivU64x32(Avg, 100), ModU64x32(Avg, 100));
+}
+
+VOID EFIAPI ventoy_dump_cache_stat(VOID)
+{
+    UINT64 Total = g_cache_hit + g_cache_miss;
+    UINT64 Rate = 0;
+
+    if (Total > 0)
+    {
+        Rate = DivU64x64Remainder(MultU64x32(g_cache_hit, 100), Total, NULL);
+    }
+
+    debug("read cache slot:%u hit:%lu miss:%lu prefetch:%lu bypass:%lu hit rate:%lu%%",
+          g_cache_slot_num, g_cache_hit, g_cache_miss, g_cache_prefetch, g_cache_bypass, Rate);
+}
+
+VOID EFIAPI ventoy_dump_bounce_stat(VOID)
+{
+    debug("bounce read:%lu split:%lu alloc:%lu", g_bounce_read, g_bounce_split, g_bounce_alloc);
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * VentoyLz4.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef VTOY_LZ4_HOST
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Protocol/LoadedImage.h>
+#include <Guid/FileInfo.h>
+#include <Guid/FileSystemInfo.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+#include <Protocol/RamDisk.h>
+#include <Protocol/SimpleFileSystem.h>
+#include <Protocol/DriverBinding.h>
+#include <Ventoy.h>
+#endif /* VTOY_LZ4_HOST, see vtoycli/lz4bench.c */
+
+/*
+ * LZ4 block format decoder for the compressed memdisk.
+ * Every length and offset is checked, a bad block never writes outside Dst.
+ * Return the decompressed length or -1.
+ */
+INT32 EFIAPI ventoy_lz4_decompress(IN CONST UINT8 *Src, IN UINT32 SrcLen, OUT UINT8 *Dst, IN UINT32 DstLen)
+{
+    UINT8 c = 0;
+    UINT8 Token = 0;
+    UINT32 Len = 0;
+    UINT32 Offset = 0;
+    UINT8 *Ref = NULL;
+    UINT8 *Op = Dst;
+    UINT8 *OpEnd = Dst + DstLen;
+    CONST UINT8 *Ip = Src;
+    CONST UINT8 *IpEnd = Src + SrcLen;
+
+    while (Ip < IpEnd)
+    {
+        Token = *Ip++;
+
+        /* literals */
+        Len = Token >> 4;
+        if (Len == 15)
+        {
+            do
+            {
+                if (Ip >= IpEnd)
+                {
+                    return -1;
+                }
+                c = *Ip++;
+                Len += c;
+            } while (c == 255);
+        }
+
+        if (Len > (UINT32)(IpEnd - Ip) || Len > (UINT32)(OpEnd - Op))
+        {
+            return -1;
+        }
+
+        CopyMem(Op, Ip, Len);
+        Ip += Len;
+        Op += Len;
+
+        /* the last sequence has only literals */
+        if (Ip >= IpEnd)
+        {
+            break;
+        }
+
+        /* match */
+        if (IpEnd - Ip < 2)
+        {
+            return -1;
+        }
+
+        Offset = Ip[0] | (Ip[1] << 8);
+        Ip += 2;
+        if (Offset == 0 || Offset > (UINT32)(Op - Dst))
+        {
+            return -1;
+        }
+
+        Len = Token & 15;
+        if (Len == 15)
+        {
+            do
+            {
+                if (Ip >= IpEnd)
+                {
+                    return -1;
+                }
+                c = *Ip++;
+                Len += c;
+            } while (c == 255);
+        }
+        Len += 4;
+
+        if (Len > (UINT32)(OpEnd - Op))
+        {
+            return -1;
+        }
+
+        Ref = Op - Offset;
+        if (Offset >= Len)
+        {
+            CopyMem(Op, Ref, Len);
+            Op += Len;
+        }
+        else
+        {
+            /* overlapped copy, repeat the pattern */
+            while (Len-- > 0)
+            {
+                *Op++ = *Ref++;
+            }
+        }
+    }
+
+    return (INT32)(Op - Dst);
+}
@@ -32,6 +32,7 @@
 #include <Guid/FileInfo.h>
 #include <Guid/FileSystemInfo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/RamDisk.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/DriverBinding.h>
@@ -41,9 +42,31 @@ UINT8 *g_iso_data_buf = NULL;
 UINTN g_iso_buf_size = 0;
 BOOLEAN gMemdiskMode = FALSE;
 BOOLEAN gSector512Mode = FALSE;
-
-ventoy_sector_flag *g_sector_flag = NULL;
-UINT32 g_sector_flag_num = 0;
+BOOLEAN gMemdiskLazy = FALSE;
+
+STATIC UINT8 *g_memdisk_bitmap = NULL;
+STATIC UINT8 *g_memdisk_stage = NULL;
+STATIC UINT32 g_memdisk_block_num = 0;
+STATIC UINT32 g_memdisk_fill_num = 0;
+STATIC UINT32 g_memdisk_bg_next = 0;
+STATIC BOOLEAN g_memdisk_fg_busy = FALSE;
+STATIC EFI_EVENT g_memdisk_timer = NULL;
+STATIC EFI_EXIT_BOOT_SERVICES g_org_exit_boot_services = NULL;
+
+BOOLEAN gMemdiskCompressed = FALSE;
+STATIC ventoy_cmem_head *g_cmem_head = NULL;
+STATIC ventoy_cmem_block *g_cmem_block = NULL;
+STATIC UINT8 *g_cmem_lru_buf = NULL;
+STATIC UINT32 g_cmem_lru_block[VTOY_CMEM_LRU_NUM];
+STATIC UINT64 g_cmem_lru_stamp[VTOY_CMEM_LRU_NUM];
+STATIC UINT64 g_cmem_stamp = 0;
+STATIC UINT64 g_cmem_hit = 0;
+STATIC UINT64 g_cmem_decode = 0;
+STATIC UINT64 g_cmem_decode_bytes = 0;
+
+ventoy_virt_range *g_virt_range = NULL;
+UINT32 g_virt_range_num = 0;
+UINT32 *g_override_index = NULL;
 
 EFI_FILE_OPEN g_original_fopen = NULL;
 EFI_FILE_CLOSE g_original_fclose = NULL;
@@ -74,6 +97,41 @@ STATIC UINT8 g_sector_buf[2048];
 STATIC EFI_BLOCK_READ g_sector_2048_read = NULL;
 STATIC EFI_BLOCK_WRITE g_sector_2048_write = NULL;
 
+STATIC UINT32 g_chunk_cursor = 0;
+STATIC BOOLEAN g_chunk_sorted = TRUE;
+UINT64 g_chunk_lookup_num = 0;
+UINT64 g_chunk_probe_num = 0;
+UINT64 g_chunk_cursor_hit = 0;
+
+STATIC ventoy_cache_slot *g_cache_slot = NULL;
+STATIC UINT32 *g_cache_hash = NULL;
+STATIC UINT8 *g_cache_pool = NULL;
+STATIC UINT8 *g_cache_stage = NULL;
+STATIC UINT32 g_cache_hash_mask = 0;
+STATIC UINT32 g_cache_lru_head = VTOY_CACHE_NONE;
+STATIC UINT32 g_cache_lru_tail = VTOY_CACHE_NONE;
+STATIC UINT32 g_cache_extent_blocks = 0;
+STATIC UINT32 g_cache_ra_num = 1;
+STATIC UINT64 g_cache_next_extent = MAX_UINT64;
+UINT32 g_cache_slot_num = 0;
+UINT64 g_cache_hit = 0;
+UINT64 g_cache_miss = 0;
+UINT64 g_cache_prefetch = 0;
+UINT64 g_cache_bypass = 0;
+
+STATIC ventoy_bounce_buf g_bounce_buf[VTOY_BOUNCE_NUM];
+UINT64 g_bounce_read = 0;
+UINT64 g_bounce_split = 0;
+UINT64 g_bounce_alloc = 0;
+
+STATIC ventoy_io_trace_head *g_io_trace = NULL;
+STATIC ventoy_io_trace_entry *g_io_trace_entry = NULL;
+STATIC UINT64 g_io_trace_start = 0;
+STATIC UINT64 g_io_trace_raw = 0;
+STATIC UINT32 g_io_trace_raw_num = 0;
+STATIC UINT32 g_io_trace_chunks = 0;
+STATIC UINT32 g_io_trace_flags = 0;
+
 STATIC UINTN g_DriverBindWrapperCnt = 0;
 STATIC DRIVER_BIND_WRAPPER g_DriverBindWrapperList[MAX_DRIVER_BIND_WRAPPER];
 
@@ -131,200 +189,1846 @@ EFI_STATUS EFIAPI ventoy_block_io_reset
 	return EFI_SUCCESS;
 }
 
-STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
-(
-    IN UINT64                 Sector,
-    IN UINTN                  Count,
-    OUT VOID                 *Buffer
-)
+/*
+ * The chunk list is built in image order, so a sector is located with a
+ * binary search instead of a scan from the first chunk. Most reads are
+ * sequential, so the last hit chunk and the one after it are checked first.
+ * If the list is not sorted (should not happen) fall back to the linear scan.
+ */
+VOID EFIAPI ventoy_chunk_index_init(VOID)
 {
-    EFI_STATUS Status = EFI_SUCCESS;
-    EFI_LBA MapLba = 0;
     UINT32 i = 0;
-    UINTN secLeft = 0;
-    UINTN secRead = 0;
-    UINT64 ReadStart = 0;
-    UINT64 ReadEnd = 0;
-    UINT64 OverrideStart = 0;
-    UINT64 OverrideEnd= 0;
-    UINT8 *pCurBuf = (UINT8 *)Buffer;
-    ventoy_img_chunk *pchunk = g_chunk;
-    ventoy_override_chunk *pOverride = g_override_chunk;
-    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
 
-    debug("read iso sector %lu count %u Buffer:%p Align:%u blk:%u",
-        Sector, Count, Buffer, pRawBlockIo->Media->IoAlign, pRawBlockIo->Media->BlockSize);
+    g_chunk_cursor = 0;
+    g_chunk_sorted = TRUE;
+    g_chunk_lookup_num = 0;
+    g_chunk_probe_num = 0;
+    g_chunk_cursor_hit = 0;
 
-    ReadStart = Sector * 2048;
-    ReadEnd = (Sector + Count) * 2048;
+    for (i = 0; i < g_img_chunk_num; i++)
+    {
+        if (g_chunk[i].img_start_sector > g_chunk[i].img_end_sector ||
+            (i > 0 && g_chunk[i].img_start_sector <= g_chunk[i - 1].img_end_sector))
+        {
+            debug("chunk list not sorted at %u, use linear lookup", i);
+            g_chunk_sorted = FALSE;
+            break;
+        }
+    }
+}
+
+STATIC UINT32 ventoy_find_chunk(IN UINT64 Sector)
+{
+    UINT32 i = 0;
+    UINT32 Low = 0;
+    UINT32 Mid = 0;
+    UINT32 High = g_img_chunk_num;
+    ventoy_img_chunk *pchunk = NULL;
 
-    for (i = 0; Count > 0 && i < g_img_chunk_num; i++, pchunk++)
+    g_chunk_lookup_num++;
+
+    if (g_chunk_sorted)
     {
-        if (Sector >= pchunk->img_start_sector && Sector <= pchunk->img_end_sector)
+        for (i = g_chunk_cursor; i < g_img_chunk_num && i <= g_chunk_cursor + 1; i++)
         {
-            if (g_chain->disk_sector_size == 512)
+            g_chunk_probe_num++;
+            pchunk = g_chunk + i;
+            if (Sector >= pchunk->img_start_sector && Sector <= pchunk->img_end_sector)
             {
-                MapLba = (Sector - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
+                g_chunk_cursor_hit++;
+                g_chunk_cursor = i;
+                return i;
             }
-            else if (g_chain->disk_sector_size == 1024)
+        }
+
+        while (Low < High)
+        {
+            g_chunk_probe_num++;
+            Mid = Low + (High - Low) / 2;
+            pchunk = g_chunk + Mid;
+            if (Sector < pchunk->img_start_sector)
             {
-                MapLba = (Sector - pchunk->img_start_sector) * 2 + pchunk->disk_start_sector;
+                High = Mid;
             }
-            else if (g_chain->disk_sector_size == 2048)
+            else if (Sector > pchunk->img_end_sector)
             {
-                MapLba = (Sector - pchunk->img_start_sector) + pchunk->disk_start_sector;
+                Low = Mid + 1;
             }
-            else if (g_chain->disk_sector_size == 4096)
+            else
             {
-                MapLba = ((Sector - pchunk->img_start_sector) >> 1) + pchunk->disk_start_sector;
+                g_chunk_cursor = Mid;
+                return Mid;
             }
-
-            secLeft = pchunk->img_end_sector + 1 - Sector;
-            secRead = (Count < secLeft) ? Count : secLeft;
-
-            Status = pRawBlockIo->ReadBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
-                                     MapLba, secRead * 2048, pCurBuf);
-            if (EFI_ERROR(Status))
+        }
+    }
+    else
+    {
+        for (i = 0; i < g_img_chunk_num; i++)
+        {
+            g_chunk_probe_num++;
+            pchunk = g_chunk + i;
+            if (Sector >= pchunk->img_start_sector && Sector <= pchunk->img_end_sector)
             {
-                debug("Raw disk read block failed %r LBA:%lu Count:%u %p", Status, MapLba, secRead, pCurBuf);
-                return Status;
+                return i;
             }
-
-            Count -= secRead;
-            Sector += secRead;
-            pCurBuf += secRead * 2048;
         }
     }
 
-    if (ReadStart > g_chain->real_img_size_in_bytes)
+    return g_img_chunk_num;
+}
+
+/*
+ * The virt chunks (memory data and remapped sectors) and the override chunks
+ * are sorted once at ventoy_install_blockio, so a read only visits the ranges
+ * it really hits instead of checking every chunk for every sector.
+ * The chunk lists are normally already sorted, so insertion sort is enough.
+ */
+STATIC VOID ventoy_add_virt_range(UINT32 Start, UINT32 End, UINT32 Type, UINT32 Chunk)
+{
+    UINT32 i = 0;
+
+    if (Start >= End)
     {
-        return EFI_SUCCESS;
+        return;
     }
 
-    /* override data */
-    pCurBuf = (UINT8 *)Buffer;
-    for (i = 0; i < g_override_chunk_num; i++, pOverride++)
+    /* keep the list order for equal start, the first virt chunk wins as before */
+    for (i = g_virt_range_num; i > 0 && g_virt_range[i - 1].start > Start; i--)
     {
-        OverrideStart = pOverride->img_offset;
-        OverrideEnd = pOverride->img_offset + pOverride->override_size;
+        g_virt_range[i] = g_virt_range[i - 1];
+    }
 
-        if (OverrideStart >= ReadEnd || ReadStart >= OverrideEnd)
+    g_virt_range[i].start = Start;
+    g_virt_range[i].end = End;
+    g_virt_range[i].type = Type;
+    g_virt_range[i].chunk = Chunk;
+    g_virt_range_num++;
+}
+
+EFI_STATUS EFIAPI ventoy_build_range_index(VOID)
+{
+    UINT32 i = 0;
+    UINT32 j = 0;
+    UINT32 Num = 0;
+    UINT32 MaxEnd = 0;
+    UINT64 Start = 0;
+    ventoy_virt_chunk *node = g_virt_chunk;
+
+    ventoy_free_range_index();
+
+    if (g_virt_chunk_num > 0)
+    {
+        g_virt_range = AllocatePool(g_virt_chunk_num * 2 * sizeof(ventoy_virt_range));
+        if (NULL == g_virt_range)
         {
-            continue;
+            return EFI_OUT_OF_RESOURCES;
         }
 
-        if (ReadStart <= OverrideStart)
+        for (i = 0; i < g_virt_chunk_num; i++, node++)
         {
-            if (ReadEnd <= OverrideEnd)
+            ventoy_add_virt_range(node->mem_sector_start, node->mem_sector_end, VTOY_VIRT_RANGE_MEM, i);
+            ventoy_add_virt_range(node->remap_sector_start, node->remap_sector_end, VTOY_VIRT_RANGE_REMAP, i);
+        }
+
+        /* make the ranges disjoint, the overlapped part belongs to the previous one */
+        for (i = 0; i < g_virt_range_num; i++)
+        {
+            if (Num > 0 && g_virt_range[i].start < MaxEnd)
             {
-                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, ReadEnd - OverrideStart);
+                g_virt_range[i].start = MaxEnd;
             }
-            else
+
+            if (g_virt_range[i].start < g_virt_range[i].end)
             {
-                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, pOverride->override_size);
+                g_virt_range[Num++] = g_virt_range[i];
+                MaxEnd = g_virt_range[i].end;
             }
         }
-        else
+        g_virt_range_num = Num;
+    }
+
+    if (g_override_chunk_num > 0)
+    {
+        g_override_index = AllocatePool(g_override_chunk_num * sizeof(UINT32));
+        if (NULL == g_override_index)
         {
-            if (ReadEnd <= OverrideEnd)
+            return EFI_OUT_OF_RESOURCES;
+        }
+
+        for (i = 0; i < g_override_chunk_num; i++)
+        {
+            Start = g_override_chunk[i].img_offset;
+            for (j = i; j > 0 && g_override_chunk[g_override_index[j - 1]].img_offset > Start; j--)
             {
-                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, ReadEnd - ReadStart);
+                g_override_index[j] = g_override_index[j - 1];
             }
-            else
+            g_override_index[j] = i;
+        }
+
+        /* overlapped overrides must be applied in list order, keep the linear scan for them */
+        for (i = 1; i < g_override_chunk_num; i++)
+        {
+            if (g_override_chunk[g_override_index[i - 1]].img_offset +
+                g_override_chunk[g_override_index[i - 1]].override_size > g_override_chunk[g_override_index[i]].img_offset)
             {
-                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, OverrideEnd - ReadStart);
+                debug("override chunk %u overlapped, use linear scan", g_override_index[i]);
+                FreePool(g_override_index);
+                g_override_index = NULL;
+                break;
             }
         }
+    }
 
-        if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) &&
-            pOverride->override_size == sizeof(ventoy_iso9660_override))
+    debug("range index virt:%u/%u override:%u %a", g_virt_range_num, g_virt_chunk_num,
+          g_override_chunk_num, g_override_index ? "sorted" : "linear");
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI ventoy_free_range_index(VOID)
+{
+    if (g_virt_range)
+    {
+        FreePool(g_virt_range);
+        g_virt_range = NULL;
+    }
+    g_virt_range_num = 0;
+
+    if (g_override_index)
+    {
+        FreePool(g_override_index);
+        g_override_index = NULL;
+    }
+}
+
+STATIC UINT32 ventoy_first_override(IN UINT64 ReadStart)
+{
+    UINT32 Low = 0;
+    UINT32 Mid = 0;
+    UINT32 High = g_override_chunk_num;
+    ventoy_override_chunk *pOverride = NULL;
+
+    if (NULL == g_override_index)
+    {
+        return 0;
+    }
+
+    /* the overrides are disjoint, so the ends are sorted too */
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        pOverride = g_override_chunk + g_override_index[Mid];
+        if (pOverride->img_offset + pOverride->override_size <= ReadStart)
         {
-            ventoy_iso9660_override *dirent = (ventoy_iso9660_override *)pOverride->override_data;
-            if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
+            Low = Mid + 1;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+
+    return Low;
+}
+
+STATIC UINT32 ventoy_first_virt_range(IN UINT64 Lba)
+{
+    UINT32 Low = 0;
+    UINT32 Mid = 0;
+    UINT32 High = g_virt_range_num;
+
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (g_virt_range[Mid].end <= Lba)
+        {
+            Low = Mid + 1;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+
+    return Low;
+}
+
+/*
+ * I/O trace.
+ * Every BlockIo read is recorded in a ring with its latency, the time spent
+ * in raw disk reads and the number of image chunks visited, and counted in
+ * log2 histograms of latency and size. A BlockIo2 read that goes to the raw
+ * disk asynchronously is recorded when its token is signaled, with the
+ * VTOY_IO_TRACE_ASYNC flag; the other BlockIo2 reads go through BlockIo. Time is taken from the TSC (the
+ * TimerLib of this build is the null one), so it's only there on x86.
+ */
+EFI_STATUS EFIAPI ventoy_trace_init(VOID)
+{
+    UINTN Size = 0;
+    UINTN DataSize = 0;
+    UINT64 Tsc = 0;
+    UINT64 Addr = 0;
+    UINT32 Num = g_chain->io_trace_num;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_GUID VarGuid = VENTOY_GUID;
+    ventoy_io_trace_head *head = NULL;
+
+    if (Num == 0)
+    {
+        return EFI_SUCCESS;
+    }
+
+    if (Num > VTOY_IO_TRACE_MAX_NUM)
+    {
+        Num = VTOY_IO_TRACE_MAX_NUM;
+    }
+
+    Size = sizeof(ventoy_io_trace_head) + Num * sizeof(ventoy_io_trace_entry);
+
+    /* reuse the buffer left by a previous boot */
+    DataSize = sizeof(Addr);
+    Status = gRT->GetVariable(L"VentoyIoTrace", &VarGuid, NULL, &DataSize, &Addr);
+    if (!EFI_ERROR(Status) && Addr)
+    {
+        head = (ventoy_io_trace_head *)(UINTN)Addr;
+        if (head->magic != VTOY_IO_TRACE_MAGIC)
+        {
+            head = NULL;
+        }
+        else if (head->entry_num != Num)
+        {
+            /* ring size changed, free the old one */
+            if (head->entry_num > 0 && head->entry_num <= VTOY_IO_TRACE_MAX_NUM)
             {
-                g_fixup_iso9660_secover_start = TRUE;
-                g_fixup_iso9660_secover_cur_secs = 0;
+                FreePages(head, EFI_SIZE_TO_PAGES(sizeof(ventoy_io_trace_head) +
+                          (UINTN)head->entry_num * sizeof(ventoy_io_trace_entry)));
             }
+            head = NULL;
         }
     }
 
-    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    if (!head)
     {
-        if (*(UINT32 *)Buffer == 0x66676572)
+        head = AllocatePages(EFI_SIZE_TO_PAGES(Size));
+        if (!head)
         {
-            g_blockio_bcd_read_done = TRUE;
+            return EFI_OUT_OF_RESOURCES;
         }
     }
 
+    SetMem(head, Size, 0);
+    head->magic = VTOY_IO_TRACE_MAGIC;
+    head->version = VTOY_IO_TRACE_VERSION;
+    head->entry_num = Num;
+    head->block_size = 2048; /* LBA unit of ventoy_block_io_read, also in 512 mode */
+
+    Tsc = ventoy_read_tsc();
+    gBS->Stall(10000);
+    head->tsc_per_ms = DivU64x32(ventoy_read_tsc() - Tsc, 10);
+
+    g_io_trace = head;
+    g_io_trace_entry = (ventoy_io_trace_entry *)(head + 1);
+
+    Addr = (UINT64)(UINTN)head;
+    Status = gRT->SetVariable(L"VentoyIoTrace", &VarGuid,
+                  EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS,
+                  sizeof(Addr), &Addr);
+
+    debug("io trace %u entries at %p tsc/ms:%lu set variable %r", Num, head, head->tsc_per_ms, Status);
     return EFI_SUCCESS;
 }
 
-STATIC EFI_STATUS EFIAPI ventoy_write_iso_sector
+STATIC UINT32 ventoy_trace_us(IN UINT64 Tsc)
+{
+    UINT64 Us = 0;
+
+    if (g_io_trace->tsc_per_ms == 0)
+    {
+        return 0;
+    }
+
+    Us = DivU64x64Remainder(MultU64x32(Tsc, 1000), g_io_trace->tsc_per_ms, NULL);
+    return (Us > MAX_UINT32) ? MAX_UINT32 : (UINT32)Us;
+}
+
+STATIC UINT32 ventoy_trace_hist_index(IN UINT64 Value)
+{
+    UINT32 Index = (UINT32)(HighBitSet64(Value) + 1);
+
+    return (Index >= VTOY_IO_HIST_NUM) ? VTOY_IO_HIST_NUM - 1 : Index;
+}
+
+STATIC VOID ventoy_trace_begin(VOID)
+{
+    g_io_trace_raw = 0;
+    g_io_trace_raw_num = 0;
+    g_io_trace_chunks = 0;
+    g_io_trace_flags = 0;
+    g_io_trace_start = ventoy_read_tsc();
+}
+
+/* BlockIo2 requests complete in event callbacks, so the ring is updated at TPL_NOTIFY */
+STATIC VOID ventoy_trace_record
 (
-    IN UINT64                 Sector,
-    IN UINTN                  Count,
-    IN VOID                  *Buffer
+    IN EFI_LBA    Lba,
+    IN UINTN      Size,
+    IN UINT64     Tsc,
+    IN UINT64     RawTsc,
+    IN UINT32     RawNum,
+    IN UINT32     Chunks,
+    IN UINT32     Flags
 )
 {
+    EFI_TPL OldTpl;
+    ventoy_io_trace_head *head = g_io_trace;
+    ventoy_io_trace_entry *node = NULL;
+
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+
+    node = g_io_trace_entry + ModU64x32(head->next, (UINT32)head->entry_num);
+    node->lba = Lba;
+    node->size = (UINT32)Size;
+    node->time_us = ventoy_trace_us(Tsc);
+    node->raw_us = ventoy_trace_us(RawTsc);
+    node->raw_num = RawNum;
+    node->chunks = Chunks;
+    node->flags = Flags;
+
+    head->next++;
+    head->total_bytes += Size;
+    head->total_us += node->time_us;
+    head->raw_us += node->raw_us;
+    head->hist_us[ventoy_trace_hist_index(node->time_us)]++;
+    head->hist_kb[ventoy_trace_hist_index(Size / 1024)]++;
+
+    gBS->RestoreTPL(OldTpl);
+}
+
+STATIC VOID ventoy_trace_end(IN EFI_LBA Lba, IN UINTN Size, IN EFI_STATUS Status)
+{
+    ventoy_trace_record(Lba, Size, ventoy_read_tsc() - g_io_trace_start, g_io_trace_raw,
+                        g_io_trace_raw_num, g_io_trace_chunks,
+                        g_io_trace_flags | (EFI_ERROR(Status) ? VTOY_IO_TRACE_ERROR : 0));
+}
+
+/* all the raw disk reads of the BlockIo path go here */
+STATIC EFI_STATUS ventoy_raw_disk_read(IN EFI_LBA Lba, IN UINTN Size, OUT VOID *Buffer)
+{
+    UINT64 Tsc = 0;
     EFI_STATUS Status = EFI_SUCCESS;
-    EFI_LBA MapLba = 0;
-    UINT32 i = 0;
-    UINTN secLeft = 0;
-    UINTN secRead = 0;
-    UINT64 ReadStart = 0;
-    UINT64 ReadEnd = 0;
-    UINT8 *pCurBuf = (UINT8 *)Buffer;
-    ventoy_img_chunk *pchunk = g_chunk;
     EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
 
-    debug("write iso sector %lu  count %u", Sector, Count);
+    if (g_io_trace)
+    {
+        Tsc = ventoy_read_tsc();
+    }
 
-    ReadStart = Sector * 2048;
-    ReadEnd = (Sector + Count) * 2048;
+    Status = pRawBlockIo->ReadBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId, Lba, Size, Buffer);
+
+    if (g_io_trace)
+    {
+        g_io_trace_raw += ventoy_read_tsc() - Tsc;
+        g_io_trace_raw_num++;
+    }
+
+    return Status;
+}
+
+VOID EFIAPI ventoy_dump_trace_stat(VOID)
+{
+    if (g_io_trace)
+    {
+        debug("io trace read:%lu bytes:%lu time:%lums raw:%lums", g_io_trace->next, g_io_trace->total_bytes,
+              DivU64x32(g_io_trace->total_us, 1000), DivU64x32(g_io_trace->raw_us, 1000));
+    }
+}
+
+/*
+ * Raw disk read cache.
+ * Small reads (WinPE issues a lot of 2-16KB reads) are served from an LRU of
+ * VTOY_CACHE_EXTENT_SIZE aligned extents of the raw disk. A miss which goes on
+ * a sequential stream prefetches up to VTOY_CACHE_RA_MAX extents in one raw
+ * read. The cache only holds raw disk data, override chunks are applied by
+ * the caller after that just as before. The virtual disk is read only except
+ * in 512 mode, so the cache is disabled there and never needs invalidation.
+ */
+STATIC UINT32 ventoy_cache_lookup(IN UINT64 Extent)
+{
+    UINT32 i;
 
-    for (i = 0; Count > 0 && i < g_img_chunk_num; i++, pchunk++)
+    for (i = g_cache_hash[(UINT32)Extent & g_cache_hash_mask]; i != VTOY_CACHE_NONE; i = g_cache_slot[i].hnext)
     {
-        if (Sector >= pchunk->img_start_sector && Sector <= pchunk->img_end_sector)
+        if (g_cache_slot[i].extent == Extent)
         {
-            if (g_chain->disk_sector_size == 512)
-            {
-                MapLba = (Sector - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
-            }
-            else if (g_chain->disk_sector_size == 1024)
-            {
-                MapLba = (Sector - pchunk->img_start_sector) * 2 + pchunk->disk_start_sector;
-            }
-            else if (g_chain->disk_sector_size == 2048)
-            {
-                MapLba = (Sector - pchunk->img_start_sector) + pchunk->disk_start_sector;
-            }
-            else if (g_chain->disk_sector_size == 4096)
-            {
-                MapLba = ((Sector - pchunk->img_start_sector) >> 1) + pchunk->disk_start_sector;
-            }
+            return i;
+        }
+    }
 
+    return VTOY_CACHE_NONE;
+}
 
-            secLeft = pchunk->img_end_sector + 1 - Sector;
-            secRead = (Count < secLeft) ? Count : secLeft;
+STATIC VOID ventoy_cache_hash_del(IN UINT32 Slot)
+{
+    UINT32 *pLink = g_cache_hash + ((UINT32)g_cache_slot[Slot].extent & g_cache_hash_mask);
 
-            Status = pRawBlockIo->WriteBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
-                                     MapLba, secRead * 2048, pCurBuf);
-            if (EFI_ERROR(Status))
-            {
-                debug("Raw disk write block failed %r LBA:%lu Count:%u", Status, MapLba, secRead);
-                return Status;
-            }
+    while (*pLink != VTOY_CACHE_NONE)
+    {
+        if (*pLink == Slot)
+        {
+            *pLink = g_cache_slot[Slot].hnext;
+            break;
+        }
+        pLink = &(g_cache_slot[*pLink].hnext);
+    }
+}
+
+STATIC VOID ventoy_cache_touch(IN UINT32 Slot)
+{
+    ventoy_cache_slot *cur = g_cache_slot + Slot;
+
+    if (g_cache_lru_head == Slot)
+    {
+        return;
+    }
+
+    /* unlink */
+    g_cache_slot[cur->prev].next = cur->next;
+    if (cur->next != VTOY_CACHE_NONE)
+    {
+        g_cache_slot[cur->next].prev = cur->prev;
+    }
+    else
+    {
+        g_cache_lru_tail = cur->prev;
+    }
+
+    /* insert at head */
+    cur->prev = VTOY_CACHE_NONE;
+    cur->next = g_cache_lru_head;
+    g_cache_slot[g_cache_lru_head].prev = Slot;
+    g_cache_lru_head = Slot;
+}
+
+STATIC UINT32 ventoy_cache_alloc(IN UINT64 Extent)
+{
+    UINT32 Slot = g_cache_lru_tail;
+    UINT32 Hash = (UINT32)Extent & g_cache_hash_mask;
+
+    if (g_cache_slot[Slot].extent != MAX_UINT64)
+    {
+        ventoy_cache_hash_del(Slot);
+    }
+
+    g_cache_slot[Slot].extent = Extent;
+    g_cache_slot[Slot].hnext = g_cache_hash[Hash];
+    g_cache_hash[Hash] = Slot;
+
+    ventoy_cache_touch(Slot);
+    return Slot;
+}
+
+STATIC EFI_STATUS ventoy_cache_fill(IN UINT64 Extent, OUT UINT32 *pSlot)
+{
+    UINT32 i = 0;
+    UINT32 Num = 0;
+    UINT32 Slot = 0;
+    UINT64 Lba = 0;
+    UINT64 Blocks = 0;
+    UINT64 DiskBlocks = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
+
+    /* sequential stream detection: the miss is just after the last fill */
+    if (Extent == g_cache_next_extent)
+    {
+        if (g_cache_ra_num < VTOY_CACHE_RA_MAX)
+        {
+            g_cache_ra_num *= 2;
+        }
+    }
+    else
+    {
+        g_cache_ra_num = 1;
+    }
+
+    DiskBlocks = pRawBlockIo->Media->LastBlock + 1;
+    Lba = MultU64x32(Extent, g_cache_extent_blocks);
+    if (Lba >= DiskBlocks)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    for (Num = 1; Num < g_cache_ra_num; Num++)
+    {
+        if (Lba + MultU64x32(Num, g_cache_extent_blocks) >= DiskBlocks ||
+            ventoy_cache_lookup(Extent + Num) != VTOY_CACHE_NONE)
+        {
+            break;
+        }
+    }
+
+    Blocks = MultU64x32(Num, g_cache_extent_blocks);
+    if (Lba + Blocks > DiskBlocks)
+    {
+        Blocks = DiskBlocks - Lba;
+        SetMem(g_cache_stage, Num * VTOY_CACHE_EXTENT_SIZE, 0);
+    }
+
+    Status = ventoy_raw_disk_read(Lba, (UINTN)Blocks * pRawBlockIo->Media->BlockSize, g_cache_stage);
+    if (EFI_ERROR(Status))
+    {
+        debug("cache fill failed %r LBA:%lu Count:%lu", Status, Lba, Blocks);
+        return Status;
+    }
+
+    /* the slot count is never less than VTOY_CACHE_RA_MAX, so the first one is kept */
+    for (i = Num; i > 0; i--)
+    {
+        Slot = ventoy_cache_alloc(Extent + i - 1);
+        CopyMem(g_cache_slot[Slot].data, g_cache_stage + (i - 1) * VTOY_CACHE_EXTENT_SIZE, VTOY_CACHE_EXTENT_SIZE);
+    }
+
+    g_cache_prefetch += Num - 1;
+    g_cache_next_extent = Extent + Num;
+
+    *pSlot = Slot;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS ventoy_raw_read(IN EFI_LBA Lba, IN UINTN Size, OUT VOID *Buffer)
+{
+    UINT32 Slot = 0;
+    UINT32 Pos = 0;
+    UINTN Len = 0;
+    UINT64 Extent = 0;
+    UINT64 Offset = 0;
+    UINT64 End = 0;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
+
+    if (g_cache_slot_num == 0 || Size > VTOY_CACHE_RA_MAX * VTOY_CACHE_EXTENT_SIZE)
+    {
+        if (g_cache_slot_num > 0)
+        {
+            g_cache_bypass++;
+        }
+        return ventoy_raw_disk_read(Lba, Size, Buffer);
+    }
+
+    Offset = MultU64x32(Lba, pRawBlockIo->Media->BlockSize);
+    End = Offset + Size;
+
+    while (Offset < End)
+    {
+        Extent = DivU64x32(Offset, VTOY_CACHE_EXTENT_SIZE);
+        Pos = (UINT32)(Offset & (VTOY_CACHE_EXTENT_SIZE - 1));
+        Len = VTOY_CACHE_EXTENT_SIZE - Pos;
+        if (Len > End - Offset)
+        {
+            Len = (UINTN)(End - Offset);
+        }
+
+        Slot = ventoy_cache_lookup(Extent);
+        if (Slot == VTOY_CACHE_NONE)
+        {
+            g_cache_miss++;
+            if (EFI_ERROR(ventoy_cache_fill(Extent, &Slot)))
+            {
+                return ventoy_raw_disk_read(Lba, Size, Buffer);
+            }
+        }
+        else
+        {
+            g_cache_hit++;
+            ventoy_cache_touch(Slot);
+        }
+
+        CopyMem(pCurBuf, g_cache_slot[Slot].data + Pos, Len);
+        pCurBuf += Len;
+        Offset += Len;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI ventoy_cache_init(VOID)
+{
+    UINT32 i = 0;
+    UINT32 Num = 0;
+    UINT32 HashNum = 1;
+    UINT32 SizeKB = g_chain->uefi_cache_size;
+    EFI_BLOCK_IO_MEDIA *Media = gBlockData.pRawBlockIo->Media;
+
+    if (SizeKB == 0 || gSector512Mode || Media->BlockSize == 0 ||
+        (VTOY_CACHE_EXTENT_SIZE % Media->BlockSize) || Media->IoAlign > EFI_PAGE_SIZE)
+    {
+        debug("read cache disabled size:%uKB blk:%u align:%u", SizeKB, Media->BlockSize, Media->IoAlign);
+        return EFI_SUCCESS;
+    }
+
+    if (SizeKB > VTOY_CACHE_MAX_KB)
+    {
+        SizeKB = VTOY_CACHE_MAX_KB;
+    }
+
+    Num = SizeKB / (VTOY_CACHE_EXTENT_SIZE / 1024);
+    if (Num < VTOY_CACHE_RA_MAX)
+    {
+        Num = VTOY_CACHE_RA_MAX;
+    }
+
+    while (HashNum < Num)
+    {
+        HashNum <<= 1;
+    }
+
+    g_cache_slot = AllocatePool(Num * sizeof(ventoy_cache_slot));
+    g_cache_hash = AllocatePool(HashNum * sizeof(UINT32));
+    g_cache_pool = AllocatePages(EFI_SIZE_TO_PAGES(Num * VTOY_CACHE_EXTENT_SIZE));
+    g_cache_stage = AllocatePages(EFI_SIZE_TO_PAGES(VTOY_CACHE_RA_MAX * VTOY_CACHE_EXTENT_SIZE));
+    if (!g_cache_slot || !g_cache_hash || !g_cache_pool || !g_cache_stage)
+    {
+        debug("Failed to alloc read cache %u", Num);
+        g_cache_slot_num = Num;
+        ventoy_cache_free();
+        return EFI_SUCCESS;
+    }
+
+    for (i = 0; i < HashNum; i++)
+    {
+        g_cache_hash[i] = VTOY_CACHE_NONE;
+    }
+
+    for (i = 0; i < Num; i++)
+    {
+        g_cache_slot[i].extent = MAX_UINT64;
+        g_cache_slot[i].prev = (i == 0) ? VTOY_CACHE_NONE : i - 1;
+        g_cache_slot[i].next = (i + 1 == Num) ? VTOY_CACHE_NONE : i + 1;
+        g_cache_slot[i].hnext = VTOY_CACHE_NONE;
+        g_cache_slot[i].data = g_cache_pool + i * VTOY_CACHE_EXTENT_SIZE;
+    }
+
+    g_cache_lru_head = 0;
+    g_cache_lru_tail = Num - 1;
+    g_cache_hash_mask = HashNum - 1;
+    g_cache_extent_blocks = VTOY_CACHE_EXTENT_SIZE / Media->BlockSize;
+    g_cache_next_extent = MAX_UINT64;
+    g_cache_ra_num = 1;
+    g_cache_slot_num = Num;
+
+    debug("read cache %u x %uKB", Num, VTOY_CACHE_EXTENT_SIZE / 1024);
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI ventoy_cache_free(VOID)
+{
+    if (g_cache_pool)
+    {
+        FreePages(g_cache_pool, EFI_SIZE_TO_PAGES(g_cache_slot_num * VTOY_CACHE_EXTENT_SIZE));
+        g_cache_pool = NULL;
+    }
+
+    if (g_cache_stage)
+    {
+        FreePages(g_cache_stage, EFI_SIZE_TO_PAGES(VTOY_CACHE_RA_MAX * VTOY_CACHE_EXTENT_SIZE));
+        g_cache_stage = NULL;
+    }
+
+    if (g_cache_slot)
+    {
+        FreePool(g_cache_slot);
+        g_cache_slot = NULL;
+    }
+
+    if (g_cache_hash)
+    {
+        FreePool(g_cache_hash);
+        g_cache_hash = NULL;
+    }
+
+    g_cache_slot_num = 0;
+}
+
+/* read image sectors from the raw disk through the chunk list, without override */
+STATIC EFI_STATUS ventoy_read_img_chunk
+(
+    IN UINT64                 Sector,
+    IN UINTN                  Count,
+    OUT VOID                 *Buffer
+)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_LBA MapLba = 0;
+    UINT32 i = 0;
+    UINTN secLeft = 0;
+    UINTN secRead = 0;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    ventoy_img_chunk *pchunk = NULL;
+
+    while (Count > 0)
+    {
+        i = ventoy_find_chunk(Sector);
+        if (i >= g_img_chunk_num)
+        {
+            break;
+        }
+
+        pchunk = g_chunk + i;
+        g_io_trace_chunks++;
+
+        if (g_chain->disk_sector_size == 512)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 1024)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) * 2 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 2048)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 4096)
+        {
+            MapLba = ((Sector - pchunk->img_start_sector) >> 1) + pchunk->disk_start_sector;
+        }
+
+        secLeft = pchunk->img_end_sector + 1 - Sector;
+        secRead = (Count < secLeft) ? Count : secLeft;
+
+        Status = ventoy_raw_read(MapLba, secRead * 2048, pCurBuf);
+        if (EFI_ERROR(Status))
+        {
+            debug("Raw disk read block failed %r LBA:%lu Count:%u %p", Status, MapLba, secRead, pCurBuf);
+            return Status;
+        }
+
+        Count -= secRead;
+        Sector += secRead;
+        pCurBuf += secRead * 2048;
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI ventoy_read_iso_sector
+(
+    IN UINT64                 Sector,
+    IN UINTN                  Count,
+    OUT VOID                 *Buffer
+)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT32 i = 0;
+    UINT64 ReadStart = 0;
+    UINT64 ReadEnd = 0;
+    UINT64 OverrideStart = 0;
+    UINT64 OverrideEnd= 0;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    ventoy_override_chunk *pOverride = NULL;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
+
+    debug("read iso sector %lu count %u Buffer:%p Align:%u blk:%u",
+        Sector, Count, Buffer, pRawBlockIo->Media->IoAlign, pRawBlockIo->Media->BlockSize);
+
+    ReadStart = Sector * 2048;
+    ReadEnd = (Sector + Count) * 2048;
+
+    Status = ventoy_read_img_chunk(Sector, Count, Buffer);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    if (ReadStart > g_chain->real_img_size_in_bytes)
+    {
+        return EFI_SUCCESS;
+    }
+
+    /* override data */
+    pCurBuf = (UINT8 *)Buffer;
+    for (i = ventoy_first_override(ReadStart); i < g_override_chunk_num; i++)
+    {
+        pOverride = g_override_chunk + (g_override_index ? g_override_index[i] : i);
+        OverrideStart = pOverride->img_offset;
+        OverrideEnd = pOverride->img_offset + pOverride->override_size;
+
+        if (g_override_index && OverrideStart >= ReadEnd)
+        {
+            break;
+        }
+
+        if (OverrideStart >= ReadEnd || ReadStart >= OverrideEnd)
+        {
+            continue;
+        }
+
+        if (ReadStart <= OverrideStart)
+        {
+            if (ReadEnd <= OverrideEnd)
+            {
+                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, ReadEnd - OverrideStart);
+            }
+            else
+            {
+                CopyMem(pCurBuf + OverrideStart - ReadStart, pOverride->override_data, pOverride->override_size);
+            }
+        }
+        else
+        {
+            if (ReadEnd <= OverrideEnd)
+            {
+                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, ReadEnd - ReadStart);
+            }
+            else
+            {
+                CopyMem(pCurBuf, pOverride->override_data + ReadStart - OverrideStart, OverrideEnd - ReadStart);
+            }
+        }
+
+        g_io_trace_flags |= VTOY_IO_TRACE_OVERRIDE;
+
+        if (g_fixup_iso9660_secover_enable && (!g_fixup_iso9660_secover_start) &&
+            pOverride->override_size == sizeof(ventoy_iso9660_override))
+        {
+            ventoy_iso9660_override *dirent = (ventoy_iso9660_override *)pOverride->override_data;
+            if (dirent->first_sector >= VENTOY_ISO9660_SECTOR_OVERFLOW)
+            {
+                g_fixup_iso9660_secover_start = TRUE;
+                g_fixup_iso9660_secover_cur_secs = 0;
+            }
+        }
+    }
+
+    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    {
+        if (*(UINT32 *)Buffer == 0x66676572)
+        {
+            g_blockio_bcd_read_done = TRUE;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI ventoy_write_iso_sector
+(
+    IN UINT64                 Sector,
+    IN UINTN                  Count,
+    IN VOID                  *Buffer
+)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_LBA MapLba = 0;
+    UINT32 i = 0;
+    UINTN secLeft = 0;
+    UINTN secRead = 0;
+    UINT64 ReadStart = 0;
+    UINT64 ReadEnd = 0;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    ventoy_img_chunk *pchunk = NULL;
+    EFI_BLOCK_IO_PROTOCOL *pRawBlockIo = gBlockData.pRawBlockIo;
+
+    debug("write iso sector %lu  count %u", Sector, Count);
+
+    ReadStart = Sector * 2048;
+    ReadEnd = (Sector + Count) * 2048;
+
+    while (Count > 0)
+    {
+        i = ventoy_find_chunk(Sector);
+        if (i >= g_img_chunk_num)
+        {
+            break;
+        }
+
+        pchunk = g_chunk + i;
+
+        if (g_chain->disk_sector_size == 512)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 1024)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) * 2 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 2048)
+        {
+            MapLba = (Sector - pchunk->img_start_sector) + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 4096)
+        {
+            MapLba = ((Sector - pchunk->img_start_sector) >> 1) + pchunk->disk_start_sector;
+        }
+
+
+        secLeft = pchunk->img_end_sector + 1 - Sector;
+        secRead = (Count < secLeft) ? Count : secLeft;
+
+        Status = pRawBlockIo->WriteBlocks(pRawBlockIo, pRawBlockIo->Media->MediaId,
+                                 MapLba, secRead * 2048, pCurBuf);
+        if (EFI_ERROR(Status))
+        {
+            debug("Raw disk write block failed %r LBA:%lu Count:%u", Status, MapLba, secRead);
+            return Status;
+        }
+
+        Count -= secRead;
+        Sector += secRead;
+        pCurBuf += secRead * 2048;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/*
+ * Demand paged memdisk.
+ * grub reserves the RAM for the whole image but does not read it, and passes
+ * the chunk list of the image after the image area instead. The memdisk is
+ * filled from the raw disk in VTOY_MEMDISK_BLOCK units on first access, and a
+ * timer event fills the remaining blocks when there is no foreground read.
+ * The OS may still use the RAM image after ExitBootServices, so the hooked
+ * ExitBootServices fills everything left before calling the original one.
+ * All the fill is done at TPL_CALLBACK, so the timer never runs in the middle
+ * of a foreground fill.
+ */
+STATIC BOOLEAN ventoy_memdisk_resident(IN UINT32 Block)
+{
+    return (g_memdisk_bitmap[Block >> 3] & (1 << (Block & 7))) ? TRUE : FALSE;
+}
+
+STATIC EFI_STATUS ventoy_memdisk_fill_block(IN UINT32 Block)
+{
+    UINT64 Sector = 0;
+    UINT64 Count = 0;
+    UINT32 IoAlign = gBlockData.pRawBlockIo->Media->IoAlign;
+    UINT8 *pData = g_iso_data_buf + (UINTN)Block * VTOY_MEMDISK_BLOCK;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    Sector = MultU64x32(Block, VTOY_MEMDISK_BLOCK / 2048);
+    Count = DivU64x32(g_chain->virt_img_size_in_bytes, 2048) - Sector;
+    if (Count > VTOY_MEMDISK_BLOCK / 2048)
+    {
+        Count = VTOY_MEMDISK_BLOCK / 2048;
+    }
+
+    /* the image data follows the chain head, so it's not always aligned for the raw disk */
+    if (IoAlign > 1 && ((UINTN)pData & (IoAlign - 1)))
+    {
+        Status = ventoy_read_img_chunk(Sector, (UINTN)Count, g_memdisk_stage);
+        if (!EFI_ERROR(Status))
+        {
+            CopyMem(pData, g_memdisk_stage, (UINTN)Count * 2048);
+        }
+    }
+    else
+    {
+        Status = ventoy_read_img_chunk(Sector, (UINTN)Count, pData);
+    }
+
+    if (EFI_ERROR(Status))
+    {
+        debug("memdisk fill block %u failed %r", Block, Status);
+        return Status;
+    }
+
+    g_memdisk_bitmap[Block >> 3] |= (UINT8)(1 << (Block & 7));
+    g_memdisk_fill_num++;
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS ventoy_memdisk_ensure(IN EFI_LBA Lba, IN UINTN BufferSize)
+{
+    UINT32 Block = 0;
+    UINT32 Last = 0;
+    EFI_TPL OldTpl;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (!gMemdiskLazy || BufferSize == 0 || g_memdisk_fill_num >= g_memdisk_block_num)
+    {
+        return EFI_SUCCESS;
+    }
+
+    Block = (UINT32)DivU64x32(MultU64x32(Lba, 2048), VTOY_MEMDISK_BLOCK);
+    Last = (UINT32)DivU64x32(MultU64x32(Lba, 2048) + BufferSize - 1, VTOY_MEMDISK_BLOCK);
+    if (Last >= g_memdisk_block_num)
+    {
+        Last = g_memdisk_block_num - 1;
+    }
+
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+    for (; Block <= Last && !EFI_ERROR(Status); Block++)
+    {
+        if (!ventoy_memdisk_resident(Block))
+        {
+            Status = ventoy_memdisk_fill_block(Block);
+        }
+    }
+    g_memdisk_fg_busy = TRUE;
+    gBS->RestoreTPL(OldTpl);
+
+    return Status;
+}
+
+STATIC VOID EFIAPI ventoy_memdisk_bg_fill(IN EFI_EVENT Event, IN VOID *Context)
+{
+    (VOID)Event;
+    (VOID)Context;
+
+    /* only fill when idle */
+    if (g_memdisk_fg_busy)
+    {
+        g_memdisk_fg_busy = FALSE;
+        return;
+    }
+
+    while (g_memdisk_bg_next < g_memdisk_block_num && ventoy_memdisk_resident(g_memdisk_bg_next))
+    {
+        g_memdisk_bg_next++;
+    }
+
+    if (g_memdisk_bg_next >= g_memdisk_block_num || EFI_ERROR(ventoy_memdisk_fill_block(g_memdisk_bg_next)))
+    {
+        gBS->SetTimer(g_memdisk_timer, TimerCancel, 0);
+    }
+}
+
+STATIC EFI_STATUS ventoy_memdisk_fill_all(VOID)
+{
+    UINT32 Block = 0;
+    EFI_TPL OldTpl;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+    gBS->SetTimer(g_memdisk_timer, TimerCancel, 0);
+    for (Block = 0; Block < g_memdisk_block_num && g_memdisk_fill_num < g_memdisk_block_num; Block++)
+    {
+        if (!ventoy_memdisk_resident(Block))
+        {
+            Status = ventoy_memdisk_fill_block(Block);
+            if (EFI_ERROR(Status))
+            {
+                break;
+            }
+        }
+    }
+    gBS->RestoreTPL(OldTpl);
+
+    return Status;
+}
+
+/*
+ * The disk driver may allocate memory while filling, then the MapKey is stale
+ * and the original ExitBootServices fails. OS loaders get the memory map again
+ * and retry in that case, and everything is resident by then.
+ */
+STATIC EFI_STATUS EFIAPI ventoy_memdisk_exit_boot_services(IN EFI_HANDLE ImageHandle, IN UINTN MapKey)
+{
+    if (g_memdisk_fill_num < g_memdisk_block_num)
+    {
+        ventoy_memdisk_fill_all();
+    }
+
+    return g_org_exit_boot_services(ImageHandle, MapKey);
+}
+
+EFI_STATUS EFIAPI ventoy_memdisk_lazy_start(VOID)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    g_memdisk_block_num = (UINT32)DivU64x32(g_chain->virt_img_size_in_bytes + VTOY_MEMDISK_BLOCK - 1, VTOY_MEMDISK_BLOCK);
+    g_memdisk_bitmap = AllocateZeroPool((g_memdisk_block_num + 7) / 8);
+    g_memdisk_stage = AllocatePages(EFI_SIZE_TO_PAGES(VTOY_MEMDISK_BLOCK));
+    if (!g_memdisk_bitmap || !g_memdisk_stage)
+    {
+        ventoy_memdisk_lazy_stop();
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, ventoy_memdisk_bg_fill, NULL, &g_memdisk_timer);
+    if (EFI_ERROR(Status))
+    {
+        ventoy_memdisk_lazy_stop();
+        return Status;
+    }
+
+    g_memdisk_fill_num = 0;
+    g_memdisk_bg_next = 0;
+    g_memdisk_fg_busy = FALSE;
+    gBS->SetTimer(g_memdisk_timer, TimerPeriodic, VTOY_MEMDISK_FILL_TICK);
+
+    g_org_exit_boot_services = gBS->ExitBootServices;
+    gBS->ExitBootServices = ventoy_memdisk_exit_boot_services;
+
+    debug("lazy memdisk %u blocks of %uKB", g_memdisk_block_num, VTOY_MEMDISK_BLOCK / 1024);
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI ventoy_memdisk_lazy_stop(VOID)
+{
+    if (g_org_exit_boot_services)
+    {
+        gBS->ExitBootServices = g_org_exit_boot_services;
+        g_org_exit_boot_services = NULL;
+    }
+
+    if (g_memdisk_timer)
+    {
+        gBS->SetTimer(g_memdisk_timer, TimerCancel, 0);
+        gBS->CloseEvent(g_memdisk_timer);
+        g_memdisk_timer = NULL;
+    }
+
+    if (g_memdisk_block_num > 0)
+    {
+        debug("lazy memdisk filled %u/%u blocks", g_memdisk_fill_num, g_memdisk_block_num);
+    }
+
+    if (g_memdisk_stage)
+    {
+        FreePages(g_memdisk_stage, EFI_SIZE_TO_PAGES(VTOY_MEMDISK_BLOCK));
+        g_memdisk_stage = NULL;
+    }
+
+    if (g_memdisk_bitmap)
+    {
+        FreePool(g_memdisk_bitmap);
+        g_memdisk_bitmap = NULL;
+    }
+
+    g_memdisk_block_num = 0;
+    g_memdisk_fill_num = 0;
+    gMemdiskLazy = FALSE;
+}
+
+/*
+ * Compressed memdisk (VTOY_MEMDISK_COMPRESS=1 in grub).
+ * The image is kept in memory as independently LZ4 compressed blocks, a
+ * read decompresses the blocks it needs. A read of a whole block goes
+ * directly to the caller's buffer, partial reads go through a small LRU of
+ * decompressed blocks, since the same block is often read in pieces.
+ */
+STATIC UINT32 ventoy_cmem_block_len(IN UINT32 Block)
+{
+    UINT64 Offset = MultU64x32(Block, g_cmem_head->block_size);
+
+    if (Offset + g_cmem_head->block_size > g_cmem_head->img_size)
+    {
+        return (UINT32)(g_cmem_head->img_size - Offset);
+    }
+
+    return g_cmem_head->block_size;
+}
+
+STATIC EFI_STATUS ventoy_cmem_decode(IN UINT32 Block, OUT UINT8 *Dst)
+{
+    UINT32 Len = ventoy_cmem_block_len(Block);
+    ventoy_cmem_block *node = g_cmem_block + Block;
+
+    if (node->size == 0)
+    {
+        SetMem(Dst, Len, 0);
+    }
+    else if (node->size == Len)
+    {
+        CopyMem(Dst, (VOID *)(UINTN)node->addr, Len);
+    }
+    else
+    {
+        if (ventoy_lz4_decompress((UINT8 *)(UINTN)node->addr, node->size, Dst, Len) != (INT32)Len)
+        {
+            debug("cmem decode block %u failed", Block);
+            return EFI_DEVICE_ERROR;
+        }
+        g_cmem_decode++;
+        g_cmem_decode_bytes += Len;
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS ventoy_cmem_read(IN EFI_LBA Lba, IN UINTN BufferSize, OUT VOID *Buffer)
+{
+    UINT32 i = 0;
+    UINT32 Pos = 0;
+    UINT32 Slot = 0;
+    UINT32 Block = 0;
+    UINT32 BlockLen = 0;
+    UINTN Len = 0;
+    UINT64 Offset = MultU64x32(Lba, 2048);
+    UINT64 End = Offset + BufferSize;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    UINT8 *pData = NULL;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    while (Offset < End)
+    {
+        Block = (UINT32)DivU64x32Remainder(Offset, g_cmem_head->block_size, &Pos);
+        if (Block >= g_cmem_head->block_num)
+        {
+            SetMem(pCurBuf, (UINTN)(End - Offset), 0);
+            break;
+        }
+
+        BlockLen = ventoy_cmem_block_len(Block);
+        Len = g_cmem_head->block_size - Pos;
+        if (Len > End - Offset)
+        {
+            Len = (UINTN)(End - Offset);
+        }
+
+        if (Pos == 0 && Len == BlockLen)
+        {
+            Status = ventoy_cmem_decode(Block, pCurBuf);
+            if (EFI_ERROR(Status))
+            {
+                return Status;
+            }
+        }
+        else
+        {
+            for (i = 0, Slot = 0; i < VTOY_CMEM_LRU_NUM; i++)
+            {
+                if (g_cmem_lru_block[i] == Block)
+                {
+                    Slot = i;
+                    break;
+                }
+
+                if (g_cmem_lru_stamp[i] < g_cmem_lru_stamp[Slot])
+                {
+                    Slot = i;
+                }
+            }
+
+            pData = g_cmem_lru_buf + Slot * g_cmem_head->block_size;
+            if (i < VTOY_CMEM_LRU_NUM)
+            {
+                g_cmem_hit++;
+            }
+            else
+            {
+                /* the tail after the image end of the last block reads as zero */
+                SetMem(pData, g_cmem_head->block_size, 0);
+                g_cmem_lru_block[Slot] = MAX_UINT32;
+                Status = ventoy_cmem_decode(Block, pData);
+                if (EFI_ERROR(Status))
+                {
+                    return Status;
+                }
+                g_cmem_lru_block[Slot] = Block;
+            }
+
+            g_cmem_lru_stamp[Slot] = ++g_cmem_stamp;
+            CopyMem(pCurBuf, pData + Pos, Len);
+        }
+
+        pCurBuf += Len;
+        Offset += Len;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI ventoy_cmem_init(IN VOID *Head)
+{
+    UINT32 i = 0;
+    ventoy_cmem_head *head = (ventoy_cmem_head *)Head;
+
+    if (head->block_size == 0 || (head->block_size % 2048) || head->block_size > VTOY_CMEM_MAX_BLOCK ||
+        head->block_num != DivU64x32(head->img_size + head->block_size - 1, head->block_size))
+    {
+        debug("invalid compressed memdisk %u %u %lu", head->block_size, head->block_num, head->img_size);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    g_cmem_lru_buf = AllocatePages(EFI_SIZE_TO_PAGES(VTOY_CMEM_LRU_NUM * head->block_size));
+    if (!g_cmem_lru_buf)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (i = 0; i < VTOY_CMEM_LRU_NUM; i++)
+    {
+        g_cmem_lru_block[i] = MAX_UINT32;
+        g_cmem_lru_stamp[i] = 0;
+    }
+
+    g_cmem_head = head;
+    g_cmem_block = (ventoy_cmem_block *)(head + 1);
+    gMemdiskCompressed = TRUE;
+
+    debug("compressed memdisk image:%lu stored:%lu block:%u", head->img_size, head->mem_size, head->block_num);
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI ventoy_cmem_fini(VOID)
+{
+    if (!gMemdiskCompressed)
+    {
+        return;
+    }
+
+    debug("cmem lru hit:%lu decode:%lu decode bytes:%lu", g_cmem_hit, g_cmem_decode, g_cmem_decode_bytes);
+
+    FreePages(g_cmem_lru_buf, EFI_SIZE_TO_PAGES(VTOY_CMEM_LRU_NUM * g_cmem_head->block_size));
+    g_cmem_lru_buf = NULL;
+    g_cmem_head = NULL;
+    g_cmem_block = NULL;
+    gMemdiskCompressed = FALSE;
+}
+
+EFI_STATUS EFIAPI ventoy_block_io_ramdisk_write
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    IN VOID                           *Buffer
+)
+{
+    (VOID)This;
+    (VOID)MediaId;
+    (VOID)Lba;
+    (VOID)BufferSize;
+    (VOID)Buffer;
+
+    if (!gSector512Mode || gMemdiskCompressed)
+    {
+        return EFI_WRITE_PROTECTED;
+    }
+
+    if (EFI_ERROR(ventoy_memdisk_ensure(Lba, BufferSize)))
+    {
+        return EFI_DEVICE_ERROR;
+    }
+
+    CopyMem(g_iso_data_buf + (Lba * 2048), Buffer, BufferSize);
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI ventoy_block_io_ramdisk_read
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    OUT VOID                          *Buffer
+)
+{
+    //debug("### ventoy_block_io_ramdisk_read sector:%u count:%u", (UINT32)Lba, (UINT32)BufferSize / 2048);
+
+    (VOID)This;
+    (VOID)MediaId;
+
+    if (gMemdiskCompressed)
+    {
+        if (EFI_ERROR(ventoy_cmem_read(Lba, BufferSize, Buffer)))
+        {
+            return EFI_DEVICE_ERROR;
+        }
+    }
+    else
+    {
+        if (EFI_ERROR(ventoy_memdisk_ensure(Lba, BufferSize)))
+        {
+            return EFI_DEVICE_ERROR;
+        }
+
+        CopyMem(Buffer, g_iso_data_buf + (Lba * 2048), BufferSize);
+    }
+
+    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    {
+        if (*(UINT32 *)Buffer == 0x66676572)
+        {
+            g_blockio_bcd_read_done = TRUE;
+        }
+    }
+
+	return EFI_SUCCESS;
+}
+
+EFI_LBA EFIAPI ventoy_fixup_iso9660_sector(IN EFI_LBA Lba, UINT32 secNum)
+{
+    UINT32 i = 0;
+
+    if (g_fixup_iso9660_secover_cur_secs > 0)
+    {
+        Lba += VENTOY_ISO9660_SECTOR_OVERFLOW;
+        g_fixup_iso9660_secover_cur_secs += secNum;
+        if (g_fixup_iso9660_secover_cur_secs >= g_fixup_iso9660_secover_tot_secs)
+        {
+            g_fixup_iso9660_secover_start = FALSE;
+            goto end;
+        }
+    }
+    else
+    {
+        ventoy_iso9660_override *dirent;
+        ventoy_override_chunk *pOverride;
+
+        for (i = 0, pOverride = g_override_chunk; i < g_override_chunk_num; i++, pOverride++)
+        {
+            dirent = (ventoy_iso9660_override *)pOverride->override_data;
+            if (Lba == dirent->first_sector)
+            {
+                g_fixup_iso9660_secover_start = FALSE;
+                goto end;
+            }
+        }
+
+        if (g_fixup_iso9660_secover_start)
+        {
+            for (i = 0, pOverride = g_override_chunk; i < g_override_chunk_num; i++, pOverride++)
+            {
+                dirent = (ventoy_iso9660_override *)pOverride->override_data;
+                if (Lba + VENTOY_ISO9660_SECTOR_OVERFLOW == dirent->first_sector)
+                {
+                    g_fixup_iso9660_secover_tot_secs = (dirent->size + 2047) / 2048;
+                    g_fixup_iso9660_secover_cur_secs = secNum;
+                    if (g_fixup_iso9660_secover_cur_secs >= g_fixup_iso9660_secover_tot_secs)
+                    {
+                        g_fixup_iso9660_secover_start = FALSE;
+                    }
+                    Lba += VENTOY_ISO9660_SECTOR_OVERFLOW;
+                    goto end;
+                }
+            }
+        }
+    }
+
+end:
+    return Lba;
+}
+
+EFI_STATUS EFIAPI ventoy_block_io_read_real
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    OUT VOID                          *Buffer
+)
+{
+    UINT32 i = 0;
+    UINT32 lbacount = 0;
+    UINT32 secNum = 0;
+    UINT32 TmpNum = 0;
+    UINT64 VirtSec = 0;
+    UINT64 offset = 0;
+    EFI_LBA EndLba = 0;
+    EFI_LBA RemapLba = 0;
+    EFI_LBA lastlba = 0;
+    UINT8 *lastbuffer = NULL;
+    ventoy_virt_range *range = NULL;
+    ventoy_virt_chunk *node = NULL;
+
+    debug("### block_io_read_real sector:%u count:%u Buffer:%p", (UINT32)Lba, (UINT32)BufferSize / 2048, Buffer);
+
+    secNum = BufferSize / 2048;
+
+    /* Workaround for SSTR PE loader error */
+    if (g_fixup_iso9660_secover_start)
+    {
+        Lba = ventoy_fixup_iso9660_sector(Lba, secNum);
+    }
+
+    offset = Lba * 2048;
+
+    if (offset + BufferSize <= g_chain->real_img_size_in_bytes)
+    {
+        return ventoy_read_iso_sector(Lba, secNum, Buffer);
+    }
+    else if (offset < g_chain->real_img_size_in_bytes)
+    {
+        TmpNum = (g_chain->real_img_size_in_bytes - offset) / 2048;
+        ventoy_read_iso_sector(Lba, TmpNum, Buffer);
+
+        Lba += TmpNum;
+        secNum -= TmpNum;
+        Buffer = (UINT8 *)Buffer + (g_chain->real_img_size_in_bytes - offset);
+        offset = Lba * 2048;
+    }
+
+    VirtSec = g_chain->virt_img_size_in_bytes / 2048;
+    if (Lba >= VirtSec)
+    {
+        return EFI_SUCCESS;
+    }
+    else if (Lba + secNum > VirtSec)
+    {
+        secNum = VirtSec - Lba;
+    }
+
+    debug("XXX block_io_read_real sector:%u count:%u Buffer:%p", (UINT32)Lba, (UINT32)BufferSize / 2048, Buffer);
+    g_io_trace_flags |= VTOY_IO_TRACE_VIRT;
+
+    EndLba = Lba + secNum;
+    for (i = ventoy_first_virt_range(Lba); i < g_virt_range_num && Lba < EndLba; i++)
+    {
+        range = g_virt_range + i;
+        if (range->start >= EndLba)
+        {
+            break;
+        }
+
+        /* sectors not covered by any virt chunk are left untouched */
+        if (range->start > Lba)
+        {
+            Buffer = (UINT8 *)Buffer + (range->start - Lba) * 2048;
+            Lba = range->start;
+        }
+
+        node = g_virt_chunk + range->chunk;
+        TmpNum = (UINT32)(((range->end < EndLba) ? range->end : EndLba) - Lba);
+
+        if (range->type == VTOY_VIRT_RANGE_MEM)
+        {
+            CopyMem(Buffer,
+                   (char *)g_virt_chunk + node->mem_sector_offset + (Lba - node->mem_sector_start) * 2048,
+                   TmpNum * 2048);
+        }
+        else
+        {
+            /* merge the remap ranges which are also continuous in the image */
+            RemapLba = node->org_sector_start + Lba - node->remap_sector_start;
+            if (lbacount > 0 && lastlba + lbacount == RemapLba &&
+                lastbuffer + lbacount * 2048 == (UINT8 *)Buffer)
+            {
+                lbacount += TmpNum;
+            }
+            else
+            {
+                if (lbacount > 0)
+                {
+                    ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
+                }
+                lastbuffer = (UINT8 *)Buffer;
+                lastlba = RemapLba;
+                lbacount = TmpNum;
+            }
+        }
+
+        Buffer = (UINT8 *)Buffer + TmpNum * 2048;
+        Lba += TmpNum;
+    }
+
+    if (lbacount > 0)
+    {
+        ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
+    }
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Aligned bounce buffers for callers whose buffer violates the raw disk
+ * IoAlign (Windows Setup does this a lot). They are allocated once at
+ * install time. A request uses the smallest free buffer big enough for
+ * it, or the largest free one and is split into pieces. Only when all
+ * buffers are busy (reentrant read) a buffer is allocated for the request.
+ * A buffer is taken and released under TPL_CALLBACK, an entry with size 0
+ * (allocation failed or freed) is never used.
+ */
+EFI_STATUS EFIAPI ventoy_bounce_init(VOID)
+{
+    UINT32 i = 0;
+    UINT32 Align = EFI_PAGE_SIZE;
+    UINT32 IoAlign = gBlockData.pRawBlockIo->Media->IoAlign;
+
+    if (IoAlign <= 1)
+    {
+        return EFI_SUCCESS;
+    }
+
+    if (IoAlign > Align)
+    {
+        Align = IoAlign;
+    }
+
+    for (i = 0; i < VTOY_BOUNCE_NUM; i++)
+    {
+        g_bounce_buf[i].size = (i < VTOY_BOUNCE_SMALL_NUM) ? VTOY_BOUNCE_SMALL : VTOY_BOUNCE_LARGE;
+        g_bounce_buf[i].busy = FALSE;
+        g_bounce_buf[i].data = AllocateAlignedPages(EFI_SIZE_TO_PAGES(g_bounce_buf[i].size), Align);
+        if (!g_bounce_buf[i].data)
+        {
+            debug("Failed to alloc bounce buffer %u", i);
+            g_bounce_buf[i].busy = TRUE;
+            g_bounce_buf[i].size = 0;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+VOID EFIAPI ventoy_bounce_free(VOID)
+{
+    UINT32 i = 0;
+
+    for (i = 0; i < VTOY_BOUNCE_NUM; i++)
+    {
+        if (g_bounce_buf[i].data)
+        {
+            FreeAlignedPages(g_bounce_buf[i].data, EFI_SIZE_TO_PAGES(g_bounce_buf[i].size));
+            g_bounce_buf[i].data = NULL;
+        }
+
+        /* a read after cleanup must not use it */
+        g_bounce_buf[i].busy = TRUE;
+        g_bounce_buf[i].size = 0;
+    }
+}
+
+STATIC ventoy_bounce_buf * ventoy_bounce_get(IN UINTN Size)
+{
+    UINT32 i = 0;
+    EFI_TPL OldTpl;
+    ventoy_bounce_buf *Fit = NULL;
+    ventoy_bounce_buf *Largest = NULL;
+
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+    /* buffers are sorted by size */
+    for (i = 0; i < VTOY_BOUNCE_NUM; i++)
+    {
+        if (g_bounce_buf[i].busy || g_bounce_buf[i].size == 0)
+        {
+            continue;
+        }
+
+        if (!Fit && g_bounce_buf[i].size >= Size)
+        {
+            Fit = g_bounce_buf + i;
+        }
+        Largest = g_bounce_buf + i;
+    }
+
+    if (Fit == NULL)
+    {
+        Fit = Largest;
+    }
+
+    if (Fit)
+    {
+        Fit->busy = TRUE;
+    }
+
+    gBS->RestoreTPL(OldTpl);
+    return Fit;
+}
+
+STATIC VOID ventoy_bounce_put(IN ventoy_bounce_buf *Bounce)
+{
+    EFI_TPL OldTpl;
+
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+    Bounce->busy = FALSE;
+    gBS->RestoreTPL(OldTpl);
+}
+
+STATIC EFI_STATUS ventoy_bounce_read
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    OUT VOID                          *Buffer
+)
+{
+    UINTN Pos = 0;
+    UINTN Len = 0;
+    UINT32 IoAlign = gBlockData.pRawBlockIo->Media->IoAlign;
+    VOID *NewBuf = NULL;
+    ventoy_bounce_buf *Bounce = NULL;
+    EFI_STATUS Status = EFI_OUT_OF_RESOURCES;
+
+    g_bounce_read++;
+    g_io_trace_flags |= VTOY_IO_TRACE_BOUNCE;
+
+    Bounce = ventoy_bounce_get(BufferSize);
+    if (!Bounce)
+    {
+        g_bounce_alloc++;
+        NewBuf = AllocatePages(EFI_SIZE_TO_PAGES(BufferSize + IoAlign));
+        if (NewBuf)
+        {
+            Status = ventoy_block_io_read_real(This, MediaId, Lba, BufferSize, NewBuf);
+            CopyMem(Buffer, NewBuf, BufferSize);
+            FreePages(NewBuf, EFI_SIZE_TO_PAGES(BufferSize + IoAlign));
+        }
+        return Status;
+    }
+
+    for (Pos = 0; Pos < BufferSize; Pos += Len)
+    {
+        Len = BufferSize - Pos;
+        if (Len > Bounce->size)
+        {
+            Len = Bounce->size;
+        }
+
+        if (Pos > 0)
+        {
+            g_bounce_split++;
+        }
+
+        /* LBA is always in 2048 here, also in 512 mode */
+        Status = ventoy_block_io_read_real(This, MediaId, Lba + Pos / 2048, Len, Bounce->data);
+        if (EFI_ERROR(Status))
+        {
+            break;
+        }
+
+        CopyMem((UINT8 *)Buffer + Pos, Bounce->data, Len);
+    }
+
+    ventoy_bounce_put(Bounce);
+
+    return Status;
+}
+
+EFI_STATUS EFIAPI ventoy_block_io_read
+(
+    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN UINT32                          MediaId,
+    IN EFI_LBA                         Lba,
+    IN UINTN                           BufferSize,
+    OUT VOID                          *Buffer
+)
+{
+    UINT32 IoAlign = 0;
+    EFI_STATUS Status = EFI_OUT_OF_RESOURCES;
+
+    if (gBlockData.pRawBlockIo && gBlockData.pRawBlockIo->Media)
+    {
+        IoAlign = gBlockData.pRawBlockIo->Media->IoAlign;
+    }
+
+    if (g_io_trace)
+    {
+        ventoy_trace_begin();
+    }
 
-            Count -= secRead;
-            Sector += secRead;
-            pCurBuf += secRead * 2048;
-        }
+    if ((IoAlign == 0) || (((UINTN) Buffer & (IoAlign - 1)) == 0))
+    {
+        Status = ventoy_block_io_read_real(This, MediaId, Lba, BufferSize, Buffer);
+    }
+    else
+    {
+        Status = ventoy_bounce_read(This, MediaId, Lba, BufferSize, Buffer);
     }
 
-    return EFI_SUCCESS;
+    if (g_io_trace)
+    {
+        ventoy_trace_end(Lba, BufferSize, Status);
+    }
+
+    return Status;
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_ramdisk_write
+EFI_STATUS EFIAPI ventoy_block_io_write
 (
     IN EFI_BLOCK_IO_PROTOCOL          *This,
     IN UINT32                          MediaId,
@@ -333,296 +2037,339 @@ EFI_STATUS EFIAPI ventoy_block_io_ramdisk_write
     IN VOID                           *Buffer
 )
 {
+    UINT32 secNum = 0;
+    UINT64 offset = 0;
+
     (VOID)This;
     (VOID)MediaId;
-    (VOID)Lba;
-    (VOID)BufferSize;
-    (VOID)Buffer;
 
     if (!gSector512Mode)
     {
         return EFI_WRITE_PROTECTED;
     }
 
-    CopyMem(g_iso_data_buf + (Lba * 2048), Buffer, BufferSize);
+    secNum = BufferSize / 2048;
+    offset = Lba * 2048;
+
+    return ventoy_write_iso_sector(Lba, secNum, Buffer);
+}
 
+EFI_STATUS EFIAPI ventoy_block_io_flush(IN EFI_BLOCK_IO_PROTOCOL *This)
+{
+	(VOID)This;
 	return EFI_SUCCESS;
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_ramdisk_read
+#if 0
+/* Block IO2 procotol */
+#endif
+
+/*
+ * BlockIo2 over the same chunk engine as BlockIo.
+ * A read which is inside the real image, not covered by any override chunk
+ * and with a buffer aligned for the raw disk is split into one raw BlockIo2
+ * read per image chunk, and the token is signaled when all of them complete.
+ * All the other requests (virt chunks, overrides, memdisk, 512 mode ...) are
+ * done by the BlockIo functions and the token is signaled at once.
+ */
+EFI_STATUS EFIAPI ventoy_block_io2_reset
 (
-    IN EFI_BLOCK_IO_PROTOCOL          *This,
-    IN UINT32                          MediaId,
-    IN EFI_LBA                         Lba,
-    IN UINTN                           BufferSize,
-    OUT VOID                          *Buffer
+    IN EFI_BLOCK_IO2_PROTOCOL         *This,
+    IN BOOLEAN                        ExtendedVerification
 )
 {
-    //debug("### ventoy_block_io_ramdisk_read sector:%u count:%u", (UINT32)Lba, (UINT32)BufferSize / 2048);
-
     (VOID)This;
-    (VOID)MediaId;
+    (VOID)ExtendedVerification;
+    return EFI_SUCCESS;
+}
 
-    CopyMem(Buffer, g_iso_data_buf + (Lba * 2048), BufferSize);
+STATIC BOOLEAN ventoy_override_hit(IN UINT64 ReadStart, IN UINT64 ReadEnd)
+{
+    UINT32 i = 0;
+    ventoy_override_chunk *pOverride = NULL;
 
-    if (g_blockio_start_record_bcd && FALSE == g_blockio_bcd_read_done)
+    for (i = ventoy_first_override(ReadStart); i < g_override_chunk_num; i++)
     {
-        if (*(UINT32 *)Buffer == 0x66676572)
+        pOverride = g_override_chunk + (g_override_index ? g_override_index[i] : i);
+        if (pOverride->img_offset < ReadEnd && ReadStart < pOverride->img_offset + pOverride->override_size)
         {
-            g_blockio_bcd_read_done = TRUE;
+            return TRUE;
+        }
+
+        if (g_override_index && pOverride->img_offset >= ReadEnd)
+        {
+            break;
         }
     }
 
-	return EFI_SUCCESS;
+    return FALSE;
 }
 
-EFI_LBA EFIAPI ventoy_fixup_iso9660_sector(IN EFI_LBA Lba, UINT32 secNum)
+STATIC VOID ventoy_io2_request_put(IN ventoy_io2_request *Req, IN UINT32 Count)
 {
-    UINT32 i = 0;
+    UINT64 Tsc = 0;
+    EFI_TPL OldTpl;
+    BOOLEAN Done = FALSE;
 
-    if (g_fixup_iso9660_secover_cur_secs > 0)
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+    Req->Pending -= Count;
+    Done = (Req->Pending == 0) ? TRUE : FALSE;
+    gBS->RestoreTPL(OldTpl);
+
+    if (Done)
     {
-        Lba += VENTOY_ISO9660_SECTOR_OVERFLOW;
-        g_fixup_iso9660_secover_cur_secs += secNum;
-        if (g_fixup_iso9660_secover_cur_secs >= g_fixup_iso9660_secover_tot_secs)
+        if (g_io_trace)
         {
-            g_fixup_iso9660_secover_start = FALSE;
-            goto end;
+            /* the whole request is raw disk reads, one per chunk */
+            Tsc = ventoy_read_tsc() - Req->Tsc;
+            ventoy_trace_record(Req->Lba, Req->Size, Tsc, Tsc, Req->SubNum, Req->SubNum,
+                                VTOY_IO_TRACE_ASYNC | (EFI_ERROR(Req->Status) ? VTOY_IO_TRACE_ERROR : 0));
         }
+
+        Req->Token->TransactionStatus = Req->Status;
+        gBS->SignalEvent(Req->Token->Event);
+        FreePool(Req);
     }
-    else
-    {
-        ventoy_iso9660_override *dirent;
-        ventoy_override_chunk *pOverride;
+}
 
-        for (i = 0, pOverride = g_override_chunk; i < g_override_chunk_num; i++, pOverride++)
-        {
-            dirent = (ventoy_iso9660_override *)pOverride->override_data;
-            if (Lba == dirent->first_sector)
-            {
-                g_fixup_iso9660_secover_start = FALSE;
-                goto end;
-            }
-        }
+STATIC VOID EFIAPI ventoy_io2_sub_done(IN EFI_EVENT Event, IN VOID *Context)
+{
+    UINT32 i = 0;
+    ventoy_io2_request *Req = (ventoy_io2_request *)Context;
 
-        if (g_fixup_iso9660_secover_start)
+    for (i = 0; i < Req->SubNum; i++)
+    {
+        if (Req->SubToken[i].Event == Event)
         {
-            for (i = 0, pOverride = g_override_chunk; i < g_override_chunk_num; i++, pOverride++)
+            if (EFI_ERROR(Req->SubToken[i].TransactionStatus))
             {
-                dirent = (ventoy_iso9660_override *)pOverride->override_data;
-                if (Lba + VENTOY_ISO9660_SECTOR_OVERFLOW == dirent->first_sector)
-                {
-                    g_fixup_iso9660_secover_tot_secs = (dirent->size + 2047) / 2048;
-                    g_fixup_iso9660_secover_cur_secs = secNum;
-                    if (g_fixup_iso9660_secover_cur_secs >= g_fixup_iso9660_secover_tot_secs)
-                    {
-                        g_fixup_iso9660_secover_start = FALSE;
-                    }
-                    Lba += VENTOY_ISO9660_SECTOR_OVERFLOW;
-                    goto end;
-                }
+                debug("Raw disk read ex failed %r", Req->SubToken[i].TransactionStatus);
+                Req->Status = Req->SubToken[i].TransactionStatus;
             }
+            break;
         }
     }
 
-end:
-    return Lba;
+    gBS->CloseEvent(Event);
+    ventoy_io2_request_put(Req, 1);
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_read_real
+STATIC EFI_STATUS ventoy_read_iso_sector_ex
 (
-    IN EFI_BLOCK_IO_PROTOCOL          *This,
-    IN UINT32                          MediaId,
-    IN EFI_LBA                         Lba,
-    IN UINTN                           BufferSize,
-    OUT VOID                          *Buffer
+    IN UINT64                 Sector,
+    IN UINTN                  Count,
+    IN EFI_BLOCK_IO2_TOKEN   *Token,
+    OUT VOID                 *Buffer
 )
 {
     UINT32 i = 0;
-    UINT32 j = 0;
-    UINT32 lbacount = 0;
-    UINT32 secNum = 0;
-    UINT32 TmpNum = 0;
-    UINT64 VirtSec = 0;
-    UINT64 offset = 0;
-    EFI_LBA curlba = 0;
-    EFI_LBA lastlba = 0;
-    UINT8 *lastbuffer;
-    ventoy_sector_flag *cur_flag;
-    ventoy_virt_chunk *node;
-
-    debug("### block_io_read_real sector:%u count:%u Buffer:%p", (UINT32)Lba, (UINT32)BufferSize / 2048, Buffer);
-
-    secNum = BufferSize / 2048;
-
-    /* Workaround for SSTR PE loader error */
-    if (g_fixup_iso9660_secover_start)
-    {
-        Lba = ventoy_fixup_iso9660_sector(Lba, secNum);
-    }
-
-    offset = Lba * 2048;
+    UINT32 First = 0;
+    UINT32 SubNum = 0;
+    UINTN Left = Count;
+    UINTN secRead = 0;
+    UINT64 CurSec = Sector;
+    EFI_LBA MapLba = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT8 *pCurBuf = (UINT8 *)Buffer;
+    ventoy_img_chunk *pchunk = NULL;
+    ventoy_io2_request *Req = NULL;
+    EFI_BLOCK_IO2_PROTOCOL *pRawBlockIo2 = gBlockData.pRawBlockIo2;
 
-    if (offset + BufferSize <= g_chain->real_img_size_in_bytes)
-    {
-        return ventoy_read_iso_sector(Lba, secNum, Buffer);
-    }
-    else if (offset < g_chain->real_img_size_in_bytes)
+    First = ventoy_find_chunk(Sector);
+    for (i = First; Left > 0 && i < g_img_chunk_num; i++)
     {
-        TmpNum = (g_chain->real_img_size_in_bytes - offset) / 2048;
-        ventoy_read_iso_sector(Lba, TmpNum, Buffer);
+        pchunk = g_chunk + i;
+        if (CurSec < pchunk->img_start_sector || CurSec > pchunk->img_end_sector)
+        {
+            return EFI_UNSUPPORTED;
+        }
 
-        Lba += TmpNum;
-        secNum -= TmpNum;
-        Buffer = (UINT8 *)Buffer + (g_chain->real_img_size_in_bytes - offset);
-        offset = Lba * 2048;
+        secRead = pchunk->img_end_sector + 1 - CurSec;
+        secRead = (Left < secRead) ? Left : secRead;
+        Left -= secRead;
+        CurSec += secRead;
+        SubNum++;
     }
 
-    VirtSec = g_chain->virt_img_size_in_bytes / 2048;
-    if (Lba >= VirtSec)
-    {
-        return EFI_SUCCESS;
-    }
-    else if (Lba + secNum > VirtSec)
+    if (Left > 0)
     {
-        secNum = VirtSec - Lba;
+        return EFI_UNSUPPORTED;
     }
 
-    debug("XXX block_io_read_real sector:%u count:%u Buffer:%p", (UINT32)Lba, (UINT32)BufferSize / 2048, Buffer);
-
-    if (secNum > g_sector_flag_num)
+    Req = AllocateZeroPool(sizeof(ventoy_io2_request) + (SubNum - 1) * sizeof(EFI_BLOCK_IO2_TOKEN));
+    if (NULL == Req)
     {
-        cur_flag = AllocatePool(secNum * sizeof(ventoy_sector_flag));
-        if (NULL == cur_flag)
-        {
-            return EFI_OUT_OF_RESOURCES;
-        }
-
-        FreePool(g_sector_flag);
-        g_sector_flag = cur_flag;
-        g_sector_flag_num = secNum;
+        return EFI_UNSUPPORTED;
     }
 
-    for (curlba = Lba, cur_flag = g_sector_flag, j = 0; j < secNum; j++, curlba++, cur_flag++)
+    for (i = 0; i < SubNum; i++)
     {
-        cur_flag->flag = 0;
-        for (node = g_virt_chunk, i = 0; i < g_virt_chunk_num; i++, node++)
+        Status = gBS->CreateEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, ventoy_io2_sub_done, Req, &(Req->SubToken[i].Event));
+        if (EFI_ERROR(Status))
         {
-            if (curlba >= node->mem_sector_start && curlba < node->mem_sector_end)
-            {
-                CopyMem((UINT8 *)Buffer + j * 2048,
-                       (char *)g_virt_chunk + node->mem_sector_offset + (curlba - node->mem_sector_start) * 2048,
-                       2048);
-                cur_flag->flag = 1;
-                break;
-            }
-            else if (curlba >= node->remap_sector_start && curlba < node->remap_sector_end)
+            while (i > 0)
             {
-                cur_flag->remap_lba = node->org_sector_start + curlba - node->remap_sector_start;
-                cur_flag->flag = 2;
-                break;
+                gBS->CloseEvent(Req->SubToken[--i].Event);
             }
+            FreePool(Req);
+            return EFI_UNSUPPORTED;
         }
     }
 
-    for (curlba = Lba, cur_flag = g_sector_flag, j = 0; j < secNum; j++, curlba++, cur_flag++)
+    /* one more reference for the submit loop, so the token is not signaled before all are submitted */
+    Req->Token = Token;
+    Req->Status = EFI_SUCCESS;
+    Req->SubNum = SubNum;
+    Req->Lba = Sector;
+    Req->Size = Count * 2048;
+    Req->Tsc = ventoy_read_tsc();
+    Req->Pending = SubNum + 1;
+
+    CurSec = Sector;
+    Left = Count;
+    for (i = 0; i < SubNum; i++)
     {
-        if (cur_flag->flag == 2)
+        pchunk = g_chunk + First + i;
+
+        if (g_chain->disk_sector_size == 512)
         {
-            if (lastlba == 0)
-            {
-                lastbuffer = (UINT8 *)Buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
-            }
-            else if (lastlba + lbacount == cur_flag->remap_lba)
-            {
-                lbacount++;
-            }
-            else
+            MapLba = (CurSec - pchunk->img_start_sector) * 4 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 1024)
+        {
+            MapLba = (CurSec - pchunk->img_start_sector) * 2 + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 2048)
+        {
+            MapLba = (CurSec - pchunk->img_start_sector) + pchunk->disk_start_sector;
+        }
+        else if (g_chain->disk_sector_size == 4096)
+        {
+            MapLba = ((CurSec - pchunk->img_start_sector) >> 1) + pchunk->disk_start_sector;
+        }
+
+        secRead = pchunk->img_end_sector + 1 - CurSec;
+        secRead = (Left < secRead) ? Left : secRead;
+
+        Status = pRawBlockIo2->ReadBlocksEx(pRawBlockIo2, pRawBlockIo2->Media->MediaId,
+                                            MapLba, Req->SubToken + i, secRead * 2048, pCurBuf);
+        if (EFI_ERROR(Status))
+        {
+            debug("Raw disk read ex failed %r LBA:%lu Count:%u", Status, MapLba, secRead);
+
+            /* the rest are not submitted, nobody will signal them */
+            Req->Status = Status;
+            for (First = i; First < SubNum; First++)
             {
-                ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
-                lastbuffer = (UINT8 *)Buffer + j * 2048;
-                lastlba = cur_flag->remap_lba;
-                lbacount = 1;
+                gBS->CloseEvent(Req->SubToken[First].Event);
             }
+            ventoy_io2_request_put(Req, SubNum - i);
+            break;
         }
-    }
 
-    if (lbacount > 0)
-    {
-        ventoy_read_iso_sector(lastlba, lbacount, lastbuffer);
+        Left -= secRead;
+        CurSec += secRead;
+        pCurBuf += secRead * 2048;
     }
 
-	return EFI_SUCCESS;
+    ventoy_io2_request_put(Req, 1);
+    return EFI_SUCCESS;
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_read
+EFI_STATUS EFIAPI ventoy_block_io2_read
 (
-    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN EFI_BLOCK_IO2_PROTOCOL         *This,
     IN UINT32                          MediaId,
     IN EFI_LBA                         Lba,
+    IN OUT EFI_BLOCK_IO2_TOKEN        *Token,
     IN UINTN                           BufferSize,
     OUT VOID                          *Buffer
 )
 {
     UINT32 IoAlign = 0;
-    VOID *NewBuf = NULL;
-    EFI_STATUS Status = EFI_OUT_OF_RESOURCES;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_BLOCK_IO2_PROTOCOL *pRawBlockIo2 = gBlockData.pRawBlockIo2;
 
-    if (gBlockData.pRawBlockIo && gBlockData.pRawBlockIo->Media)
+    (VOID)This;
+
+    if (Buffer == NULL)
     {
-        IoAlign = gBlockData.pRawBlockIo->Media->IoAlign;
+        return EFI_INVALID_PARAMETER;
     }
 
-    if ((IoAlign == 0) || (((UINTN) Buffer & (IoAlign - 1)) == 0))
+    if (BufferSize % gBlockData.Media.BlockSize)
     {
-        Status = ventoy_block_io_read_real(This, MediaId, Lba, BufferSize, Buffer);
+        return EFI_BAD_BUFFER_SIZE;
     }
-    else
+
+    if (Token && Token->Event && pRawBlockIo2 && BufferSize > 0 &&
+        (!gMemdiskMode) && (!gSector512Mode) &&
+        (!g_fixup_iso9660_secover_start) && (!g_blockio_start_record_bcd || g_blockio_bcd_read_done) &&
+        (Lba * 2048 + BufferSize <= g_chain->real_img_size_in_bytes) &&
+        (!ventoy_override_hit(Lba * 2048, Lba * 2048 + BufferSize)))
     {
-        NewBuf = AllocatePages(EFI_SIZE_TO_PAGES(BufferSize + IoAlign));
-        if (NewBuf)
+        IoAlign = pRawBlockIo2->Media->IoAlign;
+        if ((IoAlign == 0) || (((UINTN) Buffer & (IoAlign - 1)) == 0))
         {
-            Status = ventoy_block_io_read_real(This, MediaId, Lba, BufferSize, NewBuf);
-            CopyMem(Buffer, NewBuf, BufferSize);
-            FreePages(NewBuf, EFI_SIZE_TO_PAGES(BufferSize + IoAlign));
+            Token->TransactionStatus = EFI_NOT_READY;
+            if (ventoy_read_iso_sector_ex(Lba, BufferSize / 2048, Token, Buffer) == EFI_SUCCESS)
+            {
+                return EFI_SUCCESS;
+            }
         }
     }
 
+    Status = gBlockData.BlockIo.ReadBlocks(&(gBlockData.BlockIo), MediaId, Lba, BufferSize, Buffer);
+    if (Token && Token->Event)
+    {
+        Token->TransactionStatus = Status;
+        gBS->SignalEvent(Token->Event);
+        return EFI_SUCCESS;
+    }
+
     return Status;
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_write
+EFI_STATUS EFIAPI ventoy_block_io2_write
 (
-    IN EFI_BLOCK_IO_PROTOCOL          *This,
+    IN EFI_BLOCK_IO2_PROTOCOL         *This,
     IN UINT32                          MediaId,
     IN EFI_LBA                         Lba,
+    IN OUT EFI_BLOCK_IO2_TOKEN        *Token,
     IN UINTN                           BufferSize,
     IN VOID                           *Buffer
 )
 {
-    UINT32 secNum = 0;
-    UINT64 offset = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
 
     (VOID)This;
-    (VOID)MediaId;
 
-    if (!gSector512Mode)
+    Status = gBlockData.BlockIo.WriteBlocks(&(gBlockData.BlockIo), MediaId, Lba, BufferSize, Buffer);
+    if (Token && Token->Event)
     {
-        return EFI_WRITE_PROTECTED;
+        Token->TransactionStatus = Status;
+        gBS->SignalEvent(Token->Event);
+        return EFI_SUCCESS;
     }
 
-    secNum = BufferSize / 2048;
-    offset = Lba * 2048;
-
-    return ventoy_write_iso_sector(Lba, secNum, Buffer);
+    return Status;
 }
 
-EFI_STATUS EFIAPI ventoy_block_io_flush(IN EFI_BLOCK_IO_PROTOCOL *This)
+EFI_STATUS EFIAPI ventoy_block_io2_flush
+(
+    IN EFI_BLOCK_IO2_PROTOCOL         *This,
+    IN OUT EFI_BLOCK_IO2_TOKEN        *Token
+)
 {
-	(VOID)This;
-	return EFI_SUCCESS;
+    (VOID)This;
+
+    if (Token && Token->Event)
+    {
+        Token->TransactionStatus = EFI_SUCCESS;
+        gBS->SignalEvent(Token->Event);
+    }
+
+    return EFI_SUCCESS;
 }
 
 STATIC UINTN ventoy_get_current_device_path_id(VOID)
@@ -1129,9 +2876,22 @@ EFI_STATUS EFIAPI ventoy_install_blockio(IN EFI_HANDLE ImageHandle, IN UINT64 Im
 {
     EFI_STATUS Status = EFI_SUCCESS;
     EFI_BLOCK_IO_PROTOCOL *pBlockIo = &(gBlockData.BlockIo);
+    EFI_BLOCK_IO2_PROTOCOL *pBlockIo2 = &(gBlockData.BlockIo2);
 
     ventoy_fill_device_path();
 
+    if (!gMemdiskMode)
+    {
+        Status = ventoy_build_range_index();
+        if (EFI_ERROR(Status))
+        {
+            return Status;
+        }
+
+        ventoy_cache_init();
+        ventoy_bounce_init();
+    }
+
     debug("install block io protocol %p", ImageHandle);
     ventoy_debug_pause();
 
@@ -1151,6 +2911,11 @@ EFI_STATUS EFIAPI ventoy_install_blockio(IN EFI_HANDLE ImageHandle, IN UINT64 Im
     gBlockData.Media.MediaPresent = 1;
     gBlockData.Media.LogicalBlocksPerPhysicalBlock = 1;
 
+    if (!gMemdiskMode)
+    {
+        ventoy_trace_init();
+    }
+
 	pBlockIo->Revision = EFI_BLOCK_IO_PROTOCOL_REVISION3;
 	pBlockIo->Media = &(gBlockData.Media);
 	pBlockIo->Reset = ventoy_block_io_reset;
@@ -1170,8 +2935,15 @@ EFI_STATUS EFIAPI ventoy_install_blockio(IN EFI_HANDLE ImageHandle, IN UINT64 Im
 
 	pBlockIo->FlushBlocks = ventoy_block_io_flush;
 
+    pBlockIo2->Media = &(gBlockData.Media);
+    pBlockIo2->Reset = ventoy_block_io2_reset;
+    pBlockIo2->ReadBlocksEx = ventoy_block_io2_read;
+    pBlockIo2->WriteBlocksEx = ventoy_block_io2_write;
+    pBlockIo2->FlushBlocksEx = ventoy_block_io2_flush;
+
     Status = gBS->InstallMultipleProtocolInterfaces(&gBlockData.Handle,
             &gEfiBlockIoProtocolGuid, &gBlockData.BlockIo,
+            &gEfiBlockIo2ProtocolGuid, &gBlockData.BlockIo2,
             &gEfiDevicePathProtocolGuid, gBlockData.Path,
             NULL);
     debug("Install protocol %r %p", Status, gBlockData.Handle);
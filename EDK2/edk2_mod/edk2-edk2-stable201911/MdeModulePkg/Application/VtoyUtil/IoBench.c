@@ -0,0 +1,259 @@
+/******************************************************************************
+ * IoBench.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Protocol/LoadedImage.h>
+#include <Guid/FileInfo.h>
+#include <Guid/FileSystemInfo.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+#include <Protocol/RamDisk.h>
+#include <Protocol/SimpleFileSystem.h>
+#include <VtoyUtil.h>
+
+/*
+ * Sequential read throughput of BlockIo and BlockIo2 on every disk which
+ * has both of them (e.g. the Ventoy virtual CD-ROM when run from a shell
+ * inside Ventoy.efi). feature=blockio_bench[:MB], default 64MB per disk.
+ * BlockIo2 keeps VTOY_BENCH_DEPTH requests in flight.
+ */
+
+#define VTOY_BENCH_BLOCK    (1024 * 1024)
+#define VTOY_BENCH_DEPTH    4
+#define VTOY_BENCH_SIZE_MB  64
+
+STATIC volatile UINT64 g_BenchTick = 0;
+
+STATIC VOID EFIAPI BenchTimerNotify(IN EFI_EVENT Event, IN VOID *Context)
+{
+    (VOID)Event;
+    (VOID)Context;
+    g_BenchTick++;
+}
+
+STATIC UINT64 BenchSpeed(IN UINT64 Bytes, IN UINT64 Ms)
+{
+    /* KB/s */
+    return DivU64x32(DivU64x64Remainder(MultU64x32(Bytes, 1000), (Ms == 0) ? 1 : Ms, NULL), 1024);
+}
+
+STATIC EFI_STATUS BenchBlockIo(IN EFI_BLOCK_IO_PROTOCOL *BlockIo, IN UINT64 Size, IN VOID *Buffer, OUT UINT64 *Ms)
+{
+    UINT64 Pos = 0;
+    UINT64 Start = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT32 BlockSize = BlockIo->Media->BlockSize;
+
+    Start = g_BenchTick;
+    for (Pos = 0; Pos < Size; Pos += VTOY_BENCH_BLOCK)
+    {
+        Status = BlockIo->ReadBlocks(BlockIo, BlockIo->Media->MediaId, DivU64x32(Pos, BlockSize), VTOY_BENCH_BLOCK, Buffer);
+        if (EFI_ERROR(Status))
+        {
+            break;
+        }
+    }
+    *Ms = g_BenchTick - Start;
+
+    return Status;
+}
+
+STATIC EFI_STATUS BenchBlockIo2(IN EFI_BLOCK_IO2_PROTOCOL *BlockIo2, IN UINT64 Size, IN UINT8 *Buffer, OUT UINT64 *Ms)
+{
+    UINTN i = 0;
+    UINTN Index = 0;
+    UINTN Pending = 0;
+    UINT64 Pos = 0;
+    UINT64 Start = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_EVENT Events[VTOY_BENCH_DEPTH];
+    EFI_BLOCK_IO2_TOKEN Tokens[VTOY_BENCH_DEPTH];
+    UINT32 BlockSize = BlockIo2->Media->BlockSize;
+
+    for (i = 0; i < VTOY_BENCH_DEPTH; i++)
+    {
+        Status = gBS->CreateEvent(0, 0, NULL, NULL, &Events[i]);
+        if (EFI_ERROR(Status))
+        {
+            while (i > 0)
+            {
+                gBS->CloseEvent(Events[--i]);
+            }
+            return Status;
+        }
+        Tokens[i].Event = Events[i];
+    }
+
+    Start = g_BenchTick;
+
+    /* fill the queue, then submit a new request each time one completes */
+    for (i = 0; i < VTOY_BENCH_DEPTH && Pos < Size; i++, Pos += VTOY_BENCH_BLOCK)
+    {
+        Status = BlockIo2->ReadBlocksEx(BlockIo2, BlockIo2->Media->MediaId, DivU64x32(Pos, BlockSize),
+                                        Tokens + i, VTOY_BENCH_BLOCK, Buffer + i * VTOY_BENCH_BLOCK);
+        if (EFI_ERROR(Status))
+        {
+            break;
+        }
+        Pending++;
+    }
+
+    while (Pending > 0)
+    {
+        if (EFI_ERROR(gBS->WaitForEvent(VTOY_BENCH_DEPTH, Events, &Index)))
+        {
+            Status = EFI_DEVICE_ERROR;
+            break;
+        }
+        Pending--;
+
+        if (EFI_ERROR(Tokens[Index].TransactionStatus))
+        {
+            Status = Tokens[Index].TransactionStatus;
+        }
+
+        if (!EFI_ERROR(Status) && Pos < Size)
+        {
+            Status = BlockIo2->ReadBlocksEx(BlockIo2, BlockIo2->Media->MediaId, DivU64x32(Pos, BlockSize),
+                                            Tokens + Index, VTOY_BENCH_BLOCK, Buffer + Index * VTOY_BENCH_BLOCK);
+            if (!EFI_ERROR(Status))
+            {
+                Pending++;
+                Pos += VTOY_BENCH_BLOCK;
+            }
+        }
+    }
+
+    *Ms = g_BenchTick - Start;
+
+    for (i = 0; i < VTOY_BENCH_DEPTH; i++)
+    {
+        gBS->CloseEvent(Events[i]);
+    }
+
+    return Status;
+}
+
+EFI_STATUS BlockIoBench(IN EFI_HANDLE ImageHandle, IN CONST CHAR16 *CmdLine)
+{
+    UINTN i = 0;
+    UINTN Count = 0;
+    UINT64 Ms1 = 0;
+    UINT64 Ms2 = 0;
+    UINT64 Size = 0;
+    UINT64 DiskSize = 0;
+    UINT8 *Buffer = NULL;
+    EFI_EVENT Timer = NULL;
+    EFI_HANDLE *Handles = NULL;
+    EFI_STATUS Status1 = EFI_SUCCESS;
+    EFI_STATUS Status2 = EFI_SUCCESS;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_BLOCK_IO_PROTOCOL *BlockIo = NULL;
+    EFI_BLOCK_IO2_PROTOCOL *BlockIo2 = NULL;
+
+    (VOID)ImageHandle;
+
+    Size = VTOY_BENCH_SIZE_MB;
+    if (CmdLine && CmdLine[0] == L':')
+    {
+        Size = StrDecimalToUintn(CmdLine + 1);
+        if (Size == 0)
+        {
+            Size = VTOY_BENCH_SIZE_MB;
+        }
+    }
+    Size = MultU64x32(Size, VTOY_BENCH_BLOCK);
+
+    Status = gBS->LocateHandleBuffer(ByProtocol, &gEfiBlockIo2ProtocolGuid, NULL, &Count, &Handles);
+    if (EFI_ERROR(Status))
+    {
+        Printf("No BlockIo2 device found\n");
+        return Status;
+    }
+
+    Buffer = AllocatePages(EFI_SIZE_TO_PAGES(VTOY_BENCH_BLOCK * VTOY_BENCH_DEPTH));
+    Status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, BenchTimerNotify, NULL, &Timer);
+    if (NULL == Buffer || EFI_ERROR(Status))
+    {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto out;
+    }
+
+    /* 1ms tick, 100ns unit */
+    gBS->SetTimer(Timer, TimerPeriodic, 10000);
+
+    Printf("%-4a %10a %12a %12a\n", "disk", "size(MB)", "BlockIo", "BlockIo2");
+
+    for (i = 0; i < Count; i++)
+    {
+        if (EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo)) ||
+            EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiBlockIo2ProtocolGuid, (VOID **)&BlockIo2)))
+        {
+            continue;
+        }
+
+        if (!BlockIo->Media->MediaPresent || BlockIo->Media->LogicalPartition ||
+            BlockIo->Media->BlockSize == 0 || (VTOY_BENCH_BLOCK % BlockIo->Media->BlockSize))
+        {
+            continue;
+        }
+
+        DiskSize = MultU64x32(BlockIo->Media->LastBlock + 1, BlockIo->Media->BlockSize);
+        if (DiskSize < Size)
+        {
+            continue;
+        }
+
+        Status1 = BenchBlockIo(BlockIo, Size, Buffer, &Ms1);
+        Status2 = BenchBlockIo2(BlockIo2, Size, Buffer, &Ms2);
+
+        Printf("%-4u %10lu %9lu KB/s %9lu KB/s", (UINT32)i, DivU64x32(DiskSize, VTOY_BENCH_BLOCK),
+               BenchSpeed(Size, Ms1), BenchSpeed(Size, Ms2));
+        if (EFI_ERROR(Status1) || EFI_ERROR(Status2))
+        {
+            Printf("  (%r %r)", Status1, Status2);
+        }
+        Printf("\n");
+    }
+
+out:
+    if (Timer)
+    {
+        gBS->SetTimer(Timer, TimerCancel, 0);
+        gBS->CloseEvent(Timer);
+    }
+
+    if (Buffer)
+    {
+        FreePages(Buffer, EFI_SIZE_TO_PAGES(VTOY_BENCH_BLOCK * VTOY_BENCH_DEPTH));
+    }
+
+    FreePool(Handles);
+    return Status;
+}
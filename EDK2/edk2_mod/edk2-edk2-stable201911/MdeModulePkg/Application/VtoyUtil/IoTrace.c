@@ -0,0 +1,227 @@
+/******************************************************************************
+ * IoTrace.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <Uefi.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Protocol/LoadedImage.h>
+#include <Guid/FileInfo.h>
+#include <Guid/FileSystemInfo.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/RamDisk.h>
+#include <Protocol/SimpleFileSystem.h>
+#include <VtoyUtil.h>
+
+/*
+ * Save the I/O trace of Ventoy.efi (VTOY_UEFI_IO_TRACE) after the boot
+ * returned to grub. feature=io_trace_dump[:\path], the file is written to
+ * the partition vtoyutil is loaded from, default \ventoy_io_trace.bin.
+ * Chainloaded from ${vtoy_path} that is the small VTOYEFI partition, not
+ * the image partition: a full 256K entry ring is about 8MB.
+ * The entries are saved oldest first, see EDK2/vtoy_io_trace.sh.
+ * Async BlockIo2 reads are in the trace with the VTOY_IO_TRACE_ASYNC flag.
+ */
+
+#define VTOY_IO_TRACE_FILE  L"\\ventoy_io_trace.bin"
+
+STATIC VOID IoTracePrintSummary(IN ventoy_io_trace_head *head)
+{
+    UINT32 i = 0;
+    UINT64 Speed = 0;
+
+    Printf("read:%lu bytes:%lu time:%lums raw:%lums", head->next, head->total_bytes,
+           DivU64x32(head->total_us, 1000), DivU64x32(head->raw_us, 1000));
+    if (head->total_us > 0)
+    {
+        /* KB/s */
+        Speed = DivU64x64Remainder(MultU64x32(DivU64x32(head->total_bytes, 1024), 1000000), head->total_us, NULL);
+        Printf(" speed:%luKB/s", Speed);
+    }
+    Printf("\n");
+
+    if (head->tsc_per_ms == 0)
+    {
+        Printf("no time stamp counter, latency not available\n");
+    }
+
+    Printf("%-16a %10a    %-16a %10a\n", "latency(us)", "count", "size(KB)", "count");
+    for (i = 0; i < VTOY_IO_HIST_NUM; i++)
+    {
+        if (head->hist_us[i] == 0 && head->hist_kb[i] == 0)
+        {
+            continue;
+        }
+
+        /* bucket i holds [2^(i-1), 2^i) */
+        Printf("<%-15lu %10lu    <%-15lu %10lu\n", LShiftU64(1, i), head->hist_us[i], LShiftU64(1, i), head->hist_kb[i]);
+    }
+}
+
+STATIC EFI_STATUS IoTraceWrite(IN EFI_FILE_PROTOCOL *File, IN VOID *Buffer, IN UINTN Size)
+{
+    UINTN Len = Size;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (Size == 0)
+    {
+        return EFI_SUCCESS;
+    }
+
+    Status = File->Write(File, &Len, Buffer);
+    if (!EFI_ERROR(Status) && Len != Size)
+    {
+        Status = EFI_VOLUME_FULL;
+    }
+
+    return Status;
+}
+
+STATIC EFI_STATUS IoTraceSave(IN EFI_HANDLE ImageHandle, IN CONST CHAR16 *Path, IN ventoy_io_trace_head *head)
+{
+    UINTN Num = 0;
+    UINTN Start = 0;
+    UINT8 *pEntry = (UINT8 *)(head + 1);
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_FILE_PROTOCOL *Root = NULL;
+    EFI_FILE_PROTOCOL *File = NULL;
+    EFI_LOADED_IMAGE_PROTOCOL *pImageInfo = NULL;
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *pFs = NULL;
+
+    if (head->next > head->entry_num)
+    {
+        Num = (UINTN)head->entry_num;
+        Start = (UINTN)ModU64x32(head->next, (UINT32)head->entry_num);
+    }
+    else
+    {
+        Num = (UINTN)head->next;
+    }
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiLoadedImageProtocolGuid, (VOID **)&pImageInfo);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    Status = gBS->HandleProtocol(pImageInfo->DeviceHandle, &gEfiSimpleFileSystemProtocolGuid, (VOID **)&pFs);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    Status = pFs->OpenVolume(pFs, &Root);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    /* replace the old file */
+    Status = Root->Open(Root, &File, (CHAR16 *)Path, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+    if (!EFI_ERROR(Status))
+    {
+        File->Delete(File);
+    }
+
+    Status = Root->Open(Root, &File, (CHAR16 *)Path, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    if (EFI_ERROR(Status))
+    {
+        Root->Close(Root);
+        return Status;
+    }
+
+    Status = IoTraceWrite(File, head, sizeof(ventoy_io_trace_head));
+    if (!EFI_ERROR(Status))
+    {
+        Status = IoTraceWrite(File, pEntry + Start * sizeof(ventoy_io_trace_entry),
+                              (Num - Start) * sizeof(ventoy_io_trace_entry));
+    }
+    if (!EFI_ERROR(Status))
+    {
+        Status = IoTraceWrite(File, pEntry, Start * sizeof(ventoy_io_trace_entry));
+    }
+
+    if (EFI_ERROR(Status))
+    {
+        /* don't leave a truncated trace behind */
+        File->Delete(File);
+        if (Status == EFI_VOLUME_FULL)
+        {
+            Printf("No space for %lu bytes on the partition of vtoyutil (VTOYEFI), use a smaller VTOY_UEFI_IO_TRACE\n",
+                   (UINT64)(sizeof(ventoy_io_trace_head) + Num * sizeof(ventoy_io_trace_entry)));
+        }
+    }
+    else
+    {
+        File->Close(File);
+    }
+
+    Root->Close(Root);
+
+    return Status;
+}
+
+EFI_STATUS IoTraceDump(IN EFI_HANDLE ImageHandle, IN CONST CHAR16 *CmdLine)
+{
+    UINTN i = 0;
+    UINTN DataSize = 0;
+    UINT64 Addr = 0;
+    CHAR16 Path[256] = VTOY_IO_TRACE_FILE;
+    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_GUID VarGuid = VENTOY_GUID;
+    ventoy_io_trace_head *head = NULL;
+
+    if (CmdLine && CmdLine[0] == L':' && CmdLine[1] && CmdLine[1] != L' ')
+    {
+        for (i = 0; i < ARRAY_SIZE(Path) - 1 && CmdLine[i + 1] && CmdLine[i + 1] != L' '; i++)
+        {
+            Path[i] = CmdLine[i + 1];
+        }
+        Path[i] = 0;
+    }
+
+    DataSize = sizeof(Addr);
+    Status = gRT->GetVariable(L"VentoyIoTrace", &VarGuid, NULL, &DataSize, &Addr);
+    if (EFI_ERROR(Status) || Addr == 0)
+    {
+        Printf("No io trace found, set VTOY_UEFI_IO_TRACE in the control plugin and boot an image first\n");
+        return EFI_NOT_FOUND;
+    }
+
+    head = (ventoy_io_trace_head *)(UINTN)Addr;
+    if (head->magic != VTOY_IO_TRACE_MAGIC || head->version != VTOY_IO_TRACE_VERSION || head->entry_num == 0)
+    {
+        Printf("Invalid io trace at 0x%lx\n", Addr);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    IoTracePrintSummary(head);
+
+    Status = IoTraceSave(ImageHandle, Path, head);
+    Printf("Save io trace to %s %r\n", Path, Status);
+
+    return Status;
+}
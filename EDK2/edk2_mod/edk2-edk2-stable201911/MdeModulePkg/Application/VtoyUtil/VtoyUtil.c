@@ -45,6 +45,8 @@ STATIC VtoyUtilFeature gFeatureList[] =
 {
     { L"fix_windows_mmap", FixWindowsMemhole },
     { L"show_efi_drivers", ShowEfiDrivers    },
+    { L"blockio_bench",    BlockIoBench      },
+    { L"io_trace_dump",    IoTraceDump       },
 };
 
 EFI_STATUS VtoyGetComponentName(IN UINTN Ver, IN VOID *Protocol, OUT CHAR16 **DriverName)
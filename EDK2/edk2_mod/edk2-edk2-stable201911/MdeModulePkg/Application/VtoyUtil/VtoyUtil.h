@@ -22,6 +22,7 @@
 #define __VTOYUTIL_H__
 
 #define VTOY_SHIM_POLICY_GUID    {0x90a29d14, 0x3968, 0x48fe, { 0x85, 0x81, 0x6b, 0x7f, 0x7d, 0xc4, 0x70, 0x55 }};
+#define VENTOY_GUID { 0x77772020, 0x2e77, 0x6576, { 0x6e, 0x74, 0x6f, 0x79, 0x2e, 0x6e, 0x65, 0x74 }}
 
 #pragma pack(1)
 
@@ -50,6 +51,37 @@ typedef struct ventoy_grub_param
 }ventoy_grub_param;
 #pragma pack()
 
+/* I/O trace of Ventoy.efi, must be same with Ventoy.h */
+#define VTOY_IO_TRACE_MAGIC     0x434152544F495456ULL /* "VTIOTRAC" */
+#define VTOY_IO_TRACE_VERSION   1
+#define VTOY_IO_HIST_NUM        32
+
+typedef struct ventoy_io_trace_entry
+{
+    UINT64 lba;
+    UINT32 size;
+    UINT32 time_us;
+    UINT32 raw_us;
+    UINT32 raw_num;
+    UINT32 chunks;
+    UINT32 flags;
+}ventoy_io_trace_entry;
+
+typedef struct ventoy_io_trace_head
+{
+    UINT64 magic;
+    UINT64 version;
+    UINT64 entry_num;
+    UINT64 next;
+    UINT64 tsc_per_ms;
+    UINT64 block_size;
+    UINT64 total_bytes;
+    UINT64 total_us;
+    UINT64 raw_us;
+    UINT64 hist_us[VTOY_IO_HIST_NUM];
+    UINT64 hist_kb[VTOY_IO_HIST_NUM];
+}ventoy_io_trace_head;
+
 
 typedef struct VtoyUtilFeature
 {
@@ -65,6 +97,8 @@ VOID EFIAPI VtoyUtilDebug(IN CONST CHAR8  *Format, ...);
 EFI_STATUS VtoyGetComponentName(IN UINTN Ver, IN VOID *Protocol, OUT CHAR16 **DriverName);
 EFI_STATUS FixWindowsMemhole(IN EFI_HANDLE    ImageHandle, IN CONST CHAR16 *CmdLine);
 EFI_STATUS ShowEfiDrivers(IN EFI_HANDLE    ImageHandle, IN CONST CHAR16 *CmdLine);
+EFI_STATUS BlockIoBench(IN EFI_HANDLE    ImageHandle, IN CONST CHAR16 *CmdLine);
+EFI_STATUS IoTraceDump(IN EFI_HANDLE    ImageHandle, IN CONST CHAR16 *CmdLine);
 
 #endif
 
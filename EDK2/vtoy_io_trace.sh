@@ -0,0 +1,126 @@
+#!/bin/sh
+
+# Summarize the UEFI I/O trace of Ventoy.efi.
+# Enable it with VTOY_UEFI_IO_TRACE (K entries) in the control plugin, boot
+# the image, and when it returns to the Ventoy menu save the trace with
+#   chainloader ${vtoy_path}/vtoyutil_${VTOY_EFI_ARCH}.efi env_param=${env_param} feature=io_trace_dump
+# The file (default \ventoy_io_trace.bin, or feature=io_trace_dump:\path) is
+# written to the partition vtoyutil is loaded from, that is the 32MB VTOYEFI
+# partition, not the image partition. A full 256K entry ring is about 8MB,
+# vtoyutil fails with "No space ..." and leaves no file when it doesn't fit.
+# Usage: sh vtoy_io_trace.sh ventoy_io_trace.bin [top_num]
+# Layout: ventoy_io_trace_head / ventoy_io_trace_entry in Ventoy.h
+
+HEAD_SIZE=584
+MAGIC=4846245196088300630
+
+if [ ! -f "$1" ]; then
+    echo "Usage: sh $0 ventoy_io_trace.bin [top_num]"
+    exit 1
+fi
+
+TRACE_FILE=$1
+TOP=${2:-10}
+
+set -- $(od -An -v -t u8 -N $HEAD_SIZE "$TRACE_FILE")
+if [ "$1" != "$MAGIC" ]; then
+    echo "Not a ventoy io trace file"
+    exit 1
+fi
+
+if [ "$2" != "1" ]; then
+    echo "Unsupported version $2"
+    exit 1
+fi
+
+ENTRY_NUM=$3
+NEXT=$4
+TSC=$5
+BLOCK=$6
+shift 9
+HIST_US="$(echo $* | cut -d' ' -f1-32)"
+HIST_KB="$(echo $* | cut -d' ' -f33-64)"
+
+echo "requests recorded: $NEXT   ring size: $ENTRY_NUM"
+if [ "$TSC" = "0" ]; then
+    echo "no time stamp counter on this machine, all the times are 0"
+fi
+
+od -An -v -t u4 -w32 -j $HEAD_SIZE "$TRACE_FILE" | awk -v block=$BLOCK -v top=$TOP \
+    -v hist_us="$HIST_US" -v hist_kb="$HIST_KB" '
+function flagstr(f,    s) {
+    s = ""
+    if (f % 2 >= 1)  s = s "O"
+    if (f % 4 >= 2)  s = s "V"
+    if (f % 8 >= 4)  s = s "B"
+    if (f % 16 >= 8) s = s "E"
+    if (f % 32 >= 16) s = s "A"
+    return (s == "") ? "-" : s
+}
+NF == 8 {
+    lba = $1 + $2 * 4294967296
+    size = $3; us = $4; raw = $5; rawnum = $6; chunks = $7; flags = $8
+
+    n++
+    bytes += size; time += us; rawtime += raw; rawreads += rawnum
+    if (chunks > 1)         cross++
+    if (flags % 2 >= 1)     override++
+    if (flags % 4 >= 2)     virt++
+    if (flags % 8 >= 4)     bounce++
+    if (flags % 16 >= 8)    error++
+    if (flags % 32 >= 16)   async++
+    if (n > 1 && lba == nextlba) seq++
+    nextlba = lba + size / block
+
+    if (size < 65536) {
+        small++; smallbytes += size; smalltime += us
+        region = int(lba * block / 1048576)
+        rcount[region]++; rtime[region] += us
+    }
+
+    slow[n] = us " " lba " " size " " raw " " chunks " " flagstr(flags)
+}
+END {
+    if (n == 0) {
+        print "no request in the trace"
+        exit 0
+    }
+
+    printf "requests: %d  bytes: %d  time: %.1f ms  raw disk: %.1f ms (%d raw reads)\n", n, bytes, time / 1000, rawtime / 1000, rawreads
+    if (time > 0) {
+        printf "throughput: %.1f MB/s  (raw disk busy %.0f%% of the time)\n", bytes / time, rawtime * 100 / time
+    }
+    printf "sequential: %.0f%%  chunk crossing: %d  override: %d  virt: %d  bounce: %d  async: %d  error: %d\n", seq * 100 / n, cross, override, virt, bounce, async, error
+    printf "small reads (<64KB): %d (%.0f%% of requests, %.0f%% of bytes, %.0f%% of time)\n",
+        small, small * 100 / n, (bytes > 0) ? smallbytes * 100 / bytes : 0, (time > 0) ? smalltime * 100 / time : 0
+
+    print ""
+    printf "%-14s %10s      %-14s %10s\n", "latency(us)", "count", "size(KB)", "count"
+    split(hist_us, hu, " ")
+    split(hist_kb, hk, " ")
+    for (i = 1; i <= 32; i++) {
+        if (hu[i] > 0 || hk[i] > 0) {
+            printf "<%-13d %10d      <%-13d %10d\n", 2 ^ (i - 1), hu[i], 2 ^ (i - 1), hk[i]
+        }
+    }
+
+    print ""
+    print "small read hot spots (1MB regions of the virtual disk):"
+    printf "%-12s %10s %12s\n", "offset(MB)", "reads", "time(ms)"
+    cmd = "sort -k2,2nr | head -n " top
+    for (r in rcount) {
+        printf "%-12d %10d %12.1f\n", r, rcount[r], rtime[r] / 1000 | cmd
+    }
+    close(cmd)
+
+    print ""
+    print "slowest requests:"
+    printf "%10s %12s %10s %10s %7s %6s\n", "time(us)", "lba", "size", "raw(us)", "chunks", "flags"
+    cmd = "sort -k1,1nr | head -n " top
+    for (i = 1; i <= n; i++) {
+        split(slow[i], f, " ")
+        printf "%10d %12d %10d %10d %7d %6s\n", f[1], f[2], f[3], f[4], f[5], f[6] | cmd
+    }
+    close(cmd)
+    print "flags: O override  V virt chunk  B bounce buffer  E error  A async BlockIo2"
+}'
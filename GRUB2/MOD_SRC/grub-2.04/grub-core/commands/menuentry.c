@@ -174,11 +174,18 @@ grub_normal_add_menu_entry (int argc, const char **args,
 
   /* Add the menu entry at the end of the list.  */
   int ind=0;
-  while (*last)
+  if (menu->entry_tail && ! menu->entry_tail->next)
     {
-      ind++;
-      last = &(*last)->next;
+      /* Fast path, avoid walking the whole list for every new entry.  */
+      ind = menu->size;
+      last = &menu->entry_tail->next;
     }
+  else
+    while (*last)
+      {
+	ind++;
+	last = &(*last)->next;
+      }
 
   *last = grub_zalloc (sizeof (**last));
   if (! *last)
@@ -197,6 +204,7 @@ grub_normal_add_menu_entry (int argc, const char **args,
   (*last)->submenu = submenu;
   (*last)->bls = bls;
 
+  menu->entry_tail = *last;
   menu->size++;
   if (index)
     *index = ind;
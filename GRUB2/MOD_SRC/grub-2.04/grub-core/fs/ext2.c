@@ -892,6 +892,8 @@ grub_ext2_open (struct grub_file *file, const char *name)
     }
 
   grub_memcpy (data->inode, &fdiro->inode, sizeof (struct grub_ext2_inode));
+  /* data->inode is diropen.inode, keep the inode number with it for ventoy */
+  data->diropen.ino = fdiro->ino;
   grub_free (fdiro);
 
   file->size = grub_le_to_cpu32 (data->inode->size);
@@ -1080,6 +1082,11 @@ grub_ext2_mtime (grub_device_t device, grub_int32_t *tm)
 
 }
 
+grub_uint64_t grub_ext_get_file_inode(grub_file_t file)
+{
+    return (grub_uint64_t)(((struct grub_ext2_data *)file->data)->diropen.ino);
+}
+
 int grub_ext_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list)
 {
     int blocksize;
@@ -34,6 +34,7 @@
 #include <grub/fshelp.h>
 #include <grub/i18n.h>
 #include <grub/time.h>
+#include <grub/datetime.h>
 #include <grub/ventoy.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
@@ -124,6 +125,9 @@ struct grub_fat_dir_node
   grub_uint32_t first_cluster;
   grub_uint64_t file_size;
   grub_uint64_t valid_size;
+  grub_uint32_t m_time;
+  grub_uint8_t m_time_tenth;
+  grub_uint8_t m_utc_offset;
   int have_stream;
   int is_contiguous;
 };
@@ -665,6 +669,10 @@ grub_fat_iterate_dir_next (grub_fshelp_node_t node,
 	  nsec = dir.type_specific.file.secondary_count;
 
 	  ctxt->dir.attr = grub_cpu_to_le16 (dir.type_specific.file.attr);
+	  ctxt->dir.m_time = grub_le_to_cpu32 (dir.type_specific.file.m_time);
+	  ctxt->dir.m_time_tenth = dir.type_specific.file.m_time_tenth;
+	  /* LastModifiedUtcOffset follows the three 10ms increment fields.  */
+	  ctxt->dir.m_utc_offset = dir.type_specific.file.reserved2[0];
 	  ctxt->dir.have_stream = 0;
 	  for (i = 0; i < nsec; i++)
 	    {
@@ -920,6 +928,61 @@ static grub_err_t lookup_file (grub_fshelp_node_t node,
 
 }
 
+#ifdef MODE_EXFAT
+static int
+grub_exfat_timestamp (grub_uint32_t field, grub_uint8_t msec,
+		      grub_uint8_t utc_offset, grub_int32_t *nix)
+{
+  struct grub_datetime datetime = {
+    .year   = (field >> 25) + 1980,
+    .month  = (field & 0x01E00000) >> 21,
+    .day    = (field & 0x001F0000) >> 16,
+    .hour   = (field & 0x0000F800) >> 11,
+    .minute = (field & 0x000007E0) >>  5,
+    .second = (field & 0x0000001F) * 2 + (msec >= 100 ? 1 : 0),
+  };
+
+  /* The conversion below allows seconds=60, so don't trust its validation. */
+  if ((field & 0x1F) > 29)
+    return 0;
+
+  /* Validate the 10-msec field even though it is rounded down to seconds. */
+  if (msec > 199)
+    return 0;
+
+  if (!grub_datetime2unixtime (&datetime, nix))
+    return 0;
+
+  /* Bit 7 marks a valid offset from UTC, in signed 15 minute units.  */
+  if (utc_offset & 0x80)
+    {
+      grub_int8_t quarter = (grub_int8_t) (utc_offset << 1) >> 1;
+      *nix -= quarter * 15 * 60;
+    }
+
+  return 1;
+}
+#else
+static int
+grub_fat_timestamp (grub_uint16_t time, grub_uint16_t date, grub_int32_t *nix)
+{
+  struct grub_datetime datetime = {
+    .year   = (date >> 9) + 1980,
+    .month  = (date & 0x01E0) >> 5,
+    .day    = (date & 0x001F),
+    .hour   = (time >> 11),
+    .minute = (time & 0x07E0) >> 5,
+    .second = (time & 0x001F) * 2,
+  };
+
+  /* The conversion below allows seconds=60, so don't trust its validation. */
+  if ((time & 0x1F) > 29)
+    return 0;
+
+  return grub_datetime2unixtime (&datetime, nix);
+}
+#endif
+
 static grub_err_t
 grub_fat_dir (grub_device_t device, const char *path, grub_fs_dir_hook_t hook,
 	      void *hook_data)
@@ -967,7 +1030,18 @@ grub_fat_dir (grub_device_t device, const char *path, grub_fs_dir_hook_t hook,
 
       if (!info.dir)
          info.size = ctxt.dir.file_size;
-      
+
+#ifdef MODE_EXFAT
+      info.mtimeset = grub_exfat_timestamp (ctxt.dir.m_time,
+					    ctxt.dir.m_time_tenth,
+					    ctxt.dir.m_utc_offset,
+					    &info.mtime);
+#else
+      info.mtimeset = grub_fat_timestamp (grub_le_to_cpu16 (ctxt.dir.w_time),
+					  grub_le_to_cpu16 (ctxt.dir.w_date),
+					  &info.mtime);
+#endif
+
 #ifdef MODE_EXFAT
       if (!ctxt.dir.have_stream)
 	continue;
@@ -1274,16 +1348,112 @@ GRUB_MOD_FINI(fat)
 
 #ifdef MODE_EXFAT
 
+/* The FAT is read in big windows when walking the cluster chain for ventoy,
+   instead of one small grub_disk_read for every cluster.  */
+#define GRUB_FAT_CHAIN_WINDOW  (256 * 1024)
+
+struct grub_fat_chain_window
+{
+  char *buf;
+  grub_uint64_t start;
+  grub_uint64_t len;
+  grub_uint64_t fat_len;
+};
+
+static grub_err_t
+grub_fat_chain_next (grub_disk_t disk, struct grub_fat_data *data,
+		     struct grub_fat_chain_window *win,
+		     grub_uint32_t cluster, grub_uint32_t *next)
+{
+  grub_uint64_t fat_offset;
+  grub_uint32_t bytes = (data->fat_size + 7) >> 3;
+  grub_uint32_t next_cluster = 0;
+
+  switch (data->fat_size)
+    {
+    case 32:
+      fat_offset = (grub_uint64_t) cluster << 2;
+      break;
+    case 16:
+      fat_offset = (grub_uint64_t) cluster << 1;
+      break;
+    default:
+      /* case 12: */
+      fat_offset = cluster + (cluster >> 1);
+      break;
+    }
+
+  if (fat_offset < win->start || fat_offset + bytes > win->start + win->len)
+    {
+      win->start = fat_offset & ~((grub_uint64_t) GRUB_DISK_SECTOR_SIZE - 1);
+      win->len = GRUB_FAT_CHAIN_WINDOW;
+      if (win->start + win->len > win->fat_len)
+	win->len = win->fat_len - win->start;
+
+      if (win->start >= win->fat_len || fat_offset + bytes > win->start + win->len)
+	{
+	  win->len = 0;
+	  return grub_error (GRUB_ERR_BAD_FS, "invalid cluster %u", cluster);
+	}
+
+      /* Read the FAT.  */
+      if (grub_disk_read (disk, data->fat_sector, win->start, win->len, win->buf))
+	{
+	  win->len = 0;
+	  return grub_errno;
+	}
+    }
+
+  grub_memcpy (&next_cluster, win->buf + (fat_offset - win->start), bytes);
+
+  next_cluster = grub_le_to_cpu32 (next_cluster);
+  switch (data->fat_size)
+    {
+    case 16:
+      next_cluster &= 0xFFFF;
+      break;
+    case 12:
+      if (cluster & 1)
+	next_cluster >>= 4;
+
+      next_cluster &= 0x0FFF;
+      break;
+    }
+
+  *next = next_cluster;
+  return GRUB_ERR_NONE;
+}
+
+/* first cluster of the file and its disk sector (same as chunk[0] of grub_fat_get_file_chunk) */
+grub_uint32_t grub_fat_get_file_cluster(grub_uint64_t part_start, grub_file_t file, grub_uint64_t *sector)
+{
+    grub_fshelp_node_t node = file->data;
+
+    if (node->file_cluster < 2 || node->file_cluster >= node->data->cluster_eof_mark)
+    {
+        *sector = 0;
+        return 0;
+    }
+
+    *sector = part_start + node->data->cluster_sector +
+              ((grub_uint64_t)(node->file_cluster - 2) << node->data->cluster_bits);
+    return node->file_cluster;
+}
+
 int grub_fat_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list)
 {
-    grub_size_t size;
     grub_uint32_t i;
-    grub_uint32_t logical_cluster;
+    grub_uint32_t cluster;
+    grub_uint32_t next_cluster;
+    grub_uint32_t run_start;
+    grub_uint32_t run_num;
     unsigned logical_cluster_bits;
     unsigned long sector;
+    grub_uint64_t run_size;
     grub_fshelp_node_t node;
     grub_disk_t disk;
     grub_uint64_t len;
+    struct grub_fat_chain_window win;
 
     disk = file->device->disk;
     node = file->data;
@@ -1303,92 +1473,73 @@ int grub_fat_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_i
         goto END;
     }
 
-    /* Calculate the logical cluster number and offset.  */
-    logical_cluster = 0;
-    logical_cluster_bits = (node->data->cluster_bits + GRUB_DISK_SECTOR_BITS);
-
-    if (logical_cluster < node->cur_cluster_num)
+    grub_memset(&win, 0, sizeof(win));
+    win.fat_len = (grub_uint64_t)node->data->sectors_per_fat << GRUB_DISK_SECTOR_BITS;
+    win.buf = grub_malloc(GRUB_FAT_CHAIN_WINDOW);
+    if (!win.buf)
     {
-        node->cur_cluster_num = 0;
-        node->cur_cluster = node->file_cluster;
+        return -1;
     }
 
+    logical_cluster_bits = (node->data->cluster_bits + GRUB_DISK_SECTOR_BITS);
+
+    /*
+     * Walk the cluster chain and add every run of consecutive clusters
+     * as a whole, a contiguous part of the file costs no extra disk read.
+     */
+    cluster = run_start = node->file_cluster;
+    run_num = 1;
+
     while (len)
     {
-        while (logical_cluster > node->cur_cluster_num)
+        run_size = ((grub_uint64_t)run_num << logical_cluster_bits);
+        if (run_size < len)
         {
-            /* Find next cluster.  */
-            grub_uint32_t next_cluster;
-            grub_uint32_t fat_offset;
-
-            switch (node->data->fat_size)
-            {
-                case 32:
-                    fat_offset = node->cur_cluster << 2;
-                    break;
-                case 16:
-                    fat_offset = node->cur_cluster << 1;
-                    break;
-                default:
-                    /* case 12: */
-                    fat_offset = node->cur_cluster + (node->cur_cluster >> 1);
-                    break;
-            }
-
-            /* Read the FAT.  */      
-            if (grub_disk_read (disk, node->data->fat_sector, fat_offset,
-            	      (node->data->fat_size + 7) >> 3,
-            	      (char *) &next_cluster))
-            {
-                return -1;                
-            }
-
-            next_cluster = grub_le_to_cpu32 (next_cluster);
-            switch (node->data->fat_size)
+            if (grub_fat_chain_next(disk, node->data, &win, cluster, &next_cluster))
             {
-                case 16:
-                    next_cluster &= 0xFFFF;
-                    break;
-                case 12:
-                    if (node->cur_cluster & 1)
-                    next_cluster >>= 4;
-
-                    next_cluster &= 0x0FFF;
-                    break;
+                grub_free(win.buf);
+                return -1;
             }
 
             grub_dprintf ("fat", "fat_size=%d, next_cluster=%u\n", node->data->fat_size, next_cluster);
 
-            /* Check the end.  */
-            if (next_cluster >= node->data->cluster_eof_mark)
-            {
-                return 0;
-            }
-
-            if (next_cluster < 2 || (next_cluster - 2) >= node->data->num_clusters)
+            if (next_cluster < node->data->cluster_eof_mark &&
+                (next_cluster < 2 || (next_cluster - 2) >= node->data->num_clusters))
             {
                 grub_error (GRUB_ERR_BAD_FS, "invalid cluster %u", next_cluster);
+                grub_free(win.buf);
                 return -1;
             }
 
-            node->cur_cluster = next_cluster;
-            node->cur_cluster_num++;
+            if (next_cluster == cluster + 1)
+            {
+                cluster = next_cluster;
+                run_num++;
+                continue;
+            }
+        }
+        else
+        {
+            run_size = len;
+            next_cluster = node->data->cluster_eof_mark;
         }
 
-      /* Read the data here.  */
-      sector = (node->data->cluster_sector
-		+ ((node->cur_cluster - 2)
-		   << node->data->cluster_bits));
-      size = (1 << logical_cluster_bits);
-      if (size > len)
-	    size = len;
+        sector = (node->data->cluster_sector + ((run_start - 2) << node->data->cluster_bits));
+        grub_disk_blocklist_read(chunk_list, sector, run_size, disk->log_sector_size);
+        len -= run_size;
 
-    grub_disk_blocklist_read(chunk_list, sector, size, disk->log_sector_size);
+        /* Check the end.  */
+        if (next_cluster >= node->data->cluster_eof_mark)
+        {
+            break;
+        }
 
-      len -= size;
-      logical_cluster++;
+        cluster = run_start = next_cluster;
+        run_num = 1;
     }
 
+    grub_free(win.buf);
+
 END:
 
     for (i = 0; i < chunk_list->cur_chunk; i++)
@@ -27,6 +27,7 @@
 #include <grub/fshelp.h>
 #include <grub/ntfs.h>
 #include <grub/charset.h>
+#include <grub/ventoy.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -1216,6 +1217,101 @@ grub_ntfs_uuid (grub_device_t device, char **uuid)
   return grub_errno;
 }
 
+/* Decode the $DATA runlist (with all its extents) to the chunk list,
+   without reading the file data.  */
+int grub_ntfs_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list)
+{
+    int ret = -1;
+    grub_uint32_t i;
+    grub_uint64_t size;
+    grub_uint64_t left;
+    grub_uint8_t *pa;
+    grub_uint8_t *save_cur;
+    grub_disk_addr_t sector;
+    struct grub_ntfs_rlst cc;
+    struct grub_ntfs_rlst *ctx = &cc;
+    struct grub_ntfs_file *mft;
+    struct grub_ntfs_attr *at;
+    grub_disk_t disk;
+
+    disk = file->device->disk;
+    mft = &((struct grub_ntfs_data *) file->data)->cmft;
+    at = &mft->attr;
+
+    save_cur = at->attr_cur;
+    at->attr_nxt = at->attr_cur;
+    pa = find_attr (at, GRUB_NTFS_AT_DATA);
+    if (!pa)
+    {
+        goto out;
+    }
+
+    /* resident, compressed or sparse file is read in the common way */
+    if (pa[8] == 0 || (pa[0xC] & GRUB_NTFS_FLAG_COMPRESSED))
+    {
+        goto out;
+    }
+
+    grub_memset (&cc, 0, sizeof (cc));
+    ctx->attr = at;
+    ctx->comp.log_spc = mft->data->log_spc;
+    ctx->comp.disk = mft->data->disk;
+    ctx->cur_run = pa + u16at (pa, 0x20);
+    ctx->next_vcn = u32at (pa, 0x10);
+    ctx->curr_lcn = 0;
+
+    left = (file->size + GRUB_DISK_SECTOR_SIZE - 1) & (~((grub_uint64_t)GRUB_DISK_SECTOR_SIZE - 1));
+    while (left > 0)
+    {
+        if (grub_ntfs_read_run_list (ctx))
+        {
+            goto out;
+        }
+
+        if (ctx->flags & GRUB_NTFS_RF_BLNK)
+        {
+            goto out;
+        }
+
+        size = (ctx->next_vcn - ctx->curr_vcn) << (ctx->comp.log_spc + GRUB_NTFS_BLK_SHR);
+        if (size > left)
+        {
+            size = left;
+        }
+
+        sector = ctx->curr_lcn << ctx->comp.log_spc;
+        grub_disk_blocklist_read(chunk_list, sector, size, disk->log_sector_size);
+        left -= size;
+    }
+
+    for (i = 0; i < chunk_list->cur_chunk; i++)
+    {
+        chunk_list->chunk[i].disk_start_sector += part_start;
+        chunk_list->chunk[i].disk_end_sector += part_start;
+    }
+
+    ret = 0;
+
+out:
+    at->attr_cur = save_cur;
+    return ret;
+}
+
+/* MFT file reference (sequence number << 48 | record number) of the file,
+   the sequence number changes when the record is reused for a new file.  */
+grub_uint64_t grub_ntfs_get_file_ref(grub_file_t file)
+{
+    struct grub_ntfs_file *mft;
+
+    mft = &((struct grub_ntfs_data *) file->data)->cmft;
+    if (!mft->buf)
+    {
+        return 0;
+    }
+
+    return ((grub_uint64_t)u16at (mft->buf, 0x10) << 48) | mft->ino;
+}
+
 static struct grub_fs grub_ntfs_fs =
   {
     .name = "ntfs",
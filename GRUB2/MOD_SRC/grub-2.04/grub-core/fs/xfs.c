@@ -26,6 +26,7 @@
 #include <grub/time.h>
 #include <grub/types.h>
 #include <grub/fshelp.h>
+#include <grub/ventoy.h>
 
 GRUB_MOD_LICENSE ("GPLv3+");
 
@@ -1165,6 +1166,10 @@ grub_xfs_dir_iter (const char *filename, enum grub_fshelp_filetype filetype,
       info.mtime = grub_xfs_get_inode_time (&node->inode);
     }
   info.dir = ((filetype & GRUB_FSHELP_TYPE_MASK) == GRUB_FSHELP_DIR);
+  /* The inode is already read, so the caller need not open the file
+     again just to get the size.  */
+  if (node->inode_read && !info.dir)
+    info.size = grub_be_to_cpu64 (node->inode.size);
   grub_free (node);
   return ctx->hook (filename, &info, ctx->hook_data);
 }
@@ -1327,6 +1332,207 @@ grub_xfs_uuid (grub_device_t device, char **uuid)
   return grub_errno;
 }
 
+static int grub_xfs_chunk_add_extents
+(
+    struct grub_xfs_data *data,
+    struct grub_xfs_extent *exts,
+    grub_uint64_t nrec,
+    grub_uint64_t *nextblk,
+    grub_uint64_t *left,
+    ventoy_img_chunk_list *chunk_list
+)
+{
+    grub_uint64_t ex;
+    grub_uint64_t start;
+    grub_uint64_t offset;
+    grub_uint64_t size;
+    grub_uint64_t bytes;
+    int log2_bsize = data->sblock.log2_bsize;
+
+    for (ex = 0; ex < nrec && *left > 0; ex++)
+    {
+        start = GRUB_XFS_EXTENT_BLOCK (exts, ex);
+        offset = GRUB_XFS_EXTENT_OFFSET (exts, ex);
+        size = GRUB_XFS_EXTENT_SIZE (exts, ex);
+
+        /* sparse file or unwritten extent must be read in the common way */
+        if (offset != *nextblk || (grub_be_to_cpu32 (exts[ex].raw[0]) & (1U << 31)))
+        {
+            return -1;
+        }
+
+        bytes = size << log2_bsize;
+        if (bytes > *left)
+        {
+            bytes = *left;
+        }
+
+        /* adjacent extents are merged into one chunk here */
+        grub_disk_blocklist_read(chunk_list,
+            GRUB_XFS_FSB_TO_BLOCK (data, start) << (log2_bsize - GRUB_DISK_SECTOR_BITS),
+            bytes, data->disk->log_sector_size);
+
+        *left -= bytes;
+        *nextblk += size;
+    }
+
+    return 0;
+}
+
+/* Decode the extent list (or the extent btree) of the file to the chunk list */
+grub_uint64_t grub_xfs_get_file_inode(grub_file_t file)
+{
+    return ((struct grub_xfs_data *)file->data)->diropen.ino;
+}
+
+int grub_xfs_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list)
+{
+    int ret = -1;
+    int recoffset;
+    grub_uint32_t i;
+    grub_uint64_t nrec;
+    grub_uint64_t left;
+    grub_uint64_t nextblk = 0;
+    grub_uint64_t fsb;
+    const char *keys;
+    struct grub_xfs_data *data;
+    struct grub_fshelp_node *node;
+    struct grub_xfs_btree_root *root;
+    struct grub_xfs_btree_node *leaf = NULL;
+    grub_addr_t keys_end;
+
+    data = (struct grub_xfs_data *)file->data;
+    node = &data->diropen;
+    left = (file->size + GRUB_DISK_SECTOR_SIZE - 1) & (~((grub_uint64_t)GRUB_DISK_SECTOR_SIZE - 1));
+
+    if (node->inode.format == XFS_INODE_FORMAT_EXT)
+    {
+        nrec = grub_xfs_get_inode_nextents (&node->inode);
+        keys = grub_xfs_inode_data(&node->inode);
+
+        if (nrec > (grub_uint64_t)(((char *)data + data->data_size - keys) / sizeof (struct grub_xfs_extent)))
+        {
+            grub_error (GRUB_ERR_BAD_FS, "invalid number of XFS extents");
+            return -1;
+        }
+
+        if (grub_xfs_chunk_add_extents(data, (struct grub_xfs_extent *)keys, nrec, &nextblk, &left, chunk_list))
+        {
+            return -1;
+        }
+    }
+    else if (node->inode.format == XFS_INODE_FORMAT_BTREE)
+    {
+        leaf = grub_malloc (data->bsize);
+        if (!leaf)
+        {
+            return -1;
+        }
+
+        root = (struct grub_xfs_btree_root *) grub_xfs_inode_data(&node->inode);
+        nrec = grub_be_to_cpu16 (root->numrecs);
+        keys = (char *) &root->keys[0];
+        if (node->inode.fork_offset)
+            recoffset = (node->inode.fork_offset - 1) / 2;
+        else
+            recoffset = (grub_xfs_inode_size(data) - ((char *) keys - (char *) &node->inode)) / (2 * sizeof (grub_uint64_t));
+
+        /* go down to the leftmost leaf */
+        do
+        {
+            keys_end = (grub_addr_t)keys + (recoffset + 1) * sizeof (grub_uint64_t);
+            if (nrec == 0 || keys_end > (grub_addr_t)data + data->data_size)
+            {
+                grub_error (GRUB_ERR_BAD_FS, "invalid number of XFS root keys");
+                goto out;
+            }
+
+            /* leftmost key must start at file block 0 or the file is sparse */
+            if (get_fsb(keys, 0) != 0)
+            {
+                goto out;
+            }
+
+            fsb = get_fsb(keys, recoffset);
+            if (grub_disk_read (data->disk, GRUB_XFS_FSB_TO_BLOCK (data, fsb) << (data->sblock.log2_bsize - GRUB_DISK_SECTOR_BITS),
+                                0, data->bsize, leaf))
+            {
+                goto out;
+            }
+
+            if ((!data->hascrc && grub_strncmp ((char *) leaf->magic, "BMAP", 4)) ||
+                (data->hascrc && grub_strncmp ((char *) leaf->magic, "BMA3", 4)))
+            {
+                grub_error (GRUB_ERR_BAD_FS, "not a correct XFS BMAP node");
+                goto out;
+            }
+
+            nrec = grub_be_to_cpu16 (leaf->numrecs);
+            keys = grub_xfs_btree_keys(data, leaf);
+            recoffset = ((data->bsize - (keys - (char *) leaf)) / (2 * sizeof (grub_uint64_t)));
+        } while (leaf->level);
+
+        /* walk all the leaves through the right sibling pointer */
+        for (i = 0; left > 0; i++)
+        {
+            if (nrec > (grub_uint64_t)((data->bsize - (keys - (char *) leaf)) / sizeof (struct grub_xfs_extent)))
+            {
+                grub_error (GRUB_ERR_BAD_FS, "invalid number of XFS extents");
+                goto out;
+            }
+
+            if (grub_xfs_chunk_add_extents(data, (struct grub_xfs_extent *)keys, nrec, &nextblk, &left, chunk_list))
+            {
+                goto out;
+            }
+
+            fsb = grub_be_to_cpu64 (leaf->right);
+            if (left == 0 || fsb == (grub_uint64_t)-1)
+            {
+                break;
+            }
+
+            if (grub_disk_read (data->disk, GRUB_XFS_FSB_TO_BLOCK (data, fsb) << (data->sblock.log2_bsize - GRUB_DISK_SECTOR_BITS),
+                                0, data->bsize, leaf))
+            {
+                goto out;
+            }
+
+            if ((!data->hascrc && grub_strncmp ((char *) leaf->magic, "BMAP", 4)) ||
+                (data->hascrc && grub_strncmp ((char *) leaf->magic, "BMA3", 4)) || leaf->level)
+            {
+                grub_error (GRUB_ERR_BAD_FS, "not a correct XFS BMAP leaf");
+                goto out;
+            }
+
+            nrec = grub_be_to_cpu16 (leaf->numrecs);
+            keys = grub_xfs_btree_keys(data, leaf);
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    /* file is longer than the extents */
+    if (left > 0)
+    {
+        goto out;
+    }
+
+    for (i = 0; i < chunk_list->cur_chunk; i++)
+    {
+        chunk_list->chunk[i].disk_start_sector += part_start;
+        chunk_list->chunk[i].disk_end_sector += part_start;
+    }
+
+    ret = 0;
+
+out:
+    grub_free(leaf);
+    return ret;
+}
+
 static struct grub_fs grub_xfs_fs =
   {
     .name = "xfs",
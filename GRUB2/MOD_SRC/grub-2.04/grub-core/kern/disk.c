@@ -37,6 +37,18 @@ struct grub_disk_cache grub_disk_cache_table[GRUB_DISK_CACHE_NUM];
 void (*grub_disk_firmware_fini) (void);
 int grub_disk_firmware_is_tainted;
 
+/* grub_disk_read calls and the real reads sent to the disk driver.  */
+grub_uint64_t grub_disk_read_count;
+grub_uint64_t grub_disk_read_bytes;
+grub_uint64_t grub_disk_dev_read_count;
+grub_uint64_t grub_disk_dev_read_bytes;
+
+#define grub_disk_dev_read_stat(disk, num) \
+  do { \
+    grub_disk_dev_read_count++; \
+    grub_disk_dev_read_bytes += ((grub_uint64_t) (num)) << (disk)->log_sector_size; \
+  } while (0)
+
 #if DISK_CACHE_STATS
 static unsigned long grub_disk_cache_hits;
 static unsigned long grub_disk_cache_misses;
@@ -342,6 +354,9 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
       < (disk->total_sectors << (disk->log_sector_size - GRUB_DISK_SECTOR_BITS)))
     {
       grub_err_t err;
+      grub_disk_dev_read_stat (disk, 1U << (GRUB_DISK_CACHE_BITS
+					     + GRUB_DISK_SECTOR_BITS
+					     - disk->log_sector_size));
       err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
 				    1U << (GRUB_DISK_CACHE_BITS
 					   + GRUB_DISK_SECTOR_BITS
@@ -378,6 +393,7 @@ grub_disk_read_small_real (grub_disk_t disk, grub_disk_addr_t sector,
     if (!tmp_buf)
       return grub_errno;
     
+    grub_disk_dev_read_stat (disk, num);
     if ((disk->dev->disk_read) (disk, transform_sector (disk, aligned_sector),
 				num, tmp_buf))
       {
@@ -515,6 +531,9 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
         }
     }
 
+  grub_disk_read_count++;
+  grub_disk_read_bytes += size;
+
   /* First of all, check if the region is within the disk.  */
   if (grub_disk_adjust_range (disk, &sector, &offset, size) != GRUB_ERR_NONE)
     {
@@ -585,6 +604,9 @@ grub_disk_read (grub_disk_t disk, grub_disk_addr_t sector,
 	{
 	  grub_disk_addr_t i;
 
+	  grub_disk_dev_read_stat (disk, agglomerate << (GRUB_DISK_CACHE_BITS
+							 + GRUB_DISK_SECTOR_BITS
+							 - disk->log_sector_size));
 	  err = (disk->dev->disk_read) (disk, transform_sector (disk, sector),
 					agglomerate << (GRUB_DISK_CACHE_BITS
 							+ GRUB_DISK_SECTOR_BITS
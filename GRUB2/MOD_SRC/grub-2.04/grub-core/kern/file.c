@@ -106,16 +106,32 @@ int ventoy_check_file_exist(const char * fmt, ...)
     }
 }
 
+#define GRUB_VLNK_HASH_SIZE  256
+
 typedef struct grub_vlnk
 {
     int srclen;
     char src[512];
     char dst[512];
     struct grub_vlnk *next;
+    struct grub_vlnk *hnext;
 }grub_vlnk;
 
 static grub_vlnk g_vtoy_vlnk;
 static grub_vlnk *g_vlnk_list;
+static grub_vlnk *g_vlnk_hash[GRUB_VLNK_HASH_SIZE];
+
+static grub_uint32_t grub_vlnk_hash(const char *name)
+{
+    grub_uint32_t hash = 5381;
+
+    while (*name)
+    {
+        hash = ((hash << 5) + hash) + (grub_uint8_t)(*name++);
+    }
+
+    return hash & (GRUB_VLNK_HASH_SIZE - 1);
+}
 
 int grub_file_is_vlnk_suffix(const char *name, int len)
 {
@@ -166,6 +182,7 @@ int grub_file_vtoy_vlnk(const char *src, const char *dst)
 
 int grub_file_add_vlnk(const char *src, const char *dst)
 {
+    grub_uint32_t hash;
     grub_vlnk *node = NULL;
     
     if (src && dst)
@@ -179,6 +196,10 @@ int grub_file_add_vlnk(const char *src, const char *dst)
 
             node->next = g_vlnk_list;
             g_vlnk_list = node;
+
+            hash = grub_vlnk_hash(node->src);
+            node->hnext = g_vlnk_hash[hash];
+            g_vlnk_hash[hash] = node;
             return 0;            
         }
     }
@@ -189,7 +210,7 @@ int grub_file_add_vlnk(const char *src, const char *dst)
 const char *grub_file_get_vlnk(const char *name, int *vlnk)
 {
     int len;
-    grub_vlnk *node = g_vlnk_list;
+    grub_vlnk *node = NULL;
 
     len = grub_strlen(name);
 
@@ -204,8 +225,13 @@ const char *grub_file_get_vlnk(const char *name, int *vlnk)
             *vlnk = 1;
         return g_vtoy_vlnk.dst; 
     }
-    
-    while (node)
+
+    if (!g_vlnk_list)
+    {
+        return name;
+    }
+
+    for (node = g_vlnk_hash[grub_vlnk_hash(name)]; node; node = node->hnext)
     {
         if (node->srclen == len && grub_strcmp(name, node->src) == 0)
         {
@@ -213,7 +239,6 @@ const char *grub_file_get_vlnk(const char *name, int *vlnk)
                 *vlnk = 1;
             return node->dst;
         }
-        node = node->next;
     }
 
     return name;
@@ -175,6 +175,8 @@ grub_env_extractor_close (int source)
       
       *last = menu->entry_list;
       menu2->size += menu->size;
+      if (menu->entry_list)
+	menu2->entry_tail = menu->entry_tail;
     }
 
   grub_extractor_level--;
@@ -286,6 +286,55 @@ void * ventoy_alloc_chain(grub_size_t size)
     return p;
 }
 
+void * ventoy_arena_alloc(ventoy_arena *arena, grub_size_t size)
+{
+    void *p = NULL;
+    grub_size_t blksize = VTOY_ARENA_BLOCK_SIZE;
+    ventoy_arena_block *block = arena->block;
+
+    size = (size + 7) & (~((grub_size_t)7));
+
+    if (!block || block->used + size > block->size)
+    {
+        if (size > blksize)
+        {
+            blksize = size;
+        }
+
+        block = grub_malloc(VTOY_ARENA_HEAD_SIZE + blksize);
+        if (!block)
+        {
+            return NULL;
+        }
+
+        block->size = (grub_uint32_t)blksize;
+        block->used = 0;
+        block->next = arena->block;
+        arena->block = block;
+        arena->total += blksize;
+    }
+
+    p = (char *)block + VTOY_ARENA_HEAD_SIZE + block->used;
+    block->used += (grub_uint32_t)size;
+
+    grub_memset(p, 0, size);
+    return p;
+}
+
+void ventoy_arena_free(ventoy_arena *arena)
+{
+    ventoy_arena_block *next = NULL;
+
+    while (arena->block)
+    {
+        next = arena->block->next;
+        grub_free(arena->block);
+        arena->block = next;
+    }
+
+    arena->total = 0;
+}
+
 void ventoy_memfile_env_set(const char *prefix, const void *buf, unsigned long long len)
 {
     char name[128];
@@ -302,6 +351,132 @@ void ventoy_memfile_env_set(const char *prefix, const void *buf, unsigned long l
     return;
 }
 
+static void ventoy_file_overwrite_hook(grub_disk_addr_t sector, unsigned offset, unsigned length, void *data)
+{
+    ventoy_file_block_list *list = (ventoy_file_block_list *)data;
+    ventoy_file_block *prev = NULL;
+
+    /* merge the contiguous sectors, so there is one write per run */
+    if (list->num > 0)
+    {
+        prev = list->blocks + list->num - 1;
+        if ((prev->sector << GRUB_DISK_SECTOR_BITS) + prev->offset + prev->length ==
+            (sector << GRUB_DISK_SECTOR_BITS) + offset)
+        {
+            prev->length += length;
+            return;
+        }
+    }
+
+    if (list->num >= list->max)
+    {
+        list->num = list->max + 1; /* overflow, can not write */
+        return;
+    }
+
+    list->blocks[list->num].sector = sector;
+    list->blocks[list->num].offset = offset;
+    list->blocks[list->num].length = length;
+    list->num++;
+}
+
+/*
+ * GRUB can not create a file or change its size, so the data is written
+ * in place into an existing file (just like save_env do with grubenv).
+ * The blocks of the file are collected through the read hook and the rest
+ * of the file after data is filled with the fill char.
+ * With fill < 0 only the first len bytes are written, the rest is kept.
+ */
+grub_err_t ventoy_file_overwrite(const char *path, const void *data, grub_uint32_t len, grub_uint32_t maxsize, int fill)
+{
+    int i;
+    grub_uint32_t index = 0;
+    grub_uint32_t size;
+    grub_uint32_t wrsize;
+    char *buf = NULL;
+    grub_disk_addr_t part_start;
+    grub_file_t file = NULL;
+    ventoy_file_block_list list;
+
+    if (!grub_disk_write_weak)
+    {
+        grub_dl_load("disk");
+        grub_errno = GRUB_ERR_NONE;
+        if (!grub_disk_write_weak)
+        {
+            return grub_error(GRUB_ERR_BAD_DEVICE, "disk write is not supported, insmod disk first");
+        }
+    }
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s", path);
+    if (!file)
+    {
+        return grub_error(GRUB_ERR_FILE_NOT_FOUND, "Can't open file %s", path);
+    }
+
+    if (file->size < (grub_uint64_t)len || file->size > maxsize)
+    {
+        grub_file_close(file);
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "file size must be between %u and %u", len, maxsize);
+    }
+
+    size = (grub_uint32_t)file->size;
+    wrsize = (fill < 0) ? len : size;
+    list.num = 0;
+    list.max = (int)(size / 512) + 2;
+    list.blocks = grub_malloc(list.max * sizeof(ventoy_file_block));
+    buf = grub_malloc(size);
+    if (!list.blocks || !buf)
+    {
+        grub_check_free(list.blocks);
+        grub_check_free(buf);
+        grub_file_close(file);
+        return grub_errno;
+    }
+
+    file->read_hook = ventoy_file_overwrite_hook;
+    file->read_hook_data = &list;
+    grub_file_read(file, buf, wrsize);
+    file->read_hook = NULL;
+
+    if (fill >= 0)
+    {
+        grub_memset(buf, fill, size);
+    }
+    grub_memcpy(buf, data, len);
+
+    for (i = 0; i < list.num && list.num <= list.max; i++)
+    {
+        index += list.blocks[i].length;
+    }
+
+    if (list.num > list.max || index != wrsize || !file->device->disk)
+    {
+        grub_error(GRUB_ERR_BAD_ARGUMENT, "unsupported file layout for %s", path);
+        goto end;
+    }
+
+    part_start = grub_partition_get_start(file->device->disk->partition);
+
+    for (index = 0, i = 0; i < list.num; i++)
+    {
+        if (grub_disk_write_weak(file->device->disk, list.blocks[i].sector - part_start,
+                                 list.blocks[i].offset, list.blocks[i].length, buf + index))
+        {
+            break;
+        }
+        index += list.blocks[i].length;
+    }
+
+    debug("overwrite %s blocks:%d err:%d\n", path, list.num, grub_errno);
+
+end:
+    grub_free(list.blocks);
+    grub_free(buf);
+    grub_file_close(file);
+    return grub_errno;
+}
+
 #ifdef GRUB_MACHINE_EFI
 static void ventoy_get_uefi_version(char *str, grub_size_t len)
 {
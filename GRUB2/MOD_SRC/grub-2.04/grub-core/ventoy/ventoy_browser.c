@@ -474,6 +474,8 @@ static grub_err_t ventoy_browser_iso_part(void)
     int buflen = 0;
     int cfglen = 0;
 
+    ventoy_tree_script_ensure();
+
     cfglen = g_tree_script_pos - g_tree_script_pre;
     buflen = cfglen + 512;
     buffer = grub_malloc(buflen);
@@ -0,0 +1,585 @@
+/******************************************************************************
+ * ventoy_chunk_cache.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/fs.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/lib/crc.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/*
+ * Chunk list cache for the image files on the Ventoy partition.
+ * An entry is keyed by the file path, size, the mtime reported by the
+ * parent directory and the first cluster (exFAT), inode (ext/xfs) or MFT
+ * file reference (NTFS). Files on other filesystems are never cached.
+ * A file deleted and copied back keeps its mtime with many copy tools but
+ * lands on new clusters, so the first cluster must be part of the key: the
+ * old clusters still hold the same data until they are reused, the sector
+ * check below can't tell the difference.
+ * Before an entry is used the first and the last sector of the file are
+ * read through the filesystem and compared with the disk sectors recorded
+ * in the first and the last chunk, so a file that was moved by a defrag
+ * tool is never booted with a stale chunk list.
+ * On a miss the chunk list is got as before and saved back to the cache.
+ *
+ * GRUB can not create a file, so the cache is only enabled when
+ * VTOY_CHUNK_CACHE_FILE already exists (e.g. a zero filled file).
+ */
+
+typedef struct ventoy_chunk_cache_stat
+{
+    const char *name;
+    int found;
+    int mtimeset;
+    grub_int32_t mtime;
+}ventoy_chunk_cache_stat;
+
+static int g_chunk_cache_state = 0; /* 0: not loaded  1: enabled  -1: disabled */
+static int g_chunk_cache_readonly = 0;
+static int g_chunk_cache_hit = 0;
+static int g_chunk_cache_miss = 0;
+static char *g_chunk_cache_buf = NULL;
+static grub_uint32_t g_chunk_cache_size = 0;
+static ventoy_chunk_cache_head *g_chunk_cache_head = NULL;
+
+#define VTOY_CHUNK_CACHE_ALIGN(x)  (((x) + 7) & (~((grub_uint32_t)7)))
+
+static inline const char * ventoy_chunk_cache_ent_path(const ventoy_chunk_cache_ent *ent)
+{
+    return (const char *)(ent + 1);
+}
+
+static inline ventoy_img_chunk * ventoy_chunk_cache_ent_chunk(const ventoy_chunk_cache_ent *ent)
+{
+    return (ventoy_img_chunk *)((char *)(ent + 1) + VTOY_CHUNK_CACHE_ALIGN(ent->path_len));
+}
+
+static inline ventoy_chunk_cache_ent * ventoy_chunk_cache_ent_next(const ventoy_chunk_cache_ent *ent)
+{
+    return (ventoy_chunk_cache_ent *)((char *)ent + ent->ent_size);
+}
+
+static void ventoy_chunk_cache_reset(void)
+{
+    ventoy_chunk_cache_head *head = g_chunk_cache_head;
+
+    grub_memset(head, 0, sizeof(ventoy_chunk_cache_head));
+    grub_memcpy(head->magic, VTOY_CHUNK_CACHE_MAGIC, sizeof(VTOY_CHUNK_CACHE_MAGIC));
+    head->version = VTOY_CHUNK_CACHE_VERSION;
+    head->head_size = sizeof(ventoy_chunk_cache_head);
+    head->crc32 = grub_getcrc32c(0, head + 1, 0);
+}
+
+static int ventoy_chunk_cache_check(void)
+{
+    grub_uint32_t i;
+    grub_uint32_t pos = 0;
+    grub_uint64_t need = 0;
+    const ventoy_chunk_cache_ent *ent = NULL;
+    const ventoy_chunk_cache_head *head = g_chunk_cache_head;
+
+    if (grub_memcmp(head->magic, VTOY_CHUNK_CACHE_MAGIC, sizeof(VTOY_CHUNK_CACHE_MAGIC)) ||
+        head->version != VTOY_CHUNK_CACHE_VERSION ||
+        head->head_size != sizeof(ventoy_chunk_cache_head))
+    {
+        debug("chunk cache invalid head %u %u\n", head->version, head->head_size);
+        return 1;
+    }
+
+    if (head->used > g_chunk_cache_size - sizeof(ventoy_chunk_cache_head))
+    {
+        debug("chunk cache invalid used size %u\n", head->used);
+        return 1;
+    }
+
+    if (head->crc32 != grub_getcrc32c(0, head + 1, head->used))
+    {
+        debug("chunk cache crc32 mismatch\n");
+        return 1;
+    }
+
+    ent = (ventoy_chunk_cache_ent *)(head + 1);
+    for (i = 0; i < head->ent_num; i++)
+    {
+        if (head->used - pos < sizeof(ventoy_chunk_cache_ent))
+        {
+            debug("chunk cache entry %u out of range\n", i);
+            return 1;
+        }
+
+        need = sizeof(ventoy_chunk_cache_ent) + VTOY_CHUNK_CACHE_ALIGN((grub_uint64_t)ent->path_len) +
+               (grub_uint64_t)ent->chunk_num * sizeof(ventoy_img_chunk);
+        if (ent->path_len == 0 || ent->chunk_num == 0 || need != ent->ent_size ||
+            ent->ent_size > head->used - pos || ventoy_chunk_cache_ent_path(ent)[ent->path_len - 1])
+        {
+            debug("chunk cache invalid entry %u\n", i);
+            return 1;
+        }
+
+        pos += ent->ent_size;
+        ent = ventoy_chunk_cache_ent_next(ent);
+    }
+
+    if (pos != head->used)
+    {
+        debug("chunk cache size mismatch %u %u\n", pos, head->used);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_chunk_cache_load(void)
+{
+    grub_file_t file = NULL;
+
+    if (g_chunk_cache_state)
+    {
+        return (g_chunk_cache_state > 0) ? 0 : 1;
+    }
+
+    g_chunk_cache_state = -1;
+
+    if (g_iso_path[0] == 0)
+    {
+        return 1;
+    }
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s%s", g_iso_path, VTOY_CHUNK_CACHE_FILE);
+    if (!file)
+    {
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+
+    if (file->size < sizeof(ventoy_chunk_cache_head) || file->size > VTOY_CHUNK_CACHE_MAX_SIZE)
+    {
+        debug("chunk cache invalid file size %llu\n", (ulonglong)file->size);
+        grub_file_close(file);
+        return 1;
+    }
+
+    g_chunk_cache_size = (grub_uint32_t)file->size;
+    g_chunk_cache_buf = grub_malloc(g_chunk_cache_size);
+    if (!g_chunk_cache_buf)
+    {
+        grub_file_close(file);
+        return 1;
+    }
+
+    if (grub_file_read(file, g_chunk_cache_buf, g_chunk_cache_size) != (grub_ssize_t)g_chunk_cache_size)
+    {
+        debug("chunk cache read failed %u\n", g_chunk_cache_size);
+        grub_file_close(file);
+        grub_free(g_chunk_cache_buf);
+        g_chunk_cache_buf = NULL;
+        g_chunk_cache_size = 0;
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+    grub_file_close(file);
+
+    g_chunk_cache_head = (ventoy_chunk_cache_head *)g_chunk_cache_buf;
+    if (ventoy_chunk_cache_check())
+    {
+        debug("chunk cache is empty or invalid, reset it\n");
+        ventoy_chunk_cache_reset();
+    }
+
+    debug("chunk cache loaded, size:%u entry:%u used:%u\n", g_chunk_cache_size,
+          g_chunk_cache_head->ent_num, g_chunk_cache_head->used);
+
+    g_chunk_cache_state = 1;
+    return 0;
+}
+
+static ventoy_chunk_cache_ent * ventoy_chunk_cache_find(const char *path)
+{
+    grub_uint32_t i;
+    ventoy_chunk_cache_ent *ent = (ventoy_chunk_cache_ent *)(g_chunk_cache_head + 1);
+
+    for (i = 0; i < g_chunk_cache_head->ent_num; i++)
+    {
+        if (grub_strcmp(ventoy_chunk_cache_ent_path(ent), path) == 0)
+        {
+            return ent;
+        }
+        ent = ventoy_chunk_cache_ent_next(ent);
+    }
+
+    return NULL;
+}
+
+static void ventoy_chunk_cache_remove(ventoy_chunk_cache_ent *ent)
+{
+    grub_uint32_t size = ent->ent_size;
+    char *end = (char *)(g_chunk_cache_head + 1) + g_chunk_cache_head->used;
+
+    grub_memmove(ent, (char *)ent + size, end - ((char *)ent + size));
+    g_chunk_cache_head->used -= size;
+    g_chunk_cache_head->ent_num--;
+}
+
+static int ventoy_chunk_cache_mtime_hook(const char *filename, const struct grub_dirhook_info *info, void *data)
+{
+    ventoy_chunk_cache_stat *stat = (ventoy_chunk_cache_stat *)data;
+
+    if (info->dir)
+    {
+        return 0;
+    }
+
+    if (grub_strcmp(filename, stat->name) == 0 ||
+        (info->case_insensitive && grub_strcasecmp(filename, stat->name) == 0))
+    {
+        stat->found = 1;
+        stat->mtimeset = info->mtimeset;
+        stat->mtime = info->mtime;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_chunk_cache_get_mtime(grub_file_t file, const char *path, ventoy_chunk_cache_stat *stat)
+{
+    char *dir = NULL;
+    char *pos = NULL;
+
+    grub_memset(stat, 0, sizeof(ventoy_chunk_cache_stat));
+
+    if (!file->fs->fs_dir)
+    {
+        return 1;
+    }
+
+    dir = grub_strdup(path);
+    if (!dir)
+    {
+        return 1;
+    }
+
+    pos = grub_strrchr(dir, '/');
+    stat->name = path + (pos - dir) + 1;
+    if (pos == dir)
+    {
+        pos[1] = 0;
+    }
+    else
+    {
+        *pos = 0;
+    }
+
+    file->fs->fs_dir(file->device, dir, ventoy_chunk_cache_mtime_hook, stat);
+    grub_errno = GRUB_ERR_NONE;
+    grub_free(dir);
+
+    return (stat->found && stat->mtimeset) ? 0 : 1;
+}
+
+static grub_uint64_t ventoy_chunk_cache_file_id(grub_file_t file, grub_disk_addr_t start, grub_uint64_t *sector)
+{
+    int fs_type;
+
+    *sector = 0;
+    fs_type = ventoy_get_fs_type(file->fs->name);
+    if (fs_type == ventoy_fs_exfat)
+    {
+        return grub_fat_get_file_cluster(start, file, sector);
+    }
+    else if (fs_type == ventoy_fs_ext)
+    {
+        return grub_ext_get_file_inode(file);
+    }
+    else if (fs_type == ventoy_fs_xfs)
+    {
+        return grub_xfs_get_file_inode(file);
+    }
+    else if (fs_type == ventoy_fs_ntfs)
+    {
+        return grub_ntfs_get_file_ref(file);
+    }
+
+    /* no file identity, the file is not cached */
+    return 0;
+}
+
+/*
+ * Compare the first 512 bytes of the index-th disk sector of the file.
+ * The chunk sectors are in disk sector size, grub_disk_read is always in 512.
+ */
+static int ventoy_chunk_cache_cmp_sector(grub_file_t file, grub_uint64_t index,
+                                         grub_disk_addr_t sector, grub_disk_addr_t start)
+{
+    grub_uint32_t len;
+    grub_uint32_t shift;
+    grub_uint64_t offset;
+    char buf[1024];
+
+    shift = file->device->disk->log_sector_size - GRUB_DISK_SECTOR_BITS;
+    offset = index << file->device->disk->log_sector_size;
+    len = (file->size - offset >= 512) ? 512 : (grub_uint32_t)(file->size - offset);
+
+    grub_file_seek(file, offset);
+    if (grub_file_read(file, buf, len) != (grub_ssize_t)len)
+    {
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+
+    if (grub_disk_read(file->device->disk, (sector << shift) - start, 0, len, buf + 512))
+    {
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+
+    return grub_memcmp(buf, buf + 512, len) ? 1 : 0;
+}
+
+/* only read the first and the last sector, not the whole file */
+static int ventoy_chunk_cache_verify(grub_file_t file, const ventoy_chunk_cache_ent *ent,
+                                     grub_disk_addr_t start, grub_uint64_t first_sector)
+{
+    int rc = 1;
+    grub_uint32_t i;
+    grub_uint64_t total = 0;
+    const ventoy_img_chunk *chunk = ventoy_chunk_cache_ent_chunk(ent);
+    const ventoy_img_chunk *last = chunk + ent->chunk_num - 1;
+
+    /* the file must still start at the recorded first cluster */
+    if (first_sector && chunk->disk_start_sector != first_sector)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < ent->chunk_num; i++)
+    {
+        if (chunk[i].disk_start_sector <= start || chunk[i].disk_end_sector < chunk[i].disk_start_sector)
+        {
+            return 1;
+        }
+        total += chunk[i].disk_end_sector + 1 - chunk[i].disk_start_sector;
+    }
+
+    if (total == 0 || ((total - 1) << file->device->disk->log_sector_size) >= file->size)
+    {
+        return 1;
+    }
+
+    if (ventoy_chunk_cache_cmp_sector(file, 0, chunk->disk_start_sector, start) == 0 &&
+        ventoy_chunk_cache_cmp_sector(file, total - 1, last->disk_end_sector, start) == 0)
+    {
+        rc = 0;
+    }
+
+    grub_file_seek(file, 0);
+    return rc;
+}
+
+static void ventoy_chunk_cache_store(const char *path, ventoy_chunk_cache_stat *stat, grub_uint64_t file_id,
+                                     grub_file_t file, ventoy_img_chunk_list *chunklist, grub_disk_addr_t start)
+{
+    grub_uint32_t len;
+    char cachefile[512];
+    grub_uint32_t size;
+    grub_uint32_t space;
+    ventoy_chunk_cache_ent *ent = NULL;
+    ventoy_chunk_cache_head *head = g_chunk_cache_head;
+
+    ent = ventoy_chunk_cache_find(path);
+    if (ent)
+    {
+        ventoy_chunk_cache_remove(ent);
+    }
+
+    len = (grub_uint32_t)grub_strlen(path) + 1;
+    size = sizeof(ventoy_chunk_cache_ent) + VTOY_CHUNK_CACHE_ALIGN(len) + chunklist->cur_chunk * sizeof(ventoy_img_chunk);
+    space = g_chunk_cache_size - sizeof(ventoy_chunk_cache_head);
+    if (size > space)
+    {
+        debug("chunk cache too small for <%s> %u\n", path, size);
+        return;
+    }
+
+    /* drop the oldest entries to make room */
+    while (head->used + size > space)
+    {
+        ventoy_chunk_cache_remove((ventoy_chunk_cache_ent *)(head + 1));
+    }
+
+    ent = (ventoy_chunk_cache_ent *)((char *)(head + 1) + head->used);
+    grub_memset(ent, 0, size);
+    ent->ent_size = size;
+    ent->path_len = len;
+    ent->file_size = file->size;
+    ent->part_start = start;
+    ent->mtime = stat->mtime;
+    ent->chunk_num = chunklist->cur_chunk;
+    ent->file_id = file_id;
+    grub_memcpy(ent + 1, path, len);
+    grub_memcpy(ventoy_chunk_cache_ent_chunk(ent), chunklist->chunk, chunklist->cur_chunk * sizeof(ventoy_img_chunk));
+
+    head->ent_num++;
+    head->used += size;
+    head->crc32 = grub_getcrc32c(0, head + 1, head->used);
+
+    if (g_chunk_cache_readonly)
+    {
+        return;
+    }
+
+    grub_snprintf(cachefile, sizeof(cachefile), "%s%s", g_iso_path, VTOY_CHUNK_CACHE_FILE);
+    /* the entries after used are ignored, so only write what is valid */
+    if (ventoy_file_overwrite(cachefile, g_chunk_cache_buf, sizeof(ventoy_chunk_cache_head) + head->used,
+                              VTOY_CHUNK_CACHE_MAX_SIZE, -1))
+    {
+        /* don't try again for every image */
+        debug("chunk cache save failed <%s>, keep it in memory\n", grub_errmsg);
+        grub_errno = GRUB_ERR_NONE;
+        g_chunk_cache_readonly = 1;
+    }
+}
+
+static int ventoy_chunk_cache_use(ventoy_chunk_cache_ent *ent, ventoy_img_chunk_list *chunklist)
+{
+    ventoy_img_chunk *chunk = NULL;
+
+    if (ent->chunk_num > chunklist->max_chunk)
+    {
+        chunk = grub_realloc(chunklist->chunk, ent->chunk_num * sizeof(ventoy_img_chunk));
+        if (!chunk)
+        {
+            grub_errno = GRUB_ERR_NONE;
+            return 1;
+        }
+
+        chunklist->chunk = chunk;
+        chunklist->max_chunk = ent->chunk_num;
+    }
+
+    grub_memcpy(chunklist->chunk, ventoy_chunk_cache_ent_chunk(ent), ent->chunk_num * sizeof(ventoy_img_chunk));
+    chunklist->cur_chunk = ent->chunk_num;
+    chunklist->err_code = 0;
+    return 0;
+}
+
+/*
+ * Same as ventoy_get_block_list + ventoy_check_block_list, but take the
+ * chunk list from the cache when possible. Only files on the Ventoy
+ * partition are cached.
+ */
+int ventoy_get_block_list_cached(grub_file_t file, ventoy_img_chunk_list *chunklist,
+                                 grub_disk_addr_t start, char *err, grub_uint32_t len)
+{
+    int rc;
+    grub_size_t plen;
+    grub_uint64_t file_id = 0;
+    grub_uint64_t first_sector = 0;
+    const char *path = NULL;
+    ventoy_chunk_cache_ent *ent = NULL;
+    ventoy_chunk_cache_stat stat;
+
+    plen = grub_strlen(g_iso_path);
+    if (plen > 0 && file->device->disk && grub_strncmp(file->name, g_iso_path, plen) == 0 &&
+        file->name[plen] == '/' && ventoy_chunk_cache_load() == 0 &&
+        ventoy_chunk_cache_get_mtime(file, file->name + plen, &stat) == 0)
+    {
+        file_id = ventoy_chunk_cache_file_id(file, start, &first_sector);
+        if (file_id)
+        {
+            path = file->name + plen;
+        }
+        else
+        {
+            debug("chunk cache skip <%s> no file id on %s\n", file->name + plen, file->fs->name);
+        }
+    }
+
+    if (path)
+    {
+        ent = ventoy_chunk_cache_find(path);
+        if (ent && ent->file_size == file->size && ent->mtime == stat.mtime && ent->part_start == start &&
+            ent->file_id == file_id && ventoy_chunk_cache_verify(file, ent, start, first_sector) == 0 &&
+            ventoy_chunk_cache_use(ent, chunklist) == 0)
+        {
+            debug("chunk cache hit <%s> chunk:%u\n", path, ent->chunk_num);
+            g_chunk_cache_hit++;
+            ventoy_perf_add(vtoy_perf_cnt_chunk_cache_hit, 1);
+            return 0;
+        }
+
+        debug("chunk cache miss <%s> %s\n", path, ent ? "changed" : "not found");
+        g_chunk_cache_miss++;
+        ventoy_perf_add(vtoy_perf_cnt_chunk_cache_miss, 1);
+    }
+
+    ventoy_get_block_list(file, chunklist, start);
+    rc = ventoy_check_block_list(file, chunklist, start, err, len);
+
+    if (rc == 0 && path)
+    {
+        ventoy_chunk_cache_store(path, &stat, file_id, file, chunklist, start);
+    }
+
+    return rc;
+}
+
+grub_err_t ventoy_cmd_dump_chunk_cache(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    grub_uint32_t i;
+    ventoy_chunk_cache_ent *ent = NULL;
+
+    (void)ctxt;
+    (void)argc;
+    (void)args;
+
+    if (ventoy_chunk_cache_load())
+    {
+        grub_printf("Chunk cache is not enabled\n");
+        return 0;
+    }
+
+    grub_printf("Chunk cache: size:%u entry:%u used:%u hit:%d miss:%d%s\n", g_chunk_cache_size,
+                g_chunk_cache_head->ent_num, g_chunk_cache_head->used, g_chunk_cache_hit,
+                g_chunk_cache_miss, g_chunk_cache_readonly ? " (readonly)" : "");
+
+    ent = (ventoy_chunk_cache_ent *)(g_chunk_cache_head + 1);
+    for (i = 0; i < g_chunk_cache_head->ent_num; i++)
+    {
+        grub_printf("<%s> size:%llu mtime:%d id:%llu chunk:%u\n", ventoy_chunk_cache_ent_path(ent),
+                    (ulonglong)ent->file_size, ent->mtime, (ulonglong)ent->file_id, ent->chunk_num);
+        ent = ventoy_chunk_cache_ent_next(ent);
+    }
+
+    return 0;
+}
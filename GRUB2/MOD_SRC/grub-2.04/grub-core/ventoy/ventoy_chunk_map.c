@@ -0,0 +1,372 @@
+/******************************************************************************
+ * ventoy_chunk_map.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/*
+ * Encoder/decoder of the compact image chunk map (format described in
+ * grub/ventoy.h). A 24 bytes ventoy_img_chunk usually takes 5~10 bytes,
+ * and a run of fragments with the same stride (e.g. two files written
+ * at the same time) only takes one record.
+ * The map is only used when the chunk list is large, a normal image
+ * still use the plain ventoy_img_chunk array.
+ */
+
+#define VTOY_ZIGZAG_ENC(v)  (((grub_uint64_t)(v) << 1) ^ (grub_uint64_t)((grub_int64_t)(v) >> 63))
+#define VTOY_ZIGZAG_DEC(v)  ((grub_int64_t)((v) >> 1) ^ (-(grub_int64_t)((v) & 1)))
+
+typedef struct ventoy_chunk_map_rec
+{
+    grub_uint32_t img_gap;
+    grub_uint32_t img_len;
+    grub_int64_t  disk_gap;
+    grub_int64_t  disk_extra;
+}ventoy_chunk_map_rec;
+
+static grub_uint32_t ventoy_chunk_map_put(grub_uint8_t *data, grub_uint32_t pos, grub_uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        if (data)
+        {
+            data[pos] = (grub_uint8_t)(value | 0x80);
+        }
+        pos++;
+        value >>= 7;
+    }
+
+    if (data)
+    {
+        data[pos] = (grub_uint8_t)value;
+    }
+
+    return pos + 1;
+}
+
+static int ventoy_chunk_map_get(ventoy_chunk_map_cursor *cursor, grub_uint64_t *value)
+{
+    int shift = 0;
+    grub_uint8_t byte;
+    grub_uint64_t ret = 0;
+    const grub_uint8_t *data = cursor->data;
+
+    do
+    {
+        if (cursor->pos >= cursor->head->data_size || shift > 63)
+        {
+            return 1;
+        }
+
+        byte = data[cursor->pos++];
+        ret |= ((grub_uint64_t)(byte & 0x7F)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = ret;
+    return 0;
+}
+
+static int ventoy_chunk_map_calc(const ventoy_img_chunk *chunk, grub_uint32_t last_img_end,
+                                 grub_uint64_t last_disk_end, ventoy_chunk_map_rec *rec)
+{
+    grub_uint64_t disk_len;
+
+    /* last_img_end is 0xFFFFFFFF for a group starting at sector 0 */
+    if (chunk->img_end_sector < chunk->img_start_sector || chunk->disk_end_sector < chunk->disk_start_sector ||
+        (last_img_end != 0xFFFFFFFF && chunk->img_start_sector <= last_img_end))
+    {
+        return 1; /* not sorted, can not be encoded */
+    }
+
+    disk_len = chunk->disk_end_sector + 1 - chunk->disk_start_sector;
+
+    rec->img_gap = chunk->img_start_sector - last_img_end - 1;
+    rec->img_len = chunk->img_end_sector + 1 - chunk->img_start_sector;
+    rec->disk_gap = (grub_int64_t)(chunk->disk_start_sector - last_disk_end - 1);
+    rec->disk_extra = (grub_int64_t)disk_len - (grub_int64_t)rec->img_len * 4;
+    return 0;
+}
+
+static grub_uint32_t ventoy_chunk_map_encode(const ventoy_img_chunk *chunk, grub_uint32_t num, void *buf)
+{
+    grub_uint32_t i, j;
+    grub_uint32_t pos = 0;
+    grub_uint32_t index_num;
+    grub_uint32_t last_img_end = 0;
+    grub_uint64_t last_disk_end = 0;
+    grub_uint8_t *data = NULL;
+    ventoy_chunk_map_rec rec;
+    ventoy_chunk_map_rec next;
+    ventoy_chunk_map_head *head = (ventoy_chunk_map_head *)buf;
+    ventoy_chunk_map_index *index = NULL;
+
+    index_num = (num + VTOY_CHUNK_MAP_GROUP - 1) / VTOY_CHUNK_MAP_GROUP;
+    if (head)
+    {
+        index = (ventoy_chunk_map_index *)(head + 1);
+        data = (grub_uint8_t *)(index + index_num);
+    }
+
+    for (i = 0; i < num; i = j)
+    {
+        if (i % VTOY_CHUNK_MAP_GROUP == 0)
+        {
+            if (index)
+            {
+                index[i / VTOY_CHUNK_MAP_GROUP].img_start_sector = chunk[i].img_start_sector;
+                index[i / VTOY_CHUNK_MAP_GROUP].data_offset = pos;
+                index[i / VTOY_CHUNK_MAP_GROUP].disk_start_sector = chunk[i].disk_start_sector;
+            }
+            last_img_end = chunk[i].img_start_sector - 1;
+            last_disk_end = chunk[i].disk_start_sector - 1;
+        }
+
+        if (ventoy_chunk_map_calc(chunk + i, last_img_end, last_disk_end, &rec))
+        {
+            return 0;
+        }
+
+        for (j = i + 1; j < num && (j % VTOY_CHUNK_MAP_GROUP) != 0; j++)
+        {
+            if (ventoy_chunk_map_calc(chunk + j, chunk[j - 1].img_end_sector, chunk[j - 1].disk_end_sector, &next))
+            {
+                return 0;
+            }
+
+            if (grub_memcmp(&rec, &next, sizeof(rec)))
+            {
+                break;
+            }
+        }
+
+        pos = ventoy_chunk_map_put(data, pos, j - i);
+        pos = ventoy_chunk_map_put(data, pos, rec.img_gap);
+        pos = ventoy_chunk_map_put(data, pos, rec.img_len);
+        pos = ventoy_chunk_map_put(data, pos, VTOY_ZIGZAG_ENC(rec.disk_gap));
+        pos = ventoy_chunk_map_put(data, pos, VTOY_ZIGZAG_ENC(rec.disk_extra));
+
+        last_img_end = chunk[j - 1].img_end_sector;
+        last_disk_end = chunk[j - 1].disk_end_sector;
+    }
+
+    pos = ventoy_align(pos, 8);
+
+    if (head)
+    {
+        grub_memcpy(head->magic, VTOY_CHUNK_MAP_MAGIC, sizeof(head->magic));
+        head->version = VTOY_CHUNK_MAP_VERSION;
+        head->head_size = sizeof(ventoy_chunk_map_head);
+        head->chunk_num = num;
+        head->group_size = VTOY_CHUNK_MAP_GROUP;
+        head->index_num = index_num;
+        head->data_size = pos;
+    }
+
+    return sizeof(ventoy_chunk_map_head) + index_num * sizeof(ventoy_chunk_map_index) + pos;
+}
+
+int ventoy_chunk_map_check(const void *map)
+{
+    const ventoy_chunk_map_head *head = (const ventoy_chunk_map_head *)map;
+
+    if (grub_memcmp(head->magic, VTOY_CHUNK_MAP_MAGIC, sizeof(head->magic)) == 0 &&
+        head->version == VTOY_CHUNK_MAP_VERSION && head->head_size == sizeof(ventoy_chunk_map_head) &&
+        head->group_size > 0)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+int ventoy_chunk_map_seek(ventoy_chunk_map_cursor *cursor, const void *map, grub_uint32_t id)
+{
+    ventoy_img_chunk chunk;
+    const ventoy_chunk_map_index *index = NULL;
+
+    grub_memset(cursor, 0, sizeof(ventoy_chunk_map_cursor));
+    cursor->head = (const ventoy_chunk_map_head *)map;
+    index = (const ventoy_chunk_map_index *)(cursor->head + 1);
+    cursor->index = index;
+    cursor->data = (const grub_uint8_t *)(index + cursor->head->index_num);
+
+    if (id >= cursor->head->chunk_num)
+    {
+        cursor->next = cursor->head->chunk_num;
+        return 1;
+    }
+
+    index += id / cursor->head->group_size;
+    cursor->next = id - id % cursor->head->group_size;
+    cursor->pos = index->data_offset;
+    cursor->img_end = index->img_start_sector - 1;
+    cursor->disk_end = index->disk_start_sector - 1;
+
+    while (cursor->next < id)
+    {
+        if (ventoy_chunk_map_next(cursor, &chunk))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int ventoy_chunk_map_next(ventoy_chunk_map_cursor *cursor, ventoy_img_chunk *chunk)
+{
+    grub_uint64_t value[5];
+    const ventoy_chunk_map_index *index = NULL;
+
+    if (cursor->next >= cursor->head->chunk_num)
+    {
+        return 1;
+    }
+
+    if (cursor->next % cursor->head->group_size == 0)
+    {
+        index = cursor->index + cursor->next / cursor->head->group_size;
+        cursor->pos = index->data_offset;
+        cursor->img_end = index->img_start_sector - 1;
+        cursor->disk_end = index->disk_start_sector - 1;
+        cursor->repeat = 0;
+    }
+
+    if (cursor->repeat == 0)
+    {
+        if (ventoy_chunk_map_get(cursor, value) || ventoy_chunk_map_get(cursor, value + 1) ||
+            ventoy_chunk_map_get(cursor, value + 2) || ventoy_chunk_map_get(cursor, value + 3) ||
+            ventoy_chunk_map_get(cursor, value + 4) || value[0] == 0 || value[2] == 0)
+        {
+            return 1;
+        }
+
+        cursor->repeat = (grub_uint32_t)value[0];
+        cursor->img_gap = (grub_uint32_t)value[1];
+        cursor->img_len = (grub_uint32_t)value[2];
+        cursor->disk_gap = VTOY_ZIGZAG_DEC(value[3]);
+        cursor->disk_extra = VTOY_ZIGZAG_DEC(value[4]);
+    }
+
+    chunk->img_start_sector = cursor->img_end + 1 + cursor->img_gap;
+    chunk->img_end_sector = chunk->img_start_sector + cursor->img_len - 1;
+    chunk->disk_start_sector = cursor->disk_end + 1 + (grub_uint64_t)cursor->disk_gap;
+    chunk->disk_end_sector = chunk->disk_start_sector + (grub_uint64_t)((grub_int64_t)cursor->img_len * 4 + cursor->disk_extra) - 1;
+
+    cursor->img_end = chunk->img_end_sector;
+    cursor->disk_end = chunk->disk_end_sector;
+    cursor->repeat--;
+    cursor->next++;
+    return 0;
+}
+
+static int ventoy_chunk_map_verify(const ventoy_img_chunk_list *list, const void *map)
+{
+    grub_uint32_t i;
+    ventoy_img_chunk chunk;
+    ventoy_chunk_map_cursor cursor;
+
+    if (ventoy_chunk_map_check(map) || ventoy_chunk_map_seek(&cursor, map, 0))
+    {
+        return 1;
+    }
+
+    for (i = 0; i < list->cur_chunk; i++)
+    {
+        if (ventoy_chunk_map_next(&cursor, &chunk) || grub_memcmp(&chunk, list->chunk + i, sizeof(chunk)))
+        {
+            debug("chunk map verify failed at %u\n", i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Size of the image chunk data put in the chain or in ventoy_image_map.
+ * It's the compact map for a large chunk list, otherwise the plain array.
+ */
+grub_uint32_t ventoy_img_chunk_data_size(const ventoy_img_chunk_list *list)
+{
+    grub_uint32_t size;
+    grub_uint32_t rawsize;
+    void *map = NULL;
+
+    rawsize = list->cur_chunk * sizeof(ventoy_img_chunk);
+    if (list->cur_chunk < VTOY_CHUNK_MAP_MIN_CHUNK)
+    {
+        return rawsize;
+    }
+
+    size = ventoy_chunk_map_encode(list->chunk, list->cur_chunk, NULL);
+    if (size == 0 || size >= rawsize)
+    {
+        debug("chunk map not used %u %u\n", size, rawsize);
+        return rawsize;
+    }
+
+    /* check the encoder once, never boot with a broken map */
+    map = grub_zalloc(size);
+    if (!map)
+    {
+        return rawsize;
+    }
+
+    ventoy_chunk_map_encode(list->chunk, list->cur_chunk, map);
+    if (ventoy_chunk_map_verify(list, map))
+    {
+        size = rawsize;
+    }
+
+    grub_free(map);
+
+    debug("chunk map chunk:%u size:%u raw:%u\n", list->cur_chunk, size, rawsize);
+    return size;
+}
+
+/* size must be got from ventoy_img_chunk_data_size */
+void ventoy_img_chunk_data_fill(const ventoy_img_chunk_list *list, void *buf, grub_uint32_t size)
+{
+    if (size == list->cur_chunk * sizeof(ventoy_img_chunk))
+    {
+        grub_memcpy(buf, list->chunk, size);
+    }
+    else
+    {
+        grub_memset(buf, 0, size);
+        ventoy_chunk_map_encode(list->chunk, list->cur_chunk, buf);
+    }
+}
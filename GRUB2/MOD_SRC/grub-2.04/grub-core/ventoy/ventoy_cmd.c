@@ -84,6 +84,14 @@ int g_img_max_search_level = -1;
 img_iterator_node g_img_iterator_head;
 img_iterator_node *g_img_iterator_tail = NULL;
 
+/* img_info list and img_iterator_node are allocated from these arenas */
+static ventoy_arena g_img_arena;
+static ventoy_arena g_node_arena;
+
+/* scratch buffer for the paths built during enumeration, grows as needed */
+static char *g_img_path_buf = NULL;
+static grub_size_t g_img_path_buf_size = 0;
+
 grub_uint8_t g_ventoy_break_level = 0;
 grub_uint8_t g_ventoy_debug_level = 0;
 grub_uint8_t g_ventoy_chain_type = 0;
@@ -129,6 +137,16 @@ int g_tree_script_pre = 0;
 static char *g_list_script_buf = NULL;
 static int g_list_script_pos = 0;
 
+static char *g_default_menu_id = NULL;
+static int g_tree_menu_dir_num = 0;
+static int g_tree_menu_dir_max = 0;
+static int g_tree_menu_dir_fail = 0;
+static tree_menu_dir *g_tree_menu_dir = NULL;
+
+static int g_tree_menu_lazy = 0;
+static int g_tree_script_done = 0;
+static img_info **g_tree_menu_imgs = NULL;
+
 static char *g_part_list_buf = NULL;
 static int g_part_list_pos = 0;
 static grub_uint64_t g_part_end_max = 0;
@@ -171,6 +189,8 @@ static char g_vtoy_prompt_msg[64];
 static char g_json_case_mis_path[32];
 
 static ventoy_vlnk_part *g_vlnk_part_list = NULL;
+static ventoy_vlnk_part *g_vlnk_part_hash[VTOY_VLNK_PART_HASH_SIZE];
+static int g_vlnk_part_scanned = 0;
 
 int ventoy_get_fs_type(const char *fs)
 {
@@ -704,20 +724,6 @@ static int ventoy_check_official_device(grub_device_t dev)
     return ventoy_set_check_result(0, NULL);
 }
 
-static int ventoy_check_ignore_flag(const char *filename, const struct grub_dirhook_info *info, void *data)
-{
-    if (0 == info->dir)
-    {
-        if (filename && filename[0] == '.' && 0 == grub_strncmp(filename, ".ventoyignore", 13))
-        {
-            *((int *)data) = 1;
-            return 0;
-        }
-    }
-
-    return 0;
-}
-
 grub_uint64_t ventoy_grub_get_file_size(const char *fmt, ...)
 {
     grub_uint64_t size = 0;
@@ -1294,12 +1300,208 @@ static grub_err_t ventoy_cmd_load_file_to_mem(grub_extcmd_context_t ctxt, int ar
     return rc;
 }
 
+#ifdef GRUB_MACHINE_EFI
+/*
+ * Ventoy.efi can fill the memdisk on demand from the chunk list, so there is
+ * no need to wait for the whole image to be read here.
+ * VTOY_MEMDISK_LAZY=0 to always load the image in grub.
+ */
+static int ventoy_memdisk_get_chunk(grub_file_t file, ventoy_img_chunk_list *chunklist)
+{
+    int fs_type;
+    char errmsg[128];
+    const char *val = NULL;
+
+    val = ventoy_get_env("VTOY_MEMDISK_LAZY");
+    if (val && val[0] == '0' && val[1] == 0)
+    {
+        return 1;
+    }
+
+    fs_type = ventoy_get_fs_type(file->fs->name);
+    if (fs_type >= ventoy_fs_max || fs_type == ventoy_fs_btrfs)
+    {
+        return 1;
+    }
+
+    grub_memset(chunklist, 0, sizeof(ventoy_img_chunk_list));
+    chunklist->chunk = grub_malloc(sizeof(ventoy_img_chunk) * DEFAULT_CHUNK_NUM);
+    if (NULL == chunklist->chunk)
+    {
+        return 1;
+    }
+
+    chunklist->max_chunk = DEFAULT_CHUNK_NUM;
+    chunklist->cur_chunk = 0;
+
+    if (ventoy_get_block_list_cached(file, chunklist, file->device->disk->partition->start, errmsg, sizeof(errmsg)))
+    {
+        debug("memdisk fallback to full load: %s\n", errmsg);
+        grub_check_free(chunklist->chunk);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_memdisk_compress_enabled(void)
+{
+    const char *val = ventoy_get_env("VTOY_MEMDISK_COMPRESS");
+
+    return (val && val[0] == '1' && val[1] == 0);
+}
+
+static int ventoy_is_zero_block(const grub_uint8_t *data, grub_uint32_t len)
+{
+    grub_uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * VTOY_MEMDISK_COMPRESS=1: keep the image LZ4 compressed in memory, in
+ * VTOY_CMEM_BLOCK_SIZE blocks which Ventoy.efi decompresses on read.
+ * The blocks are packed in VTOY_CMEM_SEG_SIZE segments, so no big
+ * contiguous memory is needed. The OS can not use such a memdisk after
+ * ExitBootServices.
+ */
+static char * ventoy_load_cmem(grub_file_t file, int headlen)
+{
+    int clen;
+    int segnum = 0;
+    int segmax = 0;
+    grub_uint32_t i;
+    grub_uint32_t len;
+    grub_uint32_t num;
+    grub_uint32_t segpos = VTOY_CMEM_SEG_SIZE;
+    grub_uint64_t total = 0;
+    char *buf = NULL;
+    char *seg = NULL;
+    char **seglist = NULL;
+    grub_uint8_t *src = NULL;
+    grub_uint8_t *data = NULL;
+    grub_uint8_t *comp = NULL;
+    ventoy_cmem_head *head = NULL;
+    ventoy_cmem_block *block = NULL;
+
+    num = (grub_uint32_t)((file->size + VTOY_CMEM_BLOCK_SIZE - 1) / VTOY_CMEM_BLOCK_SIZE);
+    segmax = num / (VTOY_CMEM_SEG_SIZE / VTOY_CMEM_BLOCK_SIZE) + 1;
+
+    buf = (char *)grub_efi_allocate_iso_buf(headlen + sizeof(ventoy_cmem_head) + num * sizeof(ventoy_cmem_block));
+    data = grub_malloc(VTOY_CMEM_BLOCK_SIZE);
+    comp = grub_malloc(VTOY_LZ4_BOUND(VTOY_CMEM_BLOCK_SIZE));
+    seglist = grub_zalloc(segmax * sizeof(char *));
+    if (!buf || !data || !comp || !seglist)
+    {
+        goto fail;
+    }
+
+    head = (ventoy_cmem_head *)(buf + headlen);
+    block = (ventoy_cmem_block *)(head + 1);
+
+    grub_memcpy(head->magic, VTOY_CMEM_MAGIC, sizeof(head->magic));
+    head->block_size = VTOY_CMEM_BLOCK_SIZE;
+    head->block_num = num;
+    head->img_size = file->size;
+
+    for (i = 0; i < num; i++)
+    {
+        len = VTOY_CMEM_BLOCK_SIZE;
+        if ((grub_uint64_t)(i + 1) * VTOY_CMEM_BLOCK_SIZE > file->size)
+        {
+            len = (grub_uint32_t)(file->size - (grub_uint64_t)i * VTOY_CMEM_BLOCK_SIZE);
+        }
+
+        if (grub_file_read(file, data, len) != (grub_ssize_t)len)
+        {
+            debug("cmem read block %u failed\n", i);
+            goto fail;
+        }
+
+        block[i].reserved = 0;
+        if (ventoy_is_zero_block(data, len))
+        {
+            block[i].addr = 0;
+            block[i].size = 0;
+            continue;
+        }
+
+        src = comp;
+        clen = ventoy_lz4_compress(data, (int)len, comp);
+        if (clen <= 0 || (grub_uint32_t)clen >= len)
+        {
+            src = data;
+            clen = (int)len;
+        }
+
+        if (segpos + clen > VTOY_CMEM_SEG_SIZE)
+        {
+            if (segnum >= segmax)
+            {
+                goto fail;
+            }
+
+            seg = (char *)grub_efi_allocate_iso_buf(VTOY_CMEM_SEG_SIZE);
+            if (!seg)
+            {
+                debug("cmem alloc segment %d failed\n", segnum);
+                goto fail;
+            }
+            seglist[segnum++] = seg;
+            segpos = 0;
+        }
+
+        grub_memcpy(seg + segpos, src, clen);
+        block[i].addr = (grub_uint64_t)(grub_addr_t)(seg + segpos);
+        block[i].size = (grub_uint32_t)clen;
+        segpos += clen;
+        total += clen;
+    }
+
+    head->mem_size = total;
+    debug("cmem image:%llu stored:%llu segment:%d\n", (ulonglong)file->size, (ulonglong)total, segnum);
+
+    grub_free(data);
+    grub_free(comp);
+    grub_free(seglist);
+    return buf;
+
+fail:
+    while (seglist && segnum > 0)
+    {
+        grub_efi_free_pages((grub_addr_t)seglist[--segnum], VTOY_CMEM_SEG_SIZE >> 12);
+    }
+
+    if (buf)
+    {
+        grub_efi_free_pages((grub_addr_t)buf, (headlen + sizeof(ventoy_cmem_head) + num * sizeof(ventoy_cmem_block) + 4095) >> 12);
+    }
+
+    grub_check_free(data);
+    grub_check_free(comp);
+    grub_check_free(seglist);
+    return NULL;
+}
+#endif
+
 static grub_err_t ventoy_cmd_load_img_memdisk(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     int rc = 1;
     int headlen;
+    int lazy = 0;
     char *buf = NULL;
     grub_file_t file;
+    grub_uint32_t chunksize = 0;
+    ventoy_chain_head *chain = NULL;
+    ventoy_img_chunk_list chunklist;
 
     (void)ctxt;
     (void)argc;
@@ -1320,20 +1522,75 @@ static grub_err_t ventoy_cmd_load_img_memdisk(grub_extcmd_context_t ctxt, int ar
     headlen = sizeof(ventoy_chain_head);
 
 #ifdef GRUB_MACHINE_EFI
-    buf = (char *)grub_efi_allocate_iso_buf(headlen + file->size);
+    if (ventoy_memdisk_compress_enabled())
+    {
+        buf = ventoy_load_cmem(file, headlen);
+        if (buf)
+        {
+            grub_memset(buf, 0, headlen);
+            ventoy_fill_os_param(file, (ventoy_os_param *)buf);
+            ventoy_memfile_env_set(args[1], buf, (ulonglong)(file->size));
+            grub_file_close(file);
+            return 0;
+        }
+
+        debug("compressed memdisk failed, fallback to normal memdisk\n");
+        grub_file_seek(file, 0);
+    }
+
+    lazy = (ventoy_memdisk_get_chunk(file, &chunklist) == 0);
+    if (lazy)
+    {
+        chunksize = ventoy_img_chunk_data_size(&chunklist);
+        buf = (char *)grub_efi_allocate_iso_buf(headlen + ventoy_align_2k(file->size) + chunksize);
+    }
+    else
+    {
+        buf = (char *)grub_efi_allocate_iso_buf(headlen + file->size);
+    }
 #else
     buf = (char *)grub_malloc(headlen + file->size);
 #endif
 
+    if (!buf)
+    {
+        grub_printf("Failed to alloc memdisk memory size %llu\n", (ulonglong)file->size);
+        grub_file_close(file);
+        goto end;
+    }
+
+    grub_memset(buf, 0, headlen);
     ventoy_fill_os_param(file, (ventoy_os_param *)buf);
 
-    grub_file_read(file, buf + headlen, file->size);
+    if (lazy)
+    {
+        /* image area is only reserved, chunk list follows it */
+        chain = (ventoy_chain_head *)buf;
+        chain->disk_drive = file->device->disk->id;
+        chain->disk_sector_size = (1 << file->device->disk->log_sector_size);
+        chain->real_img_size_in_bytes = file->size;
+        chain->virt_img_size_in_bytes = ventoy_align_2k(file->size);
+        chain->img_chunk_offset = headlen + ventoy_align_2k(file->size);
+        chain->img_chunk_num = chunklist.cur_chunk;
+        ventoy_img_chunk_data_fill(&chunklist, buf + chain->img_chunk_offset, chunksize);
+        debug("lazy memdisk chunk:%u\n", chunklist.cur_chunk);
+    }
+    else
+    {
+        grub_file_read(file, buf + headlen, file->size);
+    }
 
     ventoy_memfile_env_set(args[1], buf, (ulonglong)(file->size));
 
     grub_file_close(file);
     rc = 0;
 
+end:
+    if (lazy)
+    {
+        grub_check_free(chunklist.chunk);
+    }
+
     return rc;
 }
 
@@ -1668,6 +1925,151 @@ void ventoy_swap_img(img_info *img1, img_info *img2)
     grub_memcpy(img2, &g_img_swap_tmp, sizeof(img_info));
 }
 
+/* old in-list selection sort, only used when the sort array can not be allocated */
+static void ventoy_select_sort_img_list(void)
+{
+    img_info *min = NULL;
+    img_info *cur = NULL;
+    img_info *head = NULL;
+    img_info *tail = NULL;
+
+    while (g_ventoy_img_list)
+    {
+        min = g_ventoy_img_list;
+        for (cur = g_ventoy_img_list->next; cur; cur = cur->next)
+        {
+            if (ventoy_cmp_img(min, cur) > 0)
+            {
+                min = cur;
+            }
+        }
+
+        if (min->prev)
+        {
+            min->prev->next = min->next;
+        }
+
+        if (min->next)
+        {
+            min->next->prev = min->prev;
+        }
+
+        if (min == g_ventoy_img_list)
+        {
+            g_ventoy_img_list = min->next;
+        }
+
+        if (head == NULL)
+        {
+            head = tail = min;
+            min->prev = NULL;
+            min->next = NULL;
+        }
+        else
+        {
+            tail->next = min;
+            min->prev = tail;
+            min->next = NULL;
+            tail = min;
+        }
+    }
+
+    g_ventoy_img_list = head;
+}
+
+static int ventoy_sort_cmp_img(void *p1, void *p2)
+{
+    return ventoy_cmp_img((img_info *)p1, (img_info *)p2);
+}
+
+static int ventoy_sort_cmp_subdir(void *p1, void *p2)
+{
+    return ventoy_cmp_subdir((img_iterator_node *)p1, (img_iterator_node *)p2);
+}
+
+/*
+ * Stable bottom-up merge sort over an array of pointers.
+ * Equal elements keep their original (enumeration) order, which is the same
+ * as what the old selection sort produced.
+ */
+void ventoy_sort_ptr_array(void **array, int num, ventoy_sort_cmp_pf cmp)
+{
+    int i, j, k;
+    int left, mid, right, width;
+    void *cur = NULL;
+    void **src = array;
+    void **dst = NULL;
+    void **tmp = NULL;
+
+    if (num < 2)
+    {
+        return;
+    }
+
+    tmp = grub_malloc(num * sizeof(void *));
+    if (!tmp)
+    {
+        /* no memory for merge, fall back to insertion sort */
+        for (i = 1; i < num; i++)
+        {
+            cur = array[i];
+            for (j = i; j > 0 && cmp(array[j - 1], cur) > 0; j--)
+            {
+                array[j] = array[j - 1];
+            }
+            array[j] = cur;
+        }
+        return;
+    }
+
+    dst = tmp;
+    for (width = 1; width < num; width *= 2)
+    {
+        for (left = 0; left < num; left += 2 * width)
+        {
+            mid = grub_min(left + width, num);
+            right = grub_min(left + 2 * width, num);
+
+            i = left;
+            j = mid;
+            k = left;
+            while (i < mid && j < right)
+            {
+                /* take the left one when equal to keep the sort stable */
+                if (cmp(src[j], src[i]) < 0)
+                {
+                    dst[k++] = src[j++];
+                }
+                else
+                {
+                    dst[k++] = src[i++];
+                }
+            }
+
+            while (i < mid)
+            {
+                dst[k++] = src[i++];
+            }
+
+            while (j < right)
+            {
+                dst[k++] = src[j++];
+            }
+        }
+
+        cur = src;
+        src = dst;
+        dst = cur;
+    }
+
+    if (src != array)
+    {
+        grub_memcpy(array, src, num * sizeof(void *));
+    }
+
+    grub_free(tmp);
+}
+
 int ventoy_img_name_valid(const char *filename, grub_size_t namelen)
 {
     (void)namelen;
@@ -1703,6 +2105,9 @@ static int ventoy_vlnk_iterate_partition(struct grub_disk *disk, const grub_part
 
         node->next = g_vlnk_part_list;
         g_vlnk_part_list = node;
+
+        node->hnext = g_vlnk_part_hash[node->disksig % VTOY_VLNK_PART_HASH_SIZE];
+        g_vlnk_part_hash[node->disksig % VTOY_VLNK_PART_HASH_SIZE] = node;
     }
 
     return 0;
@@ -1746,7 +2151,7 @@ static int ventoy_vlnk_probe_fs(ventoy_vlnk_part *cur)
     return 0;
 }
 
-static int ventoy_check_vlnk_data(ventoy_vlnk *vlnk, int print, char *dst, int size)
+static int ventoy_check_vlnk_data(ventoy_vlnk *vlnk, int print, char *dst, int size, grub_uint64_t *filesize)
 {
     int diskfind = 0;
     int partfind = 0;
@@ -1779,12 +2184,15 @@ static int ventoy_check_vlnk_data(ventoy_vlnk *vlnk, int print, char *dst, int s
         return 1;
     }
 
-    if (!g_vlnk_part_list)
+    /* scan all the disks only once, even if no partition was found */
+    if (!g_vlnk_part_scanned)
     {
+        g_vlnk_part_scanned = 1;
         grub_disk_dev_iterate(ventoy_vlnk_iterate_disk, NULL);
     }
 
-    for (cur = g_vlnk_part_list; cur && filefind == 0; cur = cur->next)
+    cur = g_vlnk_part_hash[vlnk->disk_signature % VTOY_VLNK_PART_HASH_SIZE];
+    for (; cur && filefind == 0; cur = cur->hnext)
     {
         if (cur->disksig == vlnk->disk_signature)
         {
@@ -1815,6 +2223,10 @@ static int ventoy_check_vlnk_data(ventoy_vlnk *vlnk, int print, char *dst, int s
                     if (cur->fs->fs_open(&file, vlnk->filepath) == GRUB_ERR_NONE)
                     {
                         filefind = 1;
+                        if (filesize)
+                        {
+                            *filesize = file.size;
+                        }
                         cur->fs->fs_close(&file);
                         grub_snprintf(dst, size - 1, "(%s)%s", cur->device, vlnk->filepath);
                     }
@@ -1865,7 +2277,8 @@ static int ventoy_check_vlnk_data(ventoy_vlnk *vlnk, int print, char *dst, int s
     return (1 - filefind);
 }
 
-int ventoy_add_vlnk_file(char *dir, const char *name)
+/* size of the target file is returned if size is not NULL */
+int ventoy_add_vlnk_file(char *dir, const char *name, grub_uint64_t *size)
 {
     int rc = 1;
     char src[512];
@@ -1896,7 +2309,7 @@ int ventoy_add_vlnk_file(char *dir, const char *name)
     grub_file_read(file, &vlnk, sizeof(vlnk));
     grub_file_close(file);
 
-    if (ventoy_check_vlnk_data(&vlnk, 0, dst, sizeof(dst)) == 0)
+    if (ventoy_check_vlnk_data(&vlnk, 0, dst, sizeof(dst), size) == 0)
     {
         rc = grub_file_add_vlnk(src, dst);
     }
@@ -1904,20 +2317,50 @@ int ventoy_add_vlnk_file(char *dir, const char *name)
     return rc;
 }
 
+/* dir + name (+ '/') in g_img_path_buf, no length limit */
+static char * ventoy_img_path_join(const char *dir, grub_size_t dirlen, const char *name, grub_size_t len, int slash)
+{
+    char *buf = NULL;
+    grub_size_t size = dirlen + len + 2;
+
+    if (size > g_img_path_buf_size)
+    {
+        size = (size + 1023) & (~((grub_size_t)1023));
+        buf = grub_realloc(g_img_path_buf, size);
+        if (!buf)
+        {
+            return NULL;
+        }
+        g_img_path_buf = buf;
+        g_img_path_buf_size = size;
+    }
+
+    grub_memcpy(g_img_path_buf, dir, dirlen);
+    grub_memcpy(g_img_path_buf + dirlen, name, len);
+    if (slash)
+    {
+        g_img_path_buf[dirlen + len++] = '/';
+    }
+    g_img_path_buf[dirlen + len] = 0;
+
+    return g_img_path_buf;
+}
+
 static int ventoy_collect_img_files(const char *filename, const struct grub_dirhook_info *info, void *data)
 {
     //int i = 0;
     int type = 0;
-    int ignore = 0;
     int index = 0;
-    int vlnk = 0;
+    int dirlen = 0;
     grub_size_t len;
+    grub_uint64_t size;
+    char *path = NULL;
     img_info *img;
-    img_info *tail;
     const menu_tip *tip;
-    img_iterator_node *tmp;
     img_iterator_node *new_node;
+    img_pend_vcfg *vcfg = NULL;
     img_iterator_node *node = (img_iterator_node *)data;
+    const ventoy_img_index_dir *idxdir = NULL;
 
     if (g_enumerate_time_checked == 0)
     {
@@ -1961,54 +2404,72 @@ static int ventoy_collect_img_files(const char *filename, const struct grub_dirh
             }
         }
 
+        path = ventoy_img_path_join(node->dir, node->dirlen, filename, len, 1);
+        if (!path)
+        {
+            return 0;
+        }
+        dirlen = node->dirlen + (int)len + 1;
+
         if (g_plugin_image_list == VENTOY_IMG_WHITE_LIST)
         {
-            grub_snprintf(g_img_swap_tmp_buf, sizeof(g_img_swap_tmp_buf), "%s%s/", node->dir, filename);
-            index = ventoy_plugin_get_image_list_index(vtoy_class_directory, g_img_swap_tmp_buf);
+            index = ventoy_plugin_get_image_list_index(vtoy_class_directory, path);
             if (index == 0)
             {
-                debug("Directory %s not found in image_list plugin config...\n", g_img_swap_tmp_buf);
+                debug("Directory %s not found in image_list plugin config...\n", path);
                 return 0;
             }
         }
 
-        new_node = grub_zalloc(sizeof(img_iterator_node));
+        /*
+         * .ventoyignore is found when the directory itself is read,
+         * only the directories in the image index are known in advance.
+         */
+        idxdir = ventoy_img_index_find(path, info);
+        if (idxdir && (idxdir->flag & VTOY_IMG_INDEX_DIR_IGNORE))
+        {
+            debug("Directory %s ignored...\n", path);
+            return 0;
+        }
+
+        /* the dir path is stored just after the node */
+        new_node = ventoy_arena_alloc(&g_node_arena, sizeof(img_iterator_node) + dirlen + 1);
         if (new_node)
         {
             new_node->level = node->level + 1;
             new_node->plugin_list_index = index;
-            new_node->dirlen = grub_snprintf(new_node->dir, sizeof(new_node->dir), "%s%s/", node->dir, filename);
+            new_node->idxdir = idxdir;
+            new_node->dir = (char *)(new_node + 1);
+            new_node->dirlen = dirlen;
+            grub_memcpy(new_node->dir, path, dirlen + 1);
 
-            g_enum_fs->fs_dir(g_enum_dev, new_node->dir, ventoy_check_ignore_flag, &ignore);
-            if (ignore)
+            new_node->tail = node->tail;
+            new_node->parent = node;
+
+            if (node->pendnodetail)
             {
-                debug("Directory %s ignored...\n", new_node->dir);
-                grub_free(new_node);
-                return 0;
-            }
-
-            new_node->tail = node->tail;
-
-            new_node->parent = node;
-            if (!node->firstchild)
-            {
-                node->firstchild = new_node;
-            }
-
-            if (g_img_iterator_tail)
-            {
-                g_img_iterator_tail->next = new_node;
-                g_img_iterator_tail = new_node;
+                node->pendnodetail->next = new_node;
             }
             else
             {
-                g_img_iterator_head.next = new_node;
-                g_img_iterator_tail = new_node;
+                node->pendnode = new_node;
             }
+            node->pendnodetail = new_node;
         }
     }
     else
     {
+        if (filename[0] == '.' && 0 == grub_strncmp(filename, ".ventoyignore", 13))
+        {
+            /* the search root is never ignored */
+            if (node != &g_img_iterator_head)
+            {
+                node->ignore = 1;
+                return 1;
+            }
+            return 0;
+        }
+
         debug("Find a file %s\n", filename);
         if (len < 4)
         {
@@ -2054,8 +2515,25 @@ static int ventoy_collect_img_files(const char *filename, const struct grub_dirh
         {
             if (filename[len - 9] == '.' || (len >= 10 && filename[len - 10] == '.'))
             {
-                grub_snprintf(g_img_swap_tmp_buf, sizeof(g_img_swap_tmp_buf), "%s%s", node->dir, filename);
-                ventoy_plugin_add_custom_boot(g_img_swap_tmp_buf);
+                /* the path is stored just after the entry */
+                vcfg = ventoy_arena_alloc(&g_node_arena, sizeof(img_pend_vcfg) + node->dirlen + len + 1);
+                if (vcfg)
+                {
+                    vcfg->next = NULL;
+                    vcfg->path = (char *)(vcfg + 1);
+                    grub_memcpy(vcfg->path, node->dir, node->dirlen);
+                    grub_memcpy(vcfg->path + node->dirlen, filename, len + 1);
+
+                    if (node->pendvcfgtail)
+                    {
+                        node->pendvcfgtail->next = vcfg;
+                    }
+                    else
+                    {
+                        node->pendvcfg = vcfg;
+                    }
+                    node->pendvcfgtail = vcfg;
+                }
             }
             return 0;
         }
@@ -2071,89 +2549,57 @@ static int ventoy_collect_img_files(const char *filename, const struct grub_dirh
 
         if (g_plugin_image_list)
         {
-            grub_snprintf(g_img_swap_tmp_buf, sizeof(g_img_swap_tmp_buf), "%s%s", node->dir, filename);
-            index = ventoy_plugin_get_image_list_index(vtoy_class_image_file, g_img_swap_tmp_buf);
+            path = ventoy_img_path_join(node->dir, node->dirlen, filename, len, 0);
+            if (!path)
+            {
+                return 0;
+            }
+
+            index = ventoy_plugin_get_image_list_index(vtoy_class_image_file, path);
             if (VENTOY_IMG_WHITE_LIST == g_plugin_image_list && index == 0)
             {
-                debug("File %s not found in image_list plugin config...\n", g_img_swap_tmp_buf);
+                debug("File %s not found in image_list plugin config...\n", path);
                 return 0;
             }
             else if (VENTOY_IMG_BLACK_LIST == g_plugin_image_list && index > 0)
             {
-                debug("File %s found in image_blacklist plugin config %d ...\n", g_img_swap_tmp_buf, index);
+                debug("File %s found in image_blacklist plugin config %d ...\n", path, index);
                 return 0;
             }
         }
 
-        if (info->size == VTOY_FILT_MIN_FILE_SIZE || info->size == 0)
+        /*
+         * All the fs drivers give the file size in dirhook info now.
+         * A vlnk (the size of its target) or a file without size is left with
+         * size 0 and opened only when the directory is attached, so nothing
+         * is opened in a directory that turns out to have .ventoyignore.
+         */
+        size = info->size;
+        if ((size == VTOY_FILT_MIN_FILE_SIZE || size == 0) && grub_file_is_vlnk_suffix(filename, len))
         {
-            if (grub_file_is_vlnk_suffix(filename, len))
-            {
-                vlnk = 1;
-                if (ventoy_add_vlnk_file(node->dir, filename) != 0)
-                {
-                    return 0;
-                }
-            }
+            size = 0;
+        }
+
+        if (size > 0 && size < VTOY_FILT_MIN_FILE_SIZE)
+        {
+            debug("img <%s> size too small %llu\n", filename, (ulonglong)size);
+            return 0;
         }
 
-        img = grub_zalloc(sizeof(img_info));
+        /* the full path is stored just after the img_info, name is the tail of it */
+        img = ventoy_arena_alloc(&g_img_arena, sizeof(img_info) + node->dirlen + len + 1);
         if (img)
         {
             img->type = type;
             img->plugin_list_index = index;
-            grub_snprintf(img->name, sizeof(img->name), "%s", filename);
-
-            img->pathlen = grub_snprintf(img->path, sizeof(img->path), "%s%s", node->dir, img->name);
-
-            img->size = info->size;
-            if (vlnk || 0 == img->size)
-            {
-                if (node->dir[0] == '/')
-                {
-                    img->size = ventoy_grub_get_file_size("%s%s%s", g_iso_path, node->dir, filename);
-                }
-                else
-                {
-                    img->size = ventoy_grub_get_file_size("%s/%s%s", g_iso_path, node->dir, filename);
-                }
-            }
-
-            if (img->size < VTOY_FILT_MIN_FILE_SIZE)
-            {
-                debug("img <%s> size too small %llu\n", img->name, (ulonglong)img->size);
-                grub_free(img);
-                return 0;
-            }
-
-            if (g_ventoy_img_list)
-            {
-                tail = *(node->tail);
-                img->prev = tail;
-                tail->next = img;
-            }
-            else
-            {
-                g_ventoy_img_list = img;
-            }
+            img->size = size;
 
-            img->id = g_ventoy_img_count;
+            img->path = (char *)(img + 1);
+            grub_memcpy(img->path, node->dir, node->dirlen);
+            grub_memcpy(img->path + node->dirlen, filename, len + 1);
+            img->pathlen = node->dirlen + (int)len;
+            img->name = img->path + node->dirlen;
             img->parent = node;
-            if (node && NULL == node->firstiso)
-            {
-                node->firstiso = img;
-            }
-
-            node->isocnt++;
-            tmp = node->parent;
-            while (tmp)
-            {
-                tmp->isocnt++;
-                tmp = tmp->parent;
-            }
-
-            *((img_info **)(node->tail)) = img;
-            g_ventoy_img_count++;
 
             img->alias = ventoy_plugin_get_menu_alias(vtoy_alias_image_file, img->path);
 
@@ -2186,13 +2632,146 @@ static int ventoy_collect_img_files(const char *filename, const struct grub_dirh
                 }
             }
 
-            debug("Add %s%s to list %d\n", node->dir, filename, g_ventoy_img_count);
+            if (node->pendimgtail)
+            {
+                node->pendimgtail->next = img;
+            }
+            else
+            {
+                node->pendimg = img;
+            }
+            node->pendimgtail = img;
         }
     }
 
     return 0;
 }
 
+static int ventoy_get_pending_img_size(img_iterator_node *node, img_info *img)
+{
+    grub_size_t len = (grub_size_t)(img->pathlen - node->dirlen);
+    grub_uint64_t size = 0;
+
+    if (grub_file_is_vlnk_suffix(img->name, len))
+    {
+        if (ventoy_add_vlnk_file(node->dir, img->name, &size) != 0)
+        {
+            return 1;
+        }
+    }
+
+    if (0 == size)
+    {
+        if (node->dir[0] == '/')
+        {
+            size = ventoy_grub_get_file_size("%s%s", g_iso_path, img->path);
+        }
+        else
+        {
+            size = ventoy_grub_get_file_size("%s/%s", g_iso_path, img->path);
+        }
+    }
+
+    if (size < VTOY_FILT_MIN_FILE_SIZE)
+    {
+        debug("img <%s> size too small %llu\n", img->name, (ulonglong)size);
+        return 1;
+    }
+
+    img->size = size;
+    return 0;
+}
+
+static void ventoy_attach_dir_entries(img_iterator_node *node)
+{
+    img_info *img = NULL;
+    img_info *next = NULL;
+    img_info *tail = NULL;
+    img_pend_vcfg *vcfg = NULL;
+    img_iterator_node *tmp = NULL;
+    img_iterator_node *child = NULL;
+    img_iterator_node *nextchild = NULL;
+
+    if (node->ignore)
+    {
+        debug("Directory %s ignored...\n", node->dir);
+        goto end;
+    }
+
+    for (vcfg = node->pendvcfg; vcfg; vcfg = vcfg->next)
+    {
+        ventoy_plugin_add_custom_boot(vcfg->path);
+    }
+
+    for (child = node->pendnode; child; child = nextchild)
+    {
+        nextchild = child->next;
+        child->next = NULL;
+
+        if (!node->firstchild)
+        {
+            node->firstchild = child;
+        }
+
+        if (g_img_iterator_tail)
+        {
+            g_img_iterator_tail->next = child;
+            g_img_iterator_tail = child;
+        }
+        else
+        {
+            g_img_iterator_head.next = child;
+            g_img_iterator_tail = child;
+        }
+    }
+
+    for (img = node->pendimg; img; img = next)
+    {
+        next = img->next;
+        img->next = NULL;
+
+        if (img->size == 0 && ventoy_get_pending_img_size(node, img) != 0)
+        {
+            continue;
+        }
+
+        if (g_ventoy_img_list)
+        {
+            tail = *(node->tail);
+            img->prev = tail;
+            tail->next = img;
+        }
+        else
+        {
+            g_ventoy_img_list = img;
+        }
+
+        img->id = g_ventoy_img_count;
+        if (NULL == node->firstiso)
+        {
+            node->firstiso = img;
+        }
+
+        node->isocnt++;
+        tmp = node->parent;
+        while (tmp)
+        {
+            tmp->isocnt++;
+            tmp = tmp->parent;
+        }
+
+        *((img_info **)(node->tail)) = img;
+        g_ventoy_img_count++;
+
+        debug("Add %s to list %d\n", img->path, g_ventoy_img_count);
+    }
+
+end:
+    node->pendnode = node->pendnodetail = NULL;
+    node->pendimg = node->pendimgtail = NULL;
+    node->pendvcfg = node->pendvcfgtail = NULL;
+}
+
 int ventoy_fill_data(grub_uint32_t buflen, char *buffer)
 {
     int len = GRUB_UINT_MAX;
@@ -2382,54 +2961,172 @@ int ventoy_check_password(const vtoy_password *pwd, int retry)
     return 1;
 }
 
-static img_info * ventoy_get_min_iso(img_iterator_node *node)
+static img_info ** ventoy_get_sorted_iso(img_iterator_node *node, int *num)
 {
-    img_info *minimg = NULL;
-    img_info *img = (img_info *)(node->firstiso);
+    int i = 0;
+    int cnt = 0;
+    img_info **array = NULL;
+    img_info *img = NULL;
 
-    while (img && (img_iterator_node *)(img->parent) == node)
+    for (img = (img_info *)(node->firstiso); img && (img_iterator_node *)(img->parent) == node; img = img->next)
     {
-        if (img->select == 0 && (NULL == minimg || ventoy_cmp_img(img, minimg) < 0))
-        {
-            minimg = img;
-        }
-        img = img->next;
+        cnt++;
     }
 
-    if (minimg)
+    *num = cnt;
+    if (cnt == 0)
     {
-        minimg->select = 1;
+        return NULL;
     }
 
-    return minimg;
+    array = grub_malloc(cnt * sizeof(img_info *));
+    if (!array)
+    {
+        /* caller will follow the list in enumeration order */
+        return NULL;
+    }
+
+    for (img = (img_info *)(node->firstiso); i < cnt; img = img->next)
+    {
+        array[i++] = img;
+    }
+
+    ventoy_sort_ptr_array((void **)array, cnt, ventoy_sort_cmp_img);
+    return array;
+}
+
+static img_iterator_node ** ventoy_get_sorted_child(img_iterator_node *node, int *num)
+{
+    int i = 0;
+    int cnt = 0;
+    img_iterator_node **array = NULL;
+    img_iterator_node *child = NULL;
+
+    for (child = node->firstchild; child && child->parent == node; child = child->next)
+    {
+        cnt++;
+    }
+
+    *num = cnt;
+    if (cnt == 0)
+    {
+        return NULL;
+    }
+
+    array = grub_malloc(cnt * sizeof(img_iterator_node *));
+    if (!array)
+    {
+        /* caller will follow the list in enumeration order */
+        return NULL;
+    }
+
+    for (child = node->firstchild; i < cnt; child = child->next)
+    {
+        array[i++] = child;
+    }
+
+    ventoy_sort_ptr_array((void **)array, cnt, ventoy_sort_cmp_subdir);
+    return array;
 }
 
-static img_iterator_node * ventoy_get_min_child(img_iterator_node *node)
+static void ventoy_free_tree_menu_dir(void)
 {
-    img_iterator_node *Minchild = NULL;
-    img_iterator_node *child = node->firstchild;
+    int i;
+
+    for (i = 0; i < g_tree_menu_dir_num; i++)
+    {
+        grub_check_free(g_tree_menu_dir[i].title);
+        grub_check_free(g_tree_menu_dir[i].id);
+    }
+
+    grub_check_free(g_tree_menu_dir);
+    g_tree_menu_dir_num = 0;
+    g_tree_menu_dir_max = 0;
+    g_tree_menu_dir_fail = 0;
+}
+
+/* title is always taken over (or freed) here */
+static int ventoy_add_tree_menu_dir(char *title, const char *dir, const char *class, const void *tip, int bodyoff)
+{
+    tree_menu_dir *newdir = NULL;
+    tree_menu_dir *node = NULL;
+
+    if (g_tree_menu_dir_fail || g_tree_script_pos >= VTOY_MAX_SCRIPT_BUF)
+    {
+        goto fail;
+    }
 
-    while (child && child->parent == node)
+    if (g_tree_menu_dir_num >= g_tree_menu_dir_max)
     {
-        if (child->select == 0 && (NULL == Minchild || ventoy_cmp_subdir(child, Minchild) < 0))
+        newdir = grub_realloc(g_tree_menu_dir, (g_tree_menu_dir_max + 64) * sizeof(tree_menu_dir));
+        if (!newdir)
         {
-            Minchild = child;
+            goto fail;
         }
-        child = child->next;
+
+        g_tree_menu_dir = newdir;
+        g_tree_menu_dir_max += 64;
     }
 
-    if (Minchild)
+    node = g_tree_menu_dir + g_tree_menu_dir_num;
+    node->id = grub_xasprintf("DIR_%s", dir);
+    if (!node->id)
     {
-        Minchild->select = 1;
+        goto fail;
     }
 
-    return Minchild;
+    node->title = title;
+    node->class = class;
+    node->tip = tip;
+    node->bodyoff = bodyoff;
+    node->bodylen = g_tree_script_pos - bodyoff;
+    g_tree_menu_dir_num++;
+    return 0;
+
+fail:
+    debug("failed to record tree menu dir <%s>, fallback to script\n", dir);
+    g_tree_menu_dir_fail = 1;
+    grub_free(title);
+    return 1;
+}
+
+static char * ventoy_tree_dir_title(const char *alias, const char *dir)
+{
+    if (alias)
+    {
+        if (g_tree_view_menu_style == 0)
+        {
+            return grub_xasprintf("%-10s %s", "DIR", alias);
+        }
+        else
+        {
+            return grub_xasprintf("%s", alias);
+        }
+    }
+    else
+    {
+        if (g_tree_view_menu_style == 0)
+        {
+            return grub_xasprintf("%-10s [%s]", "DIR", dir);
+        }
+        else
+        {
+            return grub_xasprintf("[%s]", dir);
+        }
+    }
 }
 
 static int ventoy_dynamic_tree_menu(img_iterator_node *node)
 {
+    int i = 0;
+    int num = 0;
     int offset = 1;
+    int bodyoff = 0;
+    char *title = NULL;
     img_info *img = NULL;
+    img_info *cur = NULL;
+    img_info **imgs = NULL;
+    img_iterator_node **childs = NULL;
     const char *dir_class = NULL;
     const char *dir_alias = NULL;
     img_iterator_node *child = NULL;
@@ -2479,38 +3176,18 @@ static int ventoy_dynamic_tree_menu(img_iterator_node *node)
         tip = ventoy_plugin_get_menu_tip(vtoy_tip_directory, node->dir);
 
         dir_alias = ventoy_plugin_get_menu_alias(vtoy_alias_directory, node->dir);
-        if (dir_alias)
+        title = ventoy_tree_dir_title(dir_alias, node->dir + offset);
+        if (!title)
         {
-            if (g_tree_view_menu_style == 0)
-            {
-                vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
-                              "submenu \"%-10s %s\" --class=\"%s\" --id=\"DIR_%s\" _VTIP_%p {\n",
-                              "DIR", dir_alias, dir_class, node->dir + offset, tip);
-            }
-            else
-            {
-                vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
-                              "submenu \"%s\" --class=\"%s\" --id=\"DIR_%s\" _VTIP_%p {\n",
-                              dir_alias, dir_class, node->dir + offset, tip);
-            }
+            node->dir[node->dirlen - 1] = '/';
+            g_tree_menu_dir_fail = 1;
+            return 1;
         }
-        else
-        {
-            dir_alias = node->dir + offset;
 
-            if (g_tree_view_menu_style == 0)
-            {
-                vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
-                              "submenu \"%-10s [%s]\" --class=\"%s\" --id=\"DIR_%s\" _VTIP_%p {\n",
-                              "DIR", dir_alias, dir_class, node->dir + offset, tip);
-            }
-            else
-            {
-                vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
-                              "submenu \"[%s]\" --class=\"%s\" --id=\"DIR_%s\" _VTIP_%p {\n",
-                              dir_alias, dir_class, node->dir + offset, tip);
-            }
-        }
+        vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
+                      "submenu \"%s\" --class=\"%s\" --id=\"DIR_%s\" _VTIP_%p {\n",
+                      title, dir_class, node->dir + offset, tip);
+        bodyoff = g_tree_script_pos;
 
         if (g_tree_view_menu_style == 0)
         {
@@ -2528,24 +3205,48 @@ static int ventoy_dynamic_tree_menu(img_iterator_node *node)
         }
     }
 
-    while ((child = ventoy_get_min_child(node)) != NULL)
+    childs = ventoy_get_sorted_child(node, &num);
+    for (i = 0, child = node->firstchild; i < num; i++, child = child->next)
+    {
+        ventoy_dynamic_tree_menu(childs ? childs[i] : child);
+    }
+    grub_check_free(childs);
+
+    if (g_tree_menu_lazy)
+    {
+        /* image list is already sorted and the node's iso chain is broken */
+        imgs = node->menuimgs;
+        num = node->menuimgnum;
+    }
+    else
     {
-        ventoy_dynamic_tree_menu(child);
+        imgs = ventoy_get_sorted_iso(node, &num);
     }
 
-    while ((img = ventoy_get_min_iso(node)) != NULL)
+    for (i = 0, img = (img_info *)(node->firstiso); i < num; i++)
     {
+        /* only follow the iso chain when there is no array (never in lazy mode) */
+        if (imgs)
+        {
+            cur = imgs[i];
+        }
+        else
+        {
+            cur = img;
+            img = img->next;
+        }
+
         if (g_tree_view_menu_style == 0)
         {
             vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos,
                           "menuentry \"%-10s %s%s\" --class=\"%s\" --id=\"VID_%p\" {\n"
                           "  %s_%s \n"
                           "}\n",
-                          grub_get_human_size(img->size, GRUB_HUMAN_SIZE_SHORT),
-                          img->unsupport ? "[***********] " : "",
-                          img->alias ? img->alias : img->name, img->class, img,
-                          img->menu_prefix,
-                          img->unsupport ? "unsupport_menuentry" : "common_menuentry");
+                          grub_get_human_size(cur->size, GRUB_HUMAN_SIZE_SHORT),
+                          cur->unsupport ? "[***********] " : "",
+                          cur->alias ? cur->alias : cur->name, cur->class, cur,
+                          cur->menu_prefix,
+                          cur->unsupport ? "unsupport_menuentry" : "common_menuentry");
         }
         else
         {
@@ -2553,25 +3254,154 @@ static int ventoy_dynamic_tree_menu(img_iterator_node *node)
                           "menuentry \"%s%s\" --class=\"%s\" --id=\"VID_%p\" {\n"
                           "  %s_%s \n"
                           "}\n",
-                          img->unsupport ? "[***********] " : "",
-                          img->alias ? img->alias : img->name, img->class, img,
-                          img->menu_prefix,
-                          img->unsupport ? "unsupport_menuentry" : "common_menuentry");
+                          cur->unsupport ? "[***********] " : "",
+                          cur->alias ? cur->alias : cur->name, cur->class, cur,
+                          cur->menu_prefix,
+                          cur->unsupport ? "unsupport_menuentry" : "common_menuentry");
         }
     }
 
+    if (!g_tree_menu_lazy)
+    {
+        grub_check_free(imgs);
+    }
+
     if (node != &g_img_iterator_head)
     {
+        if (node->parent == &g_img_iterator_head)
+        {
+            ventoy_add_tree_menu_dir(title, node->dir + offset, dir_class, tip, bodyoff);
+            title = NULL;
+        }
+
         vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "}\n");
+        node->dir[node->dirlen - 1] = '/';
     }
 
+    grub_check_free(title);
     node->done = 1;
     return 0;
 }
 
+static int ventoy_native_menu_enabled(void)
+{
+    const char *strdata = NULL;
+
+    strdata = ventoy_get_env("VTOY_NATIVE_MENU");
+    if (strdata && strdata[0] == '0' && strdata[1] == 0)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+static int ventoy_lazy_tree_menu_enabled(void)
+{
+    const char *strdata = NULL;
+
+    /* the lazy submenu is built with native menu entries */
+    if (ventoy_native_menu_enabled() == 0)
+    {
+        return 0;
+    }
+
+    strdata = ventoy_get_env("VTOY_LAZY_TREE_MENU");
+    if (strdata && strdata[0] == '0' && strdata[1] == 0)
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+int ventoy_tree_script_ensure(void)
+{
+    img_iterator_node *node = NULL;
+
+    if (g_tree_script_done)
+    {
+        return 0;
+    }
+
+    for (node = &g_img_iterator_head; node; node = node->next)
+    {
+        ventoy_dynamic_tree_menu(node);
+    }
+
+    g_tree_script_buf[g_tree_script_pos] = 0;
+    g_tree_script_done = 1;
+    return 0;
+}
+
+static void ventoy_free_img_iterator_node(void)
+{
+    int i;
+    img_iterator_node *node = NULL;
+    img_iterator_node *next = NULL;
+
+    for (node = &g_img_iterator_head; node; node = next)
+    {
+        next = node->next;
+
+        for (i = 0; i < node->menudirnum; i++)
+        {
+            grub_check_free(node->menudirs[i].title);
+            grub_check_free(node->menudirs[i].id);
+        }
+        grub_check_free(node->menudirs);
+    }
+
+    /* all the nodes (except the head) and dir paths are in the arena */
+    ventoy_arena_free(&g_node_arena);
+
+    g_img_iterator_head.dir = NULL;
+    g_img_iterator_head.next = NULL;
+    g_img_iterator_head.menudone = 0;
+    g_img_iterator_head.menudirnum = 0;
+    g_img_iterator_head.menuimgnum = 0;
+    g_img_iterator_head.menuindex = 0;
+    g_img_iterator_head.menuimgs = NULL;
+    g_img_iterator_tail = NULL;
+
+    grub_check_free(g_tree_menu_imgs);
+    g_tree_menu_lazy = 0;
+}
+
+/* split the sorted image list by directory, keep the sorted order */
+static void ventoy_group_tree_menu_imgs(void)
+{
+    int pos = 0;
+    int index = 0;
+    img_info *cur = NULL;
+    img_iterator_node *node = NULL;
+
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        node = (img_iterator_node *)(cur->parent);
+        node->menuimgnum++;
+    }
+
+    for (node = &g_img_iterator_head; node; node = node->next)
+    {
+        node->menuindex = index++;
+        node->menuimgs = g_tree_menu_imgs + pos;
+        pos += node->menuimgnum;
+        node->menuimgnum = 0;
+    }
+
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        node = (img_iterator_node *)(cur->parent);
+        node->menuimgs[node->menuimgnum++] = cur;
+    }
+}
+
 static int ventoy_set_default_menu(void)
 {
     int img_len = 0;
+    int id_len = 0;
+    int id_pos = 0;
     char *pos = NULL;
     char *end = NULL;
     char *def = NULL;
@@ -2599,20 +3429,31 @@ static int ventoy_set_default_menu(void)
             return 1;
         }
 
+        grub_check_free(g_default_menu_id);
+
         if (0 == g_default_menu_mode)
         {
-            vtoy_ssprintf(g_list_script_buf, g_list_script_pos, "set default='VID_%p'\n", default_node);
+            g_default_menu_id = grub_xasprintf("VID_%p", default_node);
+            if (!g_default_menu_id)
+            {
+                return 1;
+            }
+
+            vtoy_ssprintf(g_list_script_buf, g_list_script_pos, "set default='%s'\n", g_default_menu_id);
         }
         else
         {
+            /* every '/' becomes "DIR_" + ">" in the worst case */
+            id_len = img_len * 5 + 32;
             def = grub_strdup(default_image);
-            if (!def)
+            g_default_menu_id = grub_malloc(id_len);
+            if (!def || !g_default_menu_id)
             {
+                grub_check_free(def);
+                grub_check_free(g_default_menu_id);
                 return 1;
             }
 
-            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "set default=%c", '\'');
-
             strdata = ventoy_get_env("VTOY_DEFAULT_SEARCH_ROOT");
             if (strdata && strdata[0] == '/')
             {
@@ -2630,11 +3471,12 @@ static int ventoy_set_default_menu(void)
             while ((end = grub_strchr(pos, '/')) != NULL)
             {
                 *end = 0;
-                vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "DIR_%s>", pos);
+                vtoy_len_ssprintf(g_default_menu_id, id_pos, id_len, "DIR_%s>", pos);
                 pos = end + 1;
             }
 
-            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "VID_%p'\n", default_node);
+            vtoy_len_ssprintf(g_default_menu_id, id_pos, id_len, "VID_%p", default_node);
+            vtoy_ssprintf(g_tree_script_buf, g_tree_script_pos, "set default='%s'\n", g_default_menu_id);
             grub_free(def);
         }
     }
@@ -2644,23 +3486,19 @@ static int ventoy_set_default_menu(void)
 
 static grub_err_t ventoy_cmd_clear_img(grub_extcmd_context_t ctxt, int argc, char **args)
 {
-    img_info *next = NULL;
-    img_info *cur = g_ventoy_img_list;
-
     (void)ctxt;
     (void)argc;
     (void)args;
 
-    while (cur)
-    {
-        next = cur->next;
-        grub_free(cur);
-        cur = next;
-    }
+    debug("free image list, count:%d arena:%lu\n", g_ventoy_img_count, (ulong)g_img_arena.total);
+    ventoy_arena_free(&g_img_arena);
 
     g_ventoy_img_list = NULL;
     g_ventoy_img_count = 0;
 
+    /* lazy tree view keeps the directory nodes until here */
+    ventoy_free_img_iterator_node();
+
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
@@ -2852,18 +3690,18 @@ end:
 
 static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char **args)
 {
+    int i;
+    int j;
     int len;
     grub_fs_t fs;
     grub_device_t dev = NULL;
     img_info *cur = NULL;
     img_info *tail = NULL;
-    img_info *min = NULL;
-    img_info *head = NULL;
+    img_info **array = NULL;
     const char *strdata = NULL;
     char *device_name = NULL;
     char buf[32];
     img_iterator_node *node = NULL;
-    img_iterator_node *tmp = NULL;
 
     (void)ctxt;
 
@@ -2879,6 +3717,12 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
 
     VTOY_CMD_CHECK(1);
 
+    ventoy_perf_begin(vtoy_perf_list_img);
+
+    ventoy_free_tree_menu_dir();
+    ventoy_free_img_iterator_node();
+    g_tree_script_done = 0;
+
     g_enumerate_time_checked  = 0;
     g_enumerate_start_time_ms = grub_get_time_ms();
 
@@ -2940,7 +3784,14 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
     strdata = ventoy_get_env("VTOY_DEFAULT_SEARCH_ROOT");
     if (strdata && strdata[0] == '/')
     {
-        len = grub_snprintf(g_img_iterator_head.dir, sizeof(g_img_iterator_head.dir) - 1, "%s", strdata);
+        len = (int)grub_strlen(strdata);
+        g_img_iterator_head.dir = ventoy_arena_alloc(&g_node_arena, len + 2);
+        if (!g_img_iterator_head.dir)
+        {
+            goto fail;
+        }
+
+        grub_memcpy(g_img_iterator_head.dir, strdata, len);
         if (g_img_iterator_head.dir[len - 1] != '/')
         {
             g_img_iterator_head.dir[len++] = '/';
@@ -2949,6 +3800,12 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
     }
     else
     {
+        g_img_iterator_head.dir = ventoy_arena_alloc(&g_node_arena, 2);
+        if (!g_img_iterator_head.dir)
+        {
+            goto fail;
+        }
+
         g_img_iterator_head.dirlen = 1;
         grub_strcpy(g_img_iterator_head.dir, "/");
     }
@@ -2972,11 +3829,31 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
     g_vtoy_file_flt[VTOY_FILE_FLT_VHD]  = ventoy_control_get_flag("VTOY_FILE_FLT_VHD");
     g_vtoy_file_flt[VTOY_FILE_FLT_VTOY] = ventoy_control_get_flag("VTOY_FILE_FLT_VTOY");
 
+    strdata = ventoy_get_env("VTOY_IMG_INDEX");
+    if (!(strdata && strdata[0] == '0' && strdata[1] == 0))
+    {
+        ventoy_img_index_load(args[0]);
+    }
+
     for (node = &g_img_iterator_head; node; node = node->next)
     {
-        fs->fs_dir(dev, node->dir, ventoy_collect_img_files, node);
+        if (node->idxdir)
+        {
+            ventoy_img_index_iterate(node->idxdir, ventoy_collect_img_files, node);
+        }
+        else
+        {
+            ventoy_perf_add(vtoy_perf_cnt_dir, 1);
+            fs->fs_dir(dev, node->dir, ventoy_collect_img_files, node);
+        }
+
+        ventoy_attach_dir_entries(node);
     }
 
+    ventoy_img_index_free();
+    grub_check_free(g_img_path_buf);
+    g_img_path_buf_size = 0;
+
     strdata = ventoy_get_env("VTOY_TREE_VIEW_MENU_STYLE");
     if (strdata && strdata[0] == '1' && strdata[1] == 0)
     {
@@ -2985,63 +3862,60 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
 
     ventoy_set_default_menu();
 
-    for (node = &g_img_iterator_head; node; node = node->next)
-    {
-        ventoy_dynamic_tree_menu(node);
-    }
-
-    /* free node */
-    node = g_img_iterator_head.next;
-    while (node)
-    {
-        tmp = node->next;
-        grub_free(node);
-        node = tmp;
-    }
-
-    /* sort image list by image name */
-    while (g_ventoy_img_list)
-    {
-        min = g_ventoy_img_list;
-        for (cur = g_ventoy_img_list->next; cur; cur = cur->next)
-        {
-            if (ventoy_cmp_img(min, cur) > 0)
-            {
-                min = cur;
-            }
-        }
-
-        if (min->prev)
-        {
-            min->prev->next = min->next;
-        }
-
-        if (min->next)
-        {
-            min->next->prev = min->prev;
-        }
-
-        if (min == g_ventoy_img_list)
+    /*
+     * Lazy tree view: only the top level is built at boot, the directory nodes
+     * are kept and a submenu is built when it is first opened.
+     * The whole tree script is generated only when F3/browser really need it.
+     */
+    if (ventoy_lazy_tree_menu_enabled() && g_ventoy_img_count > 0)
+    {
+        g_tree_menu_imgs = grub_malloc(g_ventoy_img_count * sizeof(img_info *));
+        if (g_tree_menu_imgs)
         {
-            g_ventoy_img_list = min->next;
+            g_tree_menu_lazy = 1;
         }
+    }
 
-        if (head == NULL)
+    if (g_tree_menu_lazy == 0)
+    {
+        ventoy_tree_script_ensure();
+        ventoy_free_img_iterator_node();
+    }
+
+    /* sort image list by image name */
+    if (g_ventoy_img_count > 1)
+    {
+        array = grub_malloc(g_ventoy_img_count * sizeof(img_info *));
+        if (array)
         {
-            head = tail = min;
-            min->prev = NULL;
-            min->next = NULL;
+            i = 0;
+            for (cur = g_ventoy_img_list; cur && i < g_ventoy_img_count; cur = cur->next)
+            {
+                array[i++] = cur;
+            }
+
+            ventoy_sort_ptr_array((void **)array, i, ventoy_sort_cmp_img);
+
+            for (j = 0; j < i; j++)
+            {
+                array[j]->prev = (j > 0) ? array[j - 1] : NULL;
+                array[j]->next = (j + 1 < i) ? array[j + 1] : NULL;
+            }
+
+            g_ventoy_img_list = array[0];
+            grub_free(array);
         }
         else
         {
-            tail->next = min;
-            min->prev = tail;
-            min->next = NULL;
-            tail = min;
+            debug("Failed to alloc sort array %d, sort in list\n", g_ventoy_img_count);
+            ventoy_select_sort_img_list();
         }
     }
 
-    g_ventoy_img_list = head;
+    if (g_tree_menu_lazy)
+    {
+        ventoy_group_tree_menu_imgs();
+    }
 
     if (g_default_menu_mode == 1)
     {
@@ -3069,8 +3943,11 @@ static grub_err_t ventoy_cmd_list_img(grub_extcmd_context_t ctxt, int argc, char
     grub_snprintf(buf, sizeof(buf), "%d", g_ventoy_img_count);
     grub_env_set(args[1], buf);
 
+    ventoy_perf_add(vtoy_perf_cnt_image, g_ventoy_img_count);
+
 fail:
 
+    ventoy_perf_end(vtoy_perf_list_img);
     check_free(device_name, grub_free);
     check_free(dev, grub_device_close);
 
@@ -3304,6 +4181,44 @@ void ventoy_fill_os_param(grub_file_t file, ventoy_os_param *param)
     return;
 }
 
+/* VTOY_UEFI_CACHE_SIZE in MB, 0 to disable the read cache of Ventoy.efi */
+grub_uint32_t ventoy_get_uefi_cache_size(void)
+{
+    grub_uint32_t size = VTOY_UEFI_CACHE_DEF_MB;
+    const char *val = NULL;
+
+    val = ventoy_get_env("VTOY_UEFI_CACHE_SIZE");
+    if (val && ventoy_is_decimal(val))
+    {
+        size = (grub_uint32_t)grub_strtoul(val, NULL, 10);
+        if (size > VTOY_UEFI_CACHE_MAX_MB)
+        {
+            size = VTOY_UEFI_CACHE_MAX_MB;
+        }
+    }
+
+    return size * 1024;
+}
+
+/* VTOY_UEFI_IO_TRACE in K entries, the I/O trace of Ventoy.efi is disabled by default */
+grub_uint32_t ventoy_get_uefi_io_trace_num(void)
+{
+    grub_uint32_t num = 0;
+    const char *val = NULL;
+
+    val = ventoy_get_env("VTOY_UEFI_IO_TRACE");
+    if (val && ventoy_is_decimal(val))
+    {
+        num = (grub_uint32_t)grub_strtoul(val, NULL, 10);
+        if (num > VTOY_UEFI_IO_TRACE_MAX_K)
+        {
+            num = VTOY_UEFI_IO_TRACE_MAX_K;
+        }
+    }
+
+    return num * 1024;
+}
+
 static const char* g_chunk_err_msg[VTOY_CHUNK_ERR_MAX] =
 {
     "success",
@@ -3387,6 +4302,8 @@ int ventoy_get_block_list(grub_file_t file, ventoy_img_chunk_list *chunklist, gr
     grub_off_t size = 0;
     grub_off_t read = 0;
 
+    ventoy_perf_begin(vtoy_perf_block_list);
+
     fs_type = ventoy_get_fs_type(file->fs->name);
     if (fs_type == ventoy_fs_exfat)
     {
@@ -3400,8 +4317,23 @@ int ventoy_get_block_list(grub_file_t file, ventoy_img_chunk_list *chunklist, gr
     {
         grub_btrfs_get_file_chunk(start, file, chunklist);
     }
+    else if (fs_type == ventoy_fs_ntfs && grub_ntfs_get_file_chunk(start, file, chunklist) == 0)
+    {
+        debug("ntfs runlist chunk %u\n", chunklist->cur_chunk);
+    }
+    else if (fs_type == ventoy_fs_xfs && grub_xfs_get_file_chunk(start, file, chunklist) == 0)
+    {
+        debug("xfs extent chunk %u\n", chunklist->cur_chunk);
+    }
     else
     {
+        if (fs_type == ventoy_fs_ntfs || fs_type == ventoy_fs_xfs)
+        {
+            debug("native block map not supported, read file for block list\n");
+            grub_errno = GRUB_ERR_NONE;
+            chunklist->cur_chunk = 0;
+        }
+
         file->read_hook = (grub_disk_read_hook_t)(void *)grub_disk_blocklist_read;
         file->read_hook_data = chunklist;
 
@@ -3453,6 +4385,8 @@ int ventoy_get_block_list(grub_file_t file, ventoy_img_chunk_list *chunklist, gr
         }
     }
 
+    ventoy_perf_add(vtoy_perf_cnt_chunk, chunklist->cur_chunk);
+    ventoy_perf_end(vtoy_perf_block_list);
     return 0;
 }
 
@@ -3502,9 +4436,7 @@ static grub_err_t ventoy_cmd_img_sector(grub_extcmd_context_t ctxt, int argc, ch
 
     start = file->device->disk->partition->start;
 
-    ventoy_get_block_list(file, &g_img_chunk_list, start);
-
-    rc = ventoy_check_block_list(file, &g_img_chunk_list, start, errmsg, sizeof(errmsg));
+    rc = ventoy_get_block_list_cached(file, &g_img_chunk_list, start, errmsg, sizeof(errmsg));
     grub_file_close(file);
 
     if (rc)
@@ -4163,6 +5095,7 @@ static grub_err_t ventoy_cmd_dump_menu(grub_extcmd_context_t ctxt, int argc, cha
     }
     else
     {
+        ventoy_tree_script_ensure();
         grub_printf("Tree Mode: CurLen:%d  MaxLen:%u\n", g_tree_script_pos, VTOY_MAX_SCRIPT_BUF);
         grub_printf("%s", g_tree_script_buf);
     }
@@ -4326,6 +5259,305 @@ static grub_err_t ventoy_cmd_check_mode(grub_extcmd_context_t ctxt, int argc, ch
     return 1;
 }
 
+/*
+ * The menu entries are added to the menu directly here, the same as the
+ * menuentry/submenu commands in the list/tree script buffer would do.
+ * This avoids lexing and parsing the whole (maybe several MB) script,
+ * which is the main cost of showing the menu when there are many images.
+ * The script buffer is still generated for F3 (configfile) mode and as the
+ * fallback when VTOY_NATIVE_MENU=0 is set.
+ */
+static int ventoy_native_menu_entry
+(
+    const char *title,
+    const char *arg,
+    const char *class,
+    const char *id,
+    const char *body,
+    int submenu
+)
+{
+    int argc = 1;
+    const char *args[3] = { title, arg, NULL };
+    char *classes[2] = { (char *)class, NULL };
+
+    if (arg)
+    {
+        argc = 2;
+    }
+
+    if (grub_normal_add_menu_entry(argc, args, classes, id, "", NULL, NULL, body, submenu, NULL, NULL))
+    {
+        debug("failed to add menu entry <%s> %d\n", title, grub_errno);
+        grub_errno = GRUB_ERR_NONE;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int ventoy_native_img_entry(img_info *img, int treeview)
+{
+    char id[32];
+    char body[64];
+    char title[1024];
+
+    if (treeview && g_tree_view_menu_style == 0)
+    {
+        grub_snprintf(title, sizeof(title), "%-10s %s%s",
+                      grub_get_human_size(img->size, GRUB_HUMAN_SIZE_SHORT),
+                      img->unsupport ? "[***********] " : "",
+                      img->alias ? img->alias : img->name);
+    }
+    else
+    {
+        grub_snprintf(title, sizeof(title), "%s%s",
+                      img->unsupport ? "[***********] " : "",
+                      img->alias ? img->alias : img->name);
+    }
+
+    /* all the images of the same type share the same body */
+    grub_snprintf(body, sizeof(body), "  %s_%s \n", img->menu_prefix,
+                  img->unsupport ? "unsupport_menuentry" : "common_menuentry");
+    grub_snprintf(id, sizeof(id), "VID_%p", img);
+
+    return ventoy_native_menu_entry(title, NULL, img->class, id, body, 0);
+}
+
+static int ventoy_native_list_menu(void)
+{
+    char title[256];
+    img_info *cur = NULL;
+
+    if (g_default_menu_mode == 0 && g_default_menu_id)
+    {
+        grub_env_set("default", g_default_menu_id);
+    }
+
+    if (g_default_menu_mode == 1)
+    {
+        grub_snprintf(title, sizeof(title), "%s [%s]", "<--", ventoy_get_vmenu_title("VTLANG_RET_TO_TREEVIEW"));
+        ventoy_native_menu_entry(title, "VTOY_RET", "vtoyret", NULL, "  echo 'return ...' \n", 0);
+    }
+
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        if (ventoy_native_img_entry(cur, 0))
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void ventoy_native_tree_head(void)
+{
+    char title[256];
+
+    if (g_default_menu_mode == 1 && g_default_menu_id)
+    {
+        grub_env_set("default", g_default_menu_id);
+    }
+
+    if (g_default_menu_mode == 0)
+    {
+        if (g_tree_view_menu_style == 0)
+        {
+            grub_snprintf(title, sizeof(title), "%-10s [%s]", "<--", ventoy_get_vmenu_title("VTLANG_RET_TO_LISTVIEW"));
+        }
+        else
+        {
+            grub_snprintf(title, sizeof(title), "[%s]", ventoy_get_vmenu_title("VTLANG_RET_TO_LISTVIEW"));
+        }
+        ventoy_native_menu_entry(title, "VTOY_RET", "vtoyret", NULL, "  echo 'return ...' \n", 0);
+    }
+}
+
+static int ventoy_native_tree_menu(void)
+{
+    int i;
+    char ch;
+    char *end = NULL;
+    char tip[64];
+    img_info *cur = NULL;
+    tree_menu_dir *dir = NULL;
+
+    if (g_tree_menu_dir_fail || g_tree_script_pos >= VTOY_MAX_SCRIPT_BUF)
+    {
+        return 1;
+    }
+
+    ventoy_native_tree_head();
+
+    /* the submenu body is still script, it is only parsed when the submenu is opened */
+    for (i = 0; i < g_tree_menu_dir_num; i++)
+    {
+        dir = g_tree_menu_dir + i;
+        grub_snprintf(tip, sizeof(tip), "_VTIP_%p", dir->tip);
+
+        end = g_tree_script_buf + dir->bodyoff + dir->bodylen;
+        ch = *end;
+        *end = 0;
+        ventoy_native_menu_entry(dir->title, tip, dir->class, dir->id, g_tree_script_buf + dir->bodyoff, 1);
+        *end = ch;
+    }
+
+    /* g_ventoy_img_list is sorted the same as the tree view, so keep the order */
+    for (cur = g_ventoy_img_list; cur; cur = cur->next)
+    {
+        if (cur->parent == &g_img_iterator_head && ventoy_native_img_entry(cur, 1))
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* resolve alias/tip/class of the sub directories only once */
+static int ventoy_lazy_tree_resolve(img_iterator_node *node)
+{
+    int i = 0;
+    int num = 0;
+    const char *alias = NULL;
+    img_iterator_node *cur = NULL;
+    img_iterator_node *child = NULL;
+    img_iterator_node **childs = NULL;
+    tree_menu_dir *dir = NULL;
+
+    if (node->menudone)
+    {
+        return 0;
+    }
+
+    childs = ventoy_get_sorted_child(node, &num);
+    if (num > 0)
+    {
+        node->menudirs = grub_zalloc(num * sizeof(tree_menu_dir));
+        if (!node->menudirs)
+        {
+            grub_check_free(childs);
+            return 1;
+        }
+    }
+
+    for (i = 0, child = node->firstchild; i < num; i++, child = child->next)
+    {
+        cur = childs ? childs[i] : child;
+        if (cur->isocnt == 0)
+        {
+            continue;
+        }
+
+        dir = node->menudirs + node->menudirnum;
+
+        cur->dir[cur->dirlen - 1] = 0;
+        dir->class = ventoy_plugin_get_menu_class(vtoy_class_directory, cur->dir, cur->dir);
+        if (!dir->class)
+        {
+            dir->class = "vtoydir";
+        }
+
+        dir->tip = ventoy_plugin_get_menu_tip(vtoy_tip_directory, cur->dir);
+        alias = ventoy_plugin_get_menu_alias(vtoy_alias_directory, cur->dir);
+        dir->title = ventoy_tree_dir_title(alias, cur->dir + node->dirlen);
+        dir->id = grub_xasprintf("DIR_%s", cur->dir + node->dirlen);
+        dir->node = cur;
+        cur->dir[cur->dirlen - 1] = '/';
+
+        if (!dir->title || !dir->id)
+        {
+            grub_check_free(dir->title);
+            grub_check_free(dir->id);
+            continue;
+        }
+
+        node->menudirnum++;
+    }
+    grub_check_free(childs);
+
+    node->menudone = 1;
+    return 0;
+}
+
+static int ventoy_lazy_tree_menu(img_iterator_node *node)
+{
+    int i;
+    char tip[64];
+    char body[64];
+    char title[512];
+    tree_menu_dir *dir = NULL;
+
+    if (ventoy_lazy_tree_resolve(node))
+    {
+        return 1;
+    }
+
+    if (node == &g_img_iterator_head)
+    {
+        ventoy_native_tree_head();
+    }
+    else
+    {
+        node->dir[node->dirlen - 1] = 0;
+        if (g_tree_view_menu_style == 0)
+        {
+            grub_snprintf(title, sizeof(title), "%-10s [%s/..]", "<--", node->dir);
+        }
+        else
+        {
+            grub_snprintf(title, sizeof(title), "[%s/..]", node->dir);
+        }
+        node->dir[node->dirlen - 1] = '/';
+
+        ventoy_native_menu_entry(title, "VTOY_RET", "vtoyret", NULL, "  echo 'return ...' \n", 0);
+    }
+
+    for (i = 0; i < node->menudirnum; i++)
+    {
+        dir = node->menudirs + i;
+        grub_snprintf(tip, sizeof(tip), "_VTIP_%p", dir->tip);
+        grub_snprintf(body, sizeof(body), "  vt_lazy_tree_menu %d \n", dir->node->menuindex);
+        ventoy_native_menu_entry(dir->title, tip, dir->class, dir->id, body, 1);
+    }
+
+    for (i = 0; i < node->menuimgnum; i++)
+    {
+        if (ventoy_native_img_entry(node->menuimgs[i], 1))
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static grub_err_t ventoy_cmd_lazy_tree_menu(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    int index = 0;
+    img_iterator_node *node = NULL;
+
+    (void)ctxt;
+
+    if (argc != 1 || !ventoy_is_decimal(args[0]))
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {index}", cmd_raw_name);
+    }
+
+    index = (int)grub_strtoul(args[0], NULL, 10);
+    for (node = &g_img_iterator_head; g_tree_menu_lazy && node; node = node->next)
+    {
+        if (node->menuindex == index)
+        {
+            ventoy_lazy_tree_menu(node);
+            break;
+        }
+    }
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
+
 static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc, char **args)
 {
     static int configfile_mode = 0;
@@ -4352,11 +5584,21 @@ static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc,
     {
         if (args[1][0] == '0')
         {
-            grub_script_execute_sourcecode(g_list_script_buf);
+            if (ventoy_native_menu_enabled() == 0 || ventoy_native_list_menu())
+            {
+                grub_script_execute_sourcecode(g_list_script_buf);
+            }
+        }
+        else if (g_tree_menu_lazy)
+        {
+            ventoy_lazy_tree_menu(&g_img_iterator_head);
         }
         else
         {
-            grub_script_execute_sourcecode(g_tree_script_buf);
+            if (ventoy_native_menu_enabled() == 0 || ventoy_native_tree_menu())
+            {
+                grub_script_execute_sourcecode(g_tree_script_buf);
+            }
         }
     }
     else
@@ -4375,6 +5617,7 @@ static grub_err_t ventoy_cmd_dynamic_menu(grub_extcmd_context_t ctxt, int argc,
         else
         {
              g_ventoy_last_entry = -1;
+            ventoy_tree_script_ensure();
             grub_snprintf(memfile, sizeof(memfile), "configfile mem:0x%llx:size:%d",
                 (ulonglong)(ulong)g_tree_script_buf, g_tree_script_pos);
         }
@@ -4885,6 +6128,8 @@ static grub_err_t ventoy_cmd_acpi_param(grub_extcmd_context_t ctxt, int argc, ch
     char cmd[64];
     ventoy_chain_head *chain;
     ventoy_img_chunk *chunk;
+    ventoy_img_chunk mapchunk;
+    ventoy_chunk_map_cursor cursor;
     ventoy_os_param *osparam;
     ventoy_image_location *location;
     ventoy_image_disk_region *region;
@@ -4951,25 +6196,39 @@ static grub_err_t ventoy_cmd_acpi_param(grub_extcmd_context_t ctxt, int argc, ch
 
     region = location->regions;
     chunk = (ventoy_img_chunk *)((char *)chain + chain->img_chunk_offset);
-    if (512 == image_sector_size)
+    if (ventoy_chunk_map_check(chunk) == 0)
+    {
+        ventoy_chunk_map_seek(&cursor, chunk, 0);
+        chunk = &mapchunk;
+    }
+    else
     {
-        for (i = 0; i < img_chunk_num; i++)
+        cursor.head = NULL;
+    }
+
+    for (i = 0; i < img_chunk_num; i++)
+    {
+        if (cursor.head && ventoy_chunk_map_next(&cursor, chunk))
+        {
+            break;
+        }
+
+        if (512 == image_sector_size)
         {
             region->image_sector_count = chunk->disk_end_sector - chunk->disk_start_sector + 1;
             region->image_start_sector = chunk->img_start_sector * 4;
-            region->disk_start_sector  = chunk->disk_start_sector;
-            region++;
-            chunk++;
         }
-    }
-    else
-    {
-        for (i = 0; i < img_chunk_num; i++)
+        else
         {
             region->image_sector_count = chunk->img_end_sector - chunk->img_start_sector + 1;
             region->image_start_sector = chunk->img_start_sector;
-            region->disk_start_sector  = chunk->disk_start_sector;
-            region++;
+        }
+
+        region->disk_start_sector = chunk->disk_start_sector;
+        region++;
+
+        if (cursor.head == NULL)
+        {
             chunk++;
         }
     }
@@ -6105,7 +7364,7 @@ static grub_err_t grub_cmd_check_vlnk(grub_extcmd_context_t ctxt, int argc, char
     grub_memset(&vlnk, 0, sizeof(vlnk));
     grub_file_read(file, &vlnk, sizeof(vlnk));
 
-    ret = ventoy_check_vlnk_data(&vlnk, 1, dst, sizeof(dst));
+    ret = ventoy_check_vlnk_data(&vlnk, 1, dst, sizeof(dst), NULL);
 
 out:
 
@@ -6977,6 +8236,8 @@ static cmd_para ventoy_cmds[] =
     { "vt_device", ventoy_cmd_device, 0, NULL, "path var", "", NULL },
     { "vt_check_compatible",   ventoy_cmd_check_compatible, 0, NULL, "", "", NULL },
     { "vt_list_img", ventoy_cmd_list_img, 0, NULL, "{device} {cntvar}", "find all iso file in device", NULL },
+    { "vt_dump_img_index", ventoy_cmd_dump_img_index, 0, NULL, "{device}", "", NULL },
+    { "vt_dump_chunk_cache", ventoy_cmd_dump_chunk_cache, 0, NULL, "", "", NULL },
     { "vt_clear_img", ventoy_cmd_clear_img, 0, NULL, "", "clear image list", NULL },
     { "vt_img_name", ventoy_cmd_img_name, 0, NULL, "{imageID} {var}", "get image name", NULL },
     { "vt_chosen_img_path", ventoy_cmd_chosen_img_path, 0, NULL, "{var}", "get chosen img path", NULL },
@@ -6987,6 +8248,7 @@ static cmd_para ventoy_cmds[] =
     { "vt_load_vhdboot", ventoy_cmd_load_vhdboot, 0, NULL, "", "", NULL },
     { "vt_patch_vhdboot", ventoy_cmd_patch_vhdboot, 0, NULL, "", "", NULL },
     { "vt_raw_chain_data", ventoy_cmd_raw_chain_data, 0, NULL, "", "", NULL },
+    { "vt_vdisk_chain_data", ventoy_cmd_vdisk_chain_data, 0, NULL, "{file}", "", NULL },
     { "vt_get_vtoy_type", ventoy_cmd_get_vtoy_type, 0, NULL, "", "", NULL },
     { "vt_check_custom_boot", ventoy_cmd_check_custom_boot, 0, NULL, "", "", NULL },
     { "vt_dump_custom_boot", ventoy_cmd_dump_custom_boot, 0, NULL, "", "", NULL },
@@ -7014,6 +8276,8 @@ static cmd_para ventoy_cmds[] =
     { "vt_find_first_bootable_hd", ventoy_cmd_find_bootable_hdd, 0, NULL, "", "", NULL },
     { "vt_dump_menu", ventoy_cmd_dump_menu, 0, NULL, "", "", NULL },
     { "vt_dynamic_menu", ventoy_cmd_dynamic_menu, 0, NULL, "", "", NULL },
+    { "vt_lazy_tree_menu", ventoy_cmd_lazy_tree_menu, 0, NULL, "", "", NULL },
+    { "vt_perf_dump", ventoy_cmd_perf_dump, 0, NULL, "[file]", "", NULL },
     { "vt_check_mode", ventoy_cmd_check_mode, 0, NULL, "", "", NULL },
     { "vt_dump_img_list", ventoy_cmd_dump_img_list, 0, NULL, "", "", NULL },
     { "vt_dump_injection", ventoy_cmd_dump_injection, 0, NULL, "", "", NULL },
@@ -285,11 +285,200 @@ typedef struct boot_info_table
 #define img_type_vtoy  5
 #define img_type_max   6
 
+#define VTOY_IMG_INDEX_FILE         "/ventoy/ventoy_img_index.dat"
+#define VTOY_IMG_INDEX_MAGIC        "VTOYIDX"
+#define VTOY_IMG_INDEX_VERSION      1
+#define VTOY_IMG_INDEX_MAX_SIZE     (64 * 1024 * 1024)
+
+#define VTOY_IMG_INDEX_DIR_IGNORE   0x00000001 /* directory has .ventoyignore */
+#define VTOY_IMG_INDEX_ENT_DIR      0x00000001 /* entry is a sub directory */
+
+#define VTOY_CHUNK_CACHE_FILE       "/ventoy/ventoy_chunk_cache.dat"
+#define VTOY_CHUNK_CACHE_MAGIC      "VTOYCHK"
+#define VTOY_CHUNK_CACHE_VERSION    2
+#define VTOY_CHUNK_CACHE_MAX_SIZE   (16 * 1024 * 1024)
+
+#pragma pack(1)
+
+/*
+ * On-disk image index (written by "vtoycli imgindex")
+ *
+ * ventoy_img_index_head
+ * ventoy_img_index_dir  [dir_num]   sorted by path (grub_strcmp order)
+ * ventoy_img_index_ent  [ent_num]   entries of each dir are contiguous
+ * string table          [str_size]  '\0' terminated path/name strings
+ *
+ * crc32 is crc32c of everything after the head.
+ */
+typedef struct ventoy_img_index_head
+{
+    char          magic[8];
+    grub_uint32_t version;
+    grub_uint32_t head_size;
+    grub_uint32_t dir_num;
+    grub_uint32_t ent_num;
+    grub_uint32_t str_size;
+    grub_uint32_t crc32;
+    grub_uint8_t  reserved[32];
+}ventoy_img_index_head;
+
+typedef struct ventoy_img_index_dir
+{
+    grub_uint32_t path_off; /* full path with a trailing '/' */
+    grub_uint32_t flag;
+    grub_int32_t  mtime;    /* unix time, UTC */
+    grub_uint32_t first_ent;
+    grub_uint32_t ent_num;
+}ventoy_img_index_dir;
+
+typedef struct ventoy_img_index_ent
+{
+    grub_uint32_t name_off;
+    grub_uint32_t flag;
+    grub_int32_t  mtime;
+    grub_uint64_t size;
+}ventoy_img_index_ent;
+
+/*
+ * On-disk chunk cache (an existing file, updated in place by GRUB)
+ *
+ * ventoy_chunk_cache_head
+ * ventoy_chunk_cache_ent  [ent_num]  each one followed by its path
+ *                                    ('\0' terminated, padded to 8 bytes)
+ *                                    and ventoy_img_chunk[chunk_num]
+ *
+ * used is the total size of all the entries, crc32 is crc32c of them.
+ * A file without a valid head is taken as an empty cache.
+ */
+typedef struct ventoy_chunk_cache_head
+{
+    char          magic[8];
+    grub_uint32_t version;
+    grub_uint32_t head_size;
+    grub_uint32_t ent_num;
+    grub_uint32_t used;
+    grub_uint32_t crc32;
+    grub_uint8_t  reserved[36];
+}ventoy_chunk_cache_head;
+
+typedef struct ventoy_chunk_cache_ent
+{
+    grub_uint32_t ent_size;
+    grub_uint32_t path_len;   /* include the '\0' */
+    grub_uint64_t file_size;
+    grub_uint64_t part_start;
+    grub_int32_t  mtime;      /* unix time, UTC */
+    grub_uint32_t chunk_num;
+    grub_uint64_t file_id;    /* first cluster (exFAT) or inode (ext/xfs), 0 for others */
+}ventoy_chunk_cache_ent;
+
+#pragma pack()
+
+/*
+ * Bump allocator for the image list and the directory nodes.
+ * Everything allocated from an arena is released together.
+ */
+#define VTOY_ARENA_BLOCK_SIZE   (64 * 1024)
+
+typedef struct ventoy_arena_block
+{
+    struct ventoy_arena_block *next;
+    grub_uint32_t size;
+    grub_uint32_t used;
+}ventoy_arena_block;
+
+#define VTOY_ARENA_HEAD_SIZE    ((sizeof(ventoy_arena_block) + 7) & (~((grub_size_t)7)))
+
+typedef struct ventoy_arena
+{
+    ventoy_arena_block *block;
+    grub_size_t total;
+}ventoy_arena;
+
+enum vtoy_perf_phase
+{
+    vtoy_perf_list_img = 0,
+    vtoy_perf_load_plugin,
+    vtoy_perf_block_list,
+    vtoy_perf_linux_chain,
+    vtoy_perf_windows_chain,
+    vtoy_perf_wim_patch,
+    vtoy_perf_load_cpio,
+
+    vtoy_perf_phase_max
+};
+
+enum vtoy_perf_counter
+{
+    vtoy_perf_cnt_image = 0,
+    vtoy_perf_cnt_dir,
+    vtoy_perf_cnt_chunk,
+    vtoy_perf_cnt_chain_size,
+    vtoy_perf_cnt_cpio_size,
+    vtoy_perf_cnt_chunk_cache_hit,
+    vtoy_perf_cnt_chunk_cache_miss,
+
+    vtoy_perf_cnt_max
+};
+
+#define VTOY_PERF_BUF_SIZE      4096
+#define VTOY_PERF_SAVE_MAX      (1024 * 1024)
+
+/* default and max read cache size of Ventoy.efi, VTOY_UEFI_CACHE_SIZE */
+#define VTOY_UEFI_CACHE_DEF_MB  8
+#define VTOY_UEFI_CACHE_MAX_MB  256
+
+/* I/O trace ring of Ventoy.efi, VTOY_UEFI_IO_TRACE in K entries */
+#define VTOY_UEFI_IO_TRACE_MAX_K  256
+
+/* compressed memdisk, the blocks are stored in segments of this size */
+#define VTOY_CMEM_SEG_SIZE      (4 * 1024 * 1024)
+#define VTOY_LZ4_BOUND(n)       ((n) + (n) / 255 + 16)
+
+/* chunk list smaller than this always use the plain ventoy_img_chunk array */
+#define VTOY_CHUNK_MAP_MIN_CHUNK    4096
+
+typedef struct ventoy_chunk_map_cursor
+{
+    const ventoy_chunk_map_head *head;
+    const ventoy_chunk_map_index *index;
+    const grub_uint8_t *data;
+    grub_uint32_t next;     /* id of the next chunk */
+    grub_uint32_t pos;      /* data offset of the next record */
+    grub_uint32_t repeat;   /* chunks left in the current record */
+    grub_uint32_t img_gap;
+    grub_uint32_t img_len;
+    grub_int64_t  disk_gap;
+    grub_int64_t  disk_extra;
+    grub_uint32_t img_end;  /* of the last decoded chunk */
+    grub_uint64_t disk_end;
+}ventoy_chunk_map_cursor;
+
+typedef struct ventoy_file_block
+{
+    grub_disk_addr_t sector;
+    unsigned offset;
+    unsigned length;
+}ventoy_file_block;
+
+typedef struct ventoy_file_block_list
+{
+    int num;
+    int max;
+    ventoy_file_block *blocks;
+}ventoy_file_block_list;
+
+/*
+ * The full path is kept with every image (allocated just after img_info),
+ * not only the name as an offset into the parent dir path. img->path is
+ * used as a plain string in many places (menu, plugins, boot), so building
+ * it on every use would cost more than the shared dir prefix saves.
+ */
 typedef struct img_info
 {
     int pathlen;
-    char path[512];
-    char name[256];
+    char *path;
+    char *name; /* points to the file name in path */
 
     const char *alias;
     const char *tip1;
@@ -301,7 +490,6 @@ typedef struct img_info
     int type;
     int plugin_list_index;
     grub_uint64_t size;
-    int select;
     int unsupport;
 
     void *parent;
@@ -310,25 +498,66 @@ typedef struct img_info
     struct img_info *prev;
 }img_info;
 
+/* .vcfg file found while reading a directory, added when the directory is attached */
+typedef struct img_pend_vcfg
+{
+    struct img_pend_vcfg *next;
+    char *path;
+}img_pend_vcfg;
+
 typedef struct img_iterator_node
 {
     struct img_iterator_node *next;
     img_info **tail;
-    char dir[400];
+    char *dir;
     int dirlen;
     int level;
     int isocnt;
     int done;
-    int select;
 
     int plugin_list_index;
 
+    const ventoy_img_index_dir *idxdir;
+
     struct img_iterator_node *parent;
     struct img_iterator_node *firstchild;
 
     void *firstiso;
+
+    /* entries found while reading this directory, attached after the whole directory is read */
+    int ignore;
+    struct img_iterator_node *pendnode;
+    struct img_iterator_node *pendnodetail;
+    img_info *pendimg;     /* size 0: got when attached (vlnk or size not in dirhook info) */
+    img_info *pendimgtail;
+    img_pend_vcfg *pendvcfg;
+    img_pend_vcfg *pendvcfgtail;
+
+    /* lazy tree view, sub directories are resolved when first opened */
+    int menuindex; /* position in the node list, used by vt_lazy_tree_menu */
+    int menudone;
+    int menudirnum;
+    struct tree_menu_dir *menudirs;
+    int menuimgnum;
+    img_info **menuimgs;
 }img_iterator_node;
 
+/* directory of tree view, used to build the menu entries directly */
+typedef struct tree_menu_dir
+{
+    char *title;
+    char *id;
+    const char *class;
+    const void *tip;
+
+    /* submenu body in g_tree_script_buf */
+    int bodyoff;
+    int bodylen;
+
+    /* lazy tree view */
+    img_iterator_node *node;
+}tree_menu_dir;
+
 
 
 typedef struct initrd_info
@@ -666,6 +895,8 @@ int ventoy_str_chrcnt(const char *str, char c);
 int ventoy_strcmp(const char *pattern, const char *str);
 int ventoy_strncmp (const char *pattern, const char *str, grub_size_t n);
 void ventoy_fill_os_param(grub_file_t file, ventoy_os_param *param);
+grub_uint32_t ventoy_get_uefi_cache_size(void);
+grub_uint32_t ventoy_get_uefi_io_trace_num(void);
 grub_err_t ventoy_cmd_isolinux_initrd_collect(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_grub_initrd_collect(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_specify_initrd_file(grub_extcmd_context_t ctxt, int argc, char **args);
@@ -1066,6 +1297,54 @@ typedef struct image_list
     struct image_list *next;
 }image_list;
 
+/* how a path rule in the plugin path index is matched (same as the old list walk) */
+#define VTOY_PATH_MATCH_EXACT    0 /* grub_strncmp, no wildcard */
+#define VTOY_PATH_MATCH_STRCMP   1 /* same length + ventoy_strcmp */
+#define VTOY_PATH_MATCH_STRNCMP  2 /* same length + ventoy_strncmp */
+#define VTOY_PATH_MATCH_PARENT   3 /* ventoy_plugin_is_parent */
+#define VTOY_PATH_MATCH_PREFIX   4 /* directory is a prefix of the rule (image_list) */
+#define VTOY_PATH_MATCH_SUBSTR   5 /* grub_strstr (menu_class key) */
+
+typedef enum plugin_path_type
+{
+    plugin_path_alias_file = 0,
+    plugin_path_alias_dir,
+    plugin_path_tip_file,
+    plugin_path_tip_dir,
+    plugin_path_class_key,
+    plugin_path_class_parent,
+    plugin_path_class_dir,
+    plugin_path_image_list_file,
+    plugin_path_image_list_dir,
+    plugin_path_persistence,
+    plugin_path_install_file,
+    plugin_path_install_parent,
+    plugin_path_injection_file,
+    plugin_path_injection_parent,
+    plugin_path_memdisk,
+    plugin_path_conf_replace,
+    plugin_path_dud,
+    plugin_path_pwd_file,
+    plugin_path_pwd_parent,
+
+    plugin_path_type_max
+}plugin_path_type;
+
+typedef struct plugin_path_rule
+{
+    int type;
+    int mode;
+    int wild;    /* contains wildcard, can not be found by hash */
+    int order;   /* position in the plugin list, the smallest one wins */
+    int keylen;
+    const char *key;
+    void *data;
+
+    struct plugin_path_rule *hnext;  /* hash bucket chain */
+    struct plugin_path_rule *wnext;  /* wildcard rules of the same type, in order */
+    struct plugin_path_rule *next;   /* all rules, for free */
+}plugin_path_rule;
+
 #define VTOY_PASSWORD_NONE       0
 #define VTOY_PASSWORD_TXT        1
 #define VTOY_PASSWORD_MD5        2
@@ -1153,6 +1432,9 @@ char * ventoy_get_line(char *start);
 char *ventoy_str_last(char *str, char ch);
 int ventoy_cmp_img(img_info *img1, img_info *img2);
 void ventoy_swap_img(img_info *img1, img_info *img2);
+typedef int (*ventoy_sort_cmp_pf)(void *p1, void *p2);
+void ventoy_sort_ptr_array(void **array, int num, ventoy_sort_cmp_pf cmp);
+int ventoy_tree_script_ensure(void);
 char * ventoy_plugin_get_cur_install_template(const char *isopath, install_template **cur);
 install_template * ventoy_plugin_find_install_template(const char *isopath);
 persistence_config * ventoy_plugin_find_persistent(const char *isopath);
@@ -1201,6 +1483,7 @@ void ventoy_debug_dump_guid(const char *prefix, grub_uint8_t *guid);
 grub_err_t ventoy_cmd_load_vhdboot(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_patch_vhdboot(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_raw_chain_data(grub_extcmd_context_t ctxt, int argc, char **args);
+grub_err_t ventoy_cmd_vdisk_chain_data(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_get_vtoy_type(grub_extcmd_context_t ctxt, int argc, char **args);
 int ventoy_check_password(const vtoy_password *pwd, int retry);
 int ventoy_plugin_add_custom_boot(const char *vcfgpath);
@@ -1262,8 +1545,11 @@ typedef struct ventoy_vlnk_part
     grub_fs_t fs;
     int probe;
     struct ventoy_vlnk_part *next;
+    struct ventoy_vlnk_part *hnext; /* next node with the same disksig hash */
 }ventoy_vlnk_part;
 
+#define VTOY_VLNK_PART_HASH_SIZE  64
+
 
 typedef struct browser_mbuf
 {
@@ -1324,12 +1610,33 @@ extern int g_filt_trash_dir;
 extern int g_vtoy_file_flt[VTOY_FILE_FLT_BUTT];
 extern const char *g_menu_class[img_type_max];
 extern char g_iso_path[256];
-int ventoy_add_vlnk_file(char *dir, const char *name);
+int ventoy_add_vlnk_file(char *dir, const char *name, grub_uint64_t *size);
+int ventoy_img_index_load(const char *isopart);
+void ventoy_img_index_free(void);
+const ventoy_img_index_dir * ventoy_img_index_find(const char *path, const struct grub_dirhook_info *info);
+int ventoy_img_index_iterate(const ventoy_img_index_dir *dir, grub_fs_dir_hook_t hook, void *data);
+grub_err_t ventoy_cmd_dump_img_index(grub_extcmd_context_t ctxt, int argc, char **args);
+int ventoy_get_block_list_cached(grub_file_t file, ventoy_img_chunk_list *chunklist,
+                                 grub_disk_addr_t start, char *err, grub_uint32_t len);
+grub_err_t ventoy_cmd_dump_chunk_cache(grub_extcmd_context_t ctxt, int argc, char **args);
+int ventoy_chunk_map_check(const void *map);
+int ventoy_chunk_map_seek(ventoy_chunk_map_cursor *cursor, const void *map, grub_uint32_t id);
+int ventoy_chunk_map_next(ventoy_chunk_map_cursor *cursor, ventoy_img_chunk *chunk);
+grub_uint32_t ventoy_img_chunk_data_size(const ventoy_img_chunk_list *list);
+int ventoy_lz4_compress(const grub_uint8_t *src, int srclen, grub_uint8_t *dst);
+void ventoy_img_chunk_data_fill(const ventoy_img_chunk_list *list, void *buf, grub_uint32_t size);
+grub_err_t ventoy_file_overwrite(const char *path, const void *data, grub_uint32_t len, grub_uint32_t maxsize, int fill);
 grub_err_t ventoy_cmd_browser_dir(grub_extcmd_context_t ctxt, int argc, char **args);
 grub_err_t ventoy_cmd_browser_disk(grub_extcmd_context_t ctxt, int argc, char **args);
 int ventoy_get_fs_type(const char *fs);
 int ventoy_img_name_valid(const char *filename, grub_size_t namelen);
 void * ventoy_alloc_chain(grub_size_t size);
+void * ventoy_arena_alloc(ventoy_arena *arena, grub_size_t size);
+void ventoy_arena_free(ventoy_arena *arena);
+void ventoy_perf_begin(int phase);
+void ventoy_perf_end(int phase);
+void ventoy_perf_add(int counter, grub_uint64_t value);
+grub_err_t ventoy_cmd_perf_dump(grub_extcmd_context_t ctxt, int argc, char **args);
 int ventoy_plugin_load_menu_lang(int init, const char *lang);
 const char *ventoy_get_vmenu_title(const char *vMenu);
 grub_err_t ventoy_cmd_cur_menu_lang(grub_extcmd_context_t ctxt, int argc, char **args);
@@ -0,0 +1,331 @@
+/******************************************************************************
+ * ventoy_img_index.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/lib/crc.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/*
+ * The index records the image files of every directory on the Ventoy
+ * partition together with the directory mtime.
+ * A directory mtime only tells that the entries of the directory itself are
+ * unchanged, it says nothing about the directories below it. So the real mtime
+ * of every directory must come from a real fs_dir of its parent, which means
+ * every directory that has sub directories is always read from disk.
+ * Only a directory without any sub directory and with the same mtime (as
+ * reported by the parent fs_dir) as the recorded one is taken from the index,
+ * its file entries are replayed and the fs_dir call for it is skipped.
+ */
+
+static char *g_img_index_buf = NULL;
+static const ventoy_img_index_head *g_img_index_head = NULL;
+static const ventoy_img_index_dir *g_img_index_dirs = NULL;
+static const ventoy_img_index_ent *g_img_index_ents = NULL;
+static const char *g_img_index_str = NULL;
+
+static int g_img_index_hit = 0;
+static int g_img_index_miss = 0;
+
+static const char * ventoy_img_index_str(grub_uint32_t off)
+{
+    return g_img_index_str + off;
+}
+
+static int ventoy_img_index_check(grub_uint32_t size)
+{
+    grub_uint32_t i;
+    grub_uint64_t total;
+    const char *prev = NULL;
+    const char *path = NULL;
+    const ventoy_img_index_head *head = g_img_index_head;
+
+    if (size < sizeof(ventoy_img_index_head))
+    {
+        debug("img index too small %u\n", size);
+        return 1;
+    }
+
+    if (grub_memcmp(head->magic, VTOY_IMG_INDEX_MAGIC, sizeof(VTOY_IMG_INDEX_MAGIC)) ||
+        head->version != VTOY_IMG_INDEX_VERSION ||
+        head->head_size != sizeof(ventoy_img_index_head))
+    {
+        debug("img index invalid head %u %u\n", head->version, head->head_size);
+        return 1;
+    }
+
+    total = (grub_uint64_t)sizeof(ventoy_img_index_head) +
+            (grub_uint64_t)head->dir_num * sizeof(ventoy_img_index_dir) +
+            (grub_uint64_t)head->ent_num * sizeof(ventoy_img_index_ent) +
+            head->str_size;
+    if (total != size || head->str_size == 0)
+    {
+        debug("img index invalid size %llu %u\n", (ulonglong)total, size);
+        return 1;
+    }
+
+    g_img_index_dirs = (ventoy_img_index_dir *)(head + 1);
+    g_img_index_ents = (ventoy_img_index_ent *)(g_img_index_dirs + head->dir_num);
+    g_img_index_str = (char *)(g_img_index_ents + head->ent_num);
+
+    if (head->crc32 != grub_getcrc32c(0, head + 1, size - sizeof(ventoy_img_index_head)))
+    {
+        debug("img index crc32 mismatch\n");
+        return 1;
+    }
+
+    if (g_img_index_str[head->str_size - 1])
+    {
+        debug("img index string table not terminated\n");
+        return 1;
+    }
+
+    for (i = 0; i < head->ent_num; i++)
+    {
+        if (g_img_index_ents[i].name_off >= head->str_size)
+        {
+            debug("img index invalid entry %u\n", i);
+            return 1;
+        }
+    }
+
+    /* dir table must be sorted, ventoy_img_index_find use binary search */
+    for (i = 0; i < head->dir_num; i++)
+    {
+        if (g_img_index_dirs[i].path_off >= head->str_size ||
+            g_img_index_dirs[i].first_ent > head->ent_num ||
+            g_img_index_dirs[i].ent_num > head->ent_num - g_img_index_dirs[i].first_ent)
+        {
+            debug("img index invalid dir %u\n", i);
+            return 1;
+        }
+
+        path = ventoy_img_index_str(g_img_index_dirs[i].path_off);
+        if (prev && grub_strcmp(prev, path) >= 0)
+        {
+            debug("img index dir not sorted <%s> <%s>\n", prev, path);
+            return 1;
+        }
+        prev = path;
+    }
+
+    return 0;
+}
+
+static grub_uint32_t ventoy_img_index_subdir_num(const ventoy_img_index_dir *dir)
+{
+    grub_uint32_t i;
+    grub_uint32_t num = 0;
+
+    for (i = 0; i < dir->ent_num; i++)
+    {
+        if (g_img_index_ents[dir->first_ent + i].flag & VTOY_IMG_INDEX_ENT_DIR)
+        {
+            num++;
+        }
+    }
+
+    return num;
+}
+
+void ventoy_img_index_free(void)
+{
+    if (g_img_index_buf)
+    {
+        debug("img index free, hit:%d miss:%d\n", g_img_index_hit, g_img_index_miss);
+    }
+
+    grub_check_free(g_img_index_buf);
+    g_img_index_head = NULL;
+    g_img_index_dirs = NULL;
+    g_img_index_ents = NULL;
+    g_img_index_str = NULL;
+}
+
+int ventoy_img_index_load(const char *isopart)
+{
+    grub_uint32_t size;
+    grub_file_t file = NULL;
+
+    ventoy_img_index_free();
+    g_img_index_hit = g_img_index_miss = 0;
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s%s", isopart, VTOY_IMG_INDEX_FILE);
+    if (!file)
+    {
+        return 1;
+    }
+
+    if (file->size > VTOY_IMG_INDEX_MAX_SIZE)
+    {
+        debug("img index too large %llu\n", (ulonglong)file->size);
+        grub_file_close(file);
+        return 1;
+    }
+
+    size = (grub_uint32_t)file->size;
+    g_img_index_buf = grub_malloc(size + 1);
+    if (!g_img_index_buf)
+    {
+        grub_file_close(file);
+        return 1;
+    }
+
+    if (grub_file_read(file, g_img_index_buf, size) != (grub_ssize_t)size)
+    {
+        debug("img index read failed %u\n", size);
+        grub_file_close(file);
+        ventoy_img_index_free();
+        return 1;
+    }
+    grub_file_close(file);
+
+    g_img_index_head = (ventoy_img_index_head *)g_img_index_buf;
+    if (ventoy_img_index_check(size))
+    {
+        ventoy_img_index_free();
+        return 1;
+    }
+
+    debug("img index loaded, dir:%u ent:%u str:%u\n", g_img_index_head->dir_num,
+          g_img_index_head->ent_num, g_img_index_head->str_size);
+    return 0;
+}
+
+const ventoy_img_index_dir * ventoy_img_index_find(const char *path, const struct grub_dirhook_info *info)
+{
+    int rc;
+    grub_uint32_t low = 0;
+    grub_uint32_t mid = 0;
+    grub_uint32_t high = 0;
+    const ventoy_img_index_dir *dir = NULL;
+
+    if (!g_img_index_head || !info->mtimeset)
+    {
+        return NULL;
+    }
+
+    high = g_img_index_head->dir_num;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        rc = grub_strcmp(path, ventoy_img_index_str(g_img_index_dirs[mid].path_off));
+        if (rc == 0)
+        {
+            dir = g_img_index_dirs + mid;
+            break;
+        }
+        else if (rc < 0)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    if (dir && dir->mtime == info->mtime && ventoy_img_index_subdir_num(dir) == 0)
+    {
+        g_img_index_hit++;
+        return dir;
+    }
+
+    debug("img index miss <%s> %s\n", path, dir ? ((dir->mtime == info->mtime) ? "has sub dir" : "mtime changed") : "not found");
+    g_img_index_miss++;
+    return NULL;
+}
+
+int ventoy_img_index_iterate(const ventoy_img_index_dir *dir, grub_fs_dir_hook_t hook, void *data)
+{
+    grub_uint32_t i;
+    struct grub_dirhook_info info;
+    const ventoy_img_index_ent *ent = NULL;
+
+    for (i = 0; i < dir->ent_num; i++)
+    {
+        ent = g_img_index_ents + dir->first_ent + i;
+
+        /* only the file entries are replayed, see ventoy_img_index_find */
+        if (ent->flag & VTOY_IMG_INDEX_ENT_DIR)
+        {
+            continue;
+        }
+
+        grub_memset(&info, 0, sizeof(info));
+        info.mtimeset = 1;
+        info.mtime = ent->mtime;
+        info.case_insensitive = 1;
+        info.size = ent->size;
+
+        if (hook(ventoy_img_index_str(ent->name_off), &info, data))
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+grub_err_t ventoy_cmd_dump_img_index(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    grub_uint32_t i;
+    const ventoy_img_index_dir *dir = NULL;
+
+    (void)ctxt;
+
+    if (argc != 1)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {device}", cmd_raw_name);
+    }
+
+    if (ventoy_img_index_load(args[0]))
+    {
+        grub_printf("No valid image index in %s\n", args[0]);
+        return 0;
+    }
+
+    grub_printf("Image index: dir:%u entry:%u string:%u\n", g_img_index_head->dir_num,
+                g_img_index_head->ent_num, g_img_index_head->str_size);
+
+    for (i = 0; i < g_img_index_head->dir_num; i++)
+    {
+        dir = g_img_index_dirs + i;
+        grub_printf("<%s> flag:0x%x mtime:%d entry:%u\n", ventoy_img_index_str(dir->path_off),
+                    dir->flag, dir->mtime, dir->ent_num);
+    }
+
+    ventoy_img_index_free();
+
+    return 0;
+}
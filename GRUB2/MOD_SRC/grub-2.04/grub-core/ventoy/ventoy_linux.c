@@ -1351,7 +1351,9 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
         return grub_error(GRUB_ERR_BAD_ARGUMENT, "image chunk is null\n");
     }
 
-    img_chunk_size = g_img_chunk_list.cur_chunk * sizeof(ventoy_img_chunk);
+    ventoy_perf_begin(vtoy_perf_load_cpio);
+
+    img_chunk_size = ventoy_img_chunk_data_size(&g_img_chunk_list);
 
     file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s/%s", args[0], VTOY_COMM_CPIO);
     if (!file)
@@ -1472,7 +1474,8 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
     initrd_head_len = ventoy_cpio_newc_fill_head(buf, 0, NULL, "initrd000.xx");
 
     /* step1: insert image chunk data to cpio */
-    headlen = ventoy_cpio_newc_fill_head(buf, img_chunk_size, g_img_chunk_list.chunk, "ventoy/ventoy_image_map");
+    headlen = ventoy_cpio_newc_fill_head(buf, img_chunk_size, NULL, "ventoy/ventoy_image_map");
+    ventoy_img_chunk_data_fill(&g_img_chunk_list, buf + headlen, img_chunk_size);
     buf += headlen + ventoy_align(img_chunk_size, 4);
 
     if (template_buf)
@@ -1548,6 +1551,9 @@ grub_err_t ventoy_cmd_load_cpio(grub_extcmd_context_t ctxt, int argc, char **arg
         ventoy_cpio_busybox64((cpio_newc_header *)g_ventoy_cpio_buf, "m64");
     }
 
+    ventoy_perf_add(vtoy_perf_cnt_cpio_size, g_ventoy_cpio_size);
+    ventoy_perf_end(vtoy_perf_load_cpio);
+
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
@@ -1658,6 +1664,8 @@ grub_err_t ventoy_cmd_linux_chain_data(grub_extcmd_context_t ctxt, int argc, cha
     (void)ctxt;
     (void)argc;
 
+    ventoy_perf_begin(vtoy_perf_linux_chain);
+
     compatible = grub_env_get("ventoy_compatible");
     if (compatible && compatible[0] == 'Y')
     {
@@ -1706,7 +1714,7 @@ grub_err_t ventoy_cmd_linux_chain_data(grub_extcmd_context_t ctxt, int argc, cha
         }
     }
     
-    img_chunk_size = g_img_chunk_list.cur_chunk * sizeof(ventoy_img_chunk);
+    img_chunk_size = ventoy_img_chunk_data_size(&g_img_chunk_list);
 
     override_count = ventoy_linux_get_override_chunk_count();
     virt_chunk_count = ventoy_linux_get_virt_chunk_count();
@@ -1753,6 +1761,8 @@ grub_err_t ventoy_cmd_linux_chain_data(grub_extcmd_context_t ctxt, int argc, cha
     disk = file->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
     chain->real_img_size_in_bytes = file->size;
     chain->virt_img_size_in_bytes = (file->size + 2047) / 2048 * 2048;
     chain->boot_catalog = boot_catlog;
@@ -1766,10 +1776,13 @@ grub_err_t ventoy_cmd_linux_chain_data(grub_extcmd_context_t ctxt, int argc, cha
     /* part 3: image chunk */
     chain->img_chunk_offset = sizeof(ventoy_chain_head);
     chain->img_chunk_num = g_img_chunk_list.cur_chunk;
-    grub_memcpy((char *)chain + chain->img_chunk_offset, g_img_chunk_list.chunk, img_chunk_size);
+    ventoy_img_chunk_data_fill(&g_img_chunk_list, (char *)chain + chain->img_chunk_offset, img_chunk_size);
+
+    ventoy_perf_add(vtoy_perf_cnt_chain_size, size);
 
     if (ventoy_compatible)
     {
+        ventoy_perf_end(vtoy_perf_linux_chain);
         return 0;
     }
 
@@ -1789,6 +1802,8 @@ grub_err_t ventoy_cmd_linux_chain_data(grub_extcmd_context_t ctxt, int argc, cha
         ventoy_linux_fill_virt_data(isosize, chain);
     }
 
+    ventoy_perf_end(vtoy_perf_linux_chain);
+
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
@@ -0,0 +1,166 @@
+/******************************************************************************
+ * ventoy_lz4.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef VTOY_LZ4_HOST
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+GRUB_MOD_LICENSE ("GPLv3+");
+#endif /* VTOY_LZ4_HOST, see vtoycli/lz4bench.c */
+
+/*
+ * Minimal LZ4 block format compressor for the compressed memdisk.
+ * Greedy single probe hash matching, no dictionary between blocks.
+ * It's much worse than lz4 -9 but fast enough to run while the image is
+ * being read from USB, and the output is a standard LZ4 block so any LZ4
+ * decoder can read it (Ventoy.efi has its own small one).
+ */
+
+#define LZ4_MINMATCH     4
+#define LZ4_LASTLITERALS 5
+#define LZ4_MFLIMIT      12
+#define LZ4_MAX_OFFSET   65535
+#define LZ4_HASH_LOG     12
+
+static grub_uint32_t g_lz4_table[1 << LZ4_HASH_LOG];
+
+static inline grub_uint32_t ventoy_lz4_read32(const grub_uint8_t *p)
+{
+    return grub_get_unaligned32(p);
+}
+
+static inline grub_uint32_t ventoy_lz4_hash(grub_uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static grub_uint8_t * ventoy_lz4_put_len(grub_uint8_t *op, grub_uint32_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (grub_uint8_t)len;
+
+    return op;
+}
+
+/* dst must have VTOY_LZ4_BOUND(srclen) bytes, return the compressed length */
+int ventoy_lz4_compress(const grub_uint8_t *src, int srclen, grub_uint8_t *dst)
+{
+    int ip = 0;
+    int ref = 0;
+    int anchor = 0;
+    int limit = 0;
+    int litlen = 0;
+    int matchlen = 0;
+    grub_uint32_t h;
+    grub_uint32_t seq;
+    grub_uint8_t *op = dst;
+    grub_uint8_t *token = NULL;
+
+    if (srclen > LZ4_MFLIMIT)
+    {
+        grub_memset(g_lz4_table, 0, sizeof(g_lz4_table));
+        g_lz4_table[ventoy_lz4_hash(ventoy_lz4_read32(src))] = 0;
+
+        limit = srclen - LZ4_MFLIMIT;
+        for (ip = 1; ip < limit; )
+        {
+            seq = ventoy_lz4_read32(src + ip);
+            h = ventoy_lz4_hash(seq);
+            ref = (int)g_lz4_table[h];
+            g_lz4_table[h] = (grub_uint32_t)ip;
+
+            if (ip - ref > LZ4_MAX_OFFSET || ventoy_lz4_read32(src + ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            matchlen = LZ4_MINMATCH;
+            while (ip + matchlen < srclen - LZ4_LASTLITERALS && src[ref + matchlen] == src[ip + matchlen])
+            {
+                matchlen++;
+            }
+
+            /* literals */
+            litlen = ip - anchor;
+            token = op++;
+            if (litlen >= 15)
+            {
+                *token = 15 << 4;
+                op = ventoy_lz4_put_len(op, litlen - 15);
+            }
+            else
+            {
+                *token = (grub_uint8_t)(litlen << 4);
+            }
+            grub_memcpy(op, src + anchor, litlen);
+            op += litlen;
+
+            /* match */
+            *op++ = (grub_uint8_t)((ip - ref) & 0xFF);
+            *op++ = (grub_uint8_t)((ip - ref) >> 8);
+            if (matchlen - LZ4_MINMATCH >= 15)
+            {
+                *token |= 15;
+                op = ventoy_lz4_put_len(op, matchlen - LZ4_MINMATCH - 15);
+            }
+            else
+            {
+                *token |= (grub_uint8_t)(matchlen - LZ4_MINMATCH);
+            }
+
+            ip += matchlen;
+            anchor = ip;
+        }
+    }
+
+    /* last literals */
+    litlen = srclen - anchor;
+    token = op++;
+    if (litlen >= 15)
+    {
+        *token = 15 << 4;
+        op = ventoy_lz4_put_len(op, litlen - 15);
+    }
+    else
+    {
+        *token = (grub_uint8_t)(litlen << 4);
+    }
+    grub_memcpy(op, src + anchor, litlen);
+    op += litlen;
+
+    return (int)(op - dst);
+}
@@ -0,0 +1,196 @@
+/******************************************************************************
+ * ventoy_perf.c
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <grub/types.h>
+#include <grub/misc.h>
+#include <grub/mm.h>
+#include <grub/err.h>
+#include <grub/dl.h>
+#include <grub/disk.h>
+#include <grub/device.h>
+#include <grub/term.h>
+#include <grub/partition.h>
+#include <grub/file.h>
+#include <grub/normal.h>
+#include <grub/extcmd.h>
+#include <grub/time.h>
+#include <grub/ventoy.h>
+#include "ventoy_def.h"
+
+GRUB_MOD_LICENSE ("GPLv3+");
+
+/*
+ * Phase timers and counters for the boot path.
+ * A phase is measured between ventoy_perf_begin/ventoy_perf_end with
+ * grub_get_time_ms. A phase that fails half way just doesn't call
+ * ventoy_perf_end, the next begin restart it and it's not counted.
+ * vt_perf_dump print all of them together with the disk read statistics
+ * kept by grub_disk_read, so it's easy to see where the time goes on a
+ * slow USB stick.
+ */
+
+typedef struct ventoy_perf_phase
+{
+    const char *name;
+    int running;
+    grub_uint32_t count;
+    grub_uint64_t start;
+    grub_uint64_t total;
+    grub_uint64_t max;
+    grub_uint64_t last;
+}ventoy_perf_phase;
+
+static ventoy_perf_phase g_perf_phase[vtoy_perf_phase_max] =
+{
+    { "list_img",       0, 0, 0, 0, 0, 0 },
+    { "load_plugin",    0, 0, 0, 0, 0, 0 },
+    { "get_block_list", 0, 0, 0, 0, 0, 0 },
+    { "linux_chain",    0, 0, 0, 0, 0, 0 },
+    { "windows_chain",  0, 0, 0, 0, 0, 0 },
+    { "wim_patch",      0, 0, 0, 0, 0, 0 },
+    { "load_cpio",      0, 0, 0, 0, 0, 0 },
+};
+
+static const char *g_perf_cnt_name[vtoy_perf_cnt_max] =
+{
+    "image",
+    "dir_read",
+    "img_chunk",
+    "chain_size",
+    "cpio_size",
+    "chunk_cache_hit",
+    "chunk_cache_miss",
+};
+
+static grub_uint64_t g_perf_cnt[vtoy_perf_cnt_max];
+
+void ventoy_perf_begin(int phase)
+{
+    if (phase < 0 || phase >= vtoy_perf_phase_max)
+    {
+        return;
+    }
+
+    g_perf_phase[phase].running = 1;
+    g_perf_phase[phase].start = grub_get_time_ms();
+}
+
+void ventoy_perf_end(int phase)
+{
+    grub_uint64_t cost;
+    ventoy_perf_phase *cur = NULL;
+
+    if (phase < 0 || phase >= vtoy_perf_phase_max || g_perf_phase[phase].running == 0)
+    {
+        return;
+    }
+
+    cur = g_perf_phase + phase;
+    cost = grub_get_time_ms() - cur->start;
+
+    cur->running = 0;
+    cur->count++;
+    cur->total += cost;
+    cur->last = cost;
+    if (cost > cur->max)
+    {
+        cur->max = cost;
+    }
+}
+
+void ventoy_perf_add(int counter, grub_uint64_t value)
+{
+    if (counter >= 0 && counter < vtoy_perf_cnt_max)
+    {
+        g_perf_cnt[counter] += value;
+    }
+}
+
+static int ventoy_perf_report(char *buf, int len)
+{
+    int i;
+    int pos = 0;
+
+    vtoy_len_ssprintf(buf, pos, len, "Ventoy %s boot performance (uptime %llums)\n\n",
+        ventoy_get_env("VENTOY_VERSION"), (ulonglong)grub_get_time_ms());
+
+    vtoy_len_ssprintf(buf, pos, len, "%-16s %8s %10s %10s %10s\n", "phase", "count", "total(ms)", "max(ms)", "last(ms)");
+    for (i = 0; i < vtoy_perf_phase_max; i++)
+    {
+        vtoy_len_ssprintf(buf, pos, len, "%-16s %8u %10llu %10llu %10llu\n",
+            g_perf_phase[i].name, g_perf_phase[i].count,
+            (ulonglong)g_perf_phase[i].total, (ulonglong)g_perf_phase[i].max,
+            (ulonglong)g_perf_phase[i].last);
+    }
+
+    vtoy_len_ssprintf(buf, pos, len, "\n");
+    for (i = 0; i < vtoy_perf_cnt_max; i++)
+    {
+        vtoy_len_ssprintf(buf, pos, len, "%-16s %llu\n", g_perf_cnt_name[i], (ulonglong)g_perf_cnt[i]);
+    }
+
+    vtoy_len_ssprintf(buf, pos, len, "\n");
+    vtoy_len_ssprintf(buf, pos, len, "%-16s %llu\n", "disk_read", (ulonglong)grub_disk_read_count);
+    vtoy_len_ssprintf(buf, pos, len, "%-16s %llu\n", "disk_read_bytes", (ulonglong)grub_disk_read_bytes);
+    vtoy_len_ssprintf(buf, pos, len, "%-16s %llu\n", "dev_read", (ulonglong)grub_disk_dev_read_count);
+    vtoy_len_ssprintf(buf, pos, len, "%-16s %llu\n", "dev_read_bytes", (ulonglong)grub_disk_dev_read_bytes);
+
+    return pos;
+}
+
+grub_err_t ventoy_cmd_perf_dump(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    int len;
+    char *buf = NULL;
+
+    (void)ctxt;
+
+    if (argc > 1)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s [file]", cmd_raw_name);
+    }
+
+    buf = grub_malloc(VTOY_PERF_BUF_SIZE);
+    if (!buf)
+    {
+        return grub_errno;
+    }
+
+    len = ventoy_perf_report(buf, VTOY_PERF_BUF_SIZE);
+    grub_printf("%s", buf);
+
+    if (argc == 1)
+    {
+        if (ventoy_file_overwrite(args[0], buf, (grub_uint32_t)len, VTOY_PERF_SAVE_MAX, '\n') == GRUB_ERR_NONE)
+        {
+            grub_printf("\nSaved to %s\n", args[0]);
+        }
+        else
+        {
+            grub_printf("\nFailed to save to %s: %s\n", args[0], grub_errmsg);
+            grub_errno = GRUB_ERR_NONE;
+        }
+    }
+
+    grub_refresh();
+    grub_free(buf);
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
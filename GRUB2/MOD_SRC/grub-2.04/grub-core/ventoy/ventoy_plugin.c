@@ -68,6 +68,37 @@ static char g_theme_single_file[256];
 static char g_cur_menu_language[32] = {0};
 static char g_push_menu_language[32] = {0};
 
+static int g_path_rule_num = 0;
+static grub_uint32_t g_path_hash_mask = 0;
+static plugin_path_rule **g_path_hash = NULL;
+static plugin_path_rule *g_path_rule_head = NULL;
+static plugin_path_rule *g_path_rule_tail = NULL;
+static plugin_path_rule *g_path_wild_head[plugin_path_type_max];
+static plugin_path_rule *g_path_wild_tail[plugin_path_type_max];
+
+static const int g_path_type_mode[plugin_path_type_max] =
+{
+    VTOY_PATH_MATCH_STRCMP,  /* alias_file */
+    VTOY_PATH_MATCH_STRCMP,  /* alias_dir */
+    VTOY_PATH_MATCH_STRCMP,  /* tip_file */
+    VTOY_PATH_MATCH_STRCMP,  /* tip_dir */
+    VTOY_PATH_MATCH_SUBSTR,  /* class_key */
+    VTOY_PATH_MATCH_PARENT,  /* class_parent */
+    VTOY_PATH_MATCH_EXACT,   /* class_dir */
+    VTOY_PATH_MATCH_STRNCMP, /* image_list_file */
+    VTOY_PATH_MATCH_PREFIX,  /* image_list_dir */
+    VTOY_PATH_MATCH_STRCMP,  /* persistence */
+    VTOY_PATH_MATCH_STRCMP,  /* install_file */
+    VTOY_PATH_MATCH_PARENT,  /* install_parent */
+    VTOY_PATH_MATCH_STRCMP,  /* injection_file */
+    VTOY_PATH_MATCH_PARENT,  /* injection_parent */
+    VTOY_PATH_MATCH_STRNCMP, /* memdisk */
+    VTOY_PATH_MATCH_STRNCMP, /* conf_replace */
+    VTOY_PATH_MATCH_STRNCMP, /* dud */
+    VTOY_PATH_MATCH_STRNCMP, /* pwd_file */
+    VTOY_PATH_MATCH_PARENT,  /* pwd_parent */
+};
+
 static int ventoy_plugin_is_parent(const char *pat, int patlen, const char *isopath)
 {
     if (patlen > 1)
@@ -2398,6 +2429,381 @@ static int ventoy_plugin_image_list_check(VTOY_JSON *json, const char *isodisk)
     return 0;
 }
 
+/*
+ * Plugin path index
+ *
+ * All the path keyed plugin lists are compiled into one hash table after
+ * ventoy.json is parsed, so that a lookup during image enumeration does not
+ * walk every list any more.
+ * Rules without '*' are found by hash (for parent rules the key is the
+ * directory of the image path, for image_list directory lookup every
+ * directory prefix of the rule is added).
+ * Rules with '*' (and the menu_class key sub string rules) can not be
+ * hashed, they are kept in a per type list in the original order and only
+ * those before the best hash hit are checked, so the first match in list
+ * order is still returned.
+ */
+static grub_uint32_t ventoy_plugin_path_hash(int type, const char *key, int len)
+{
+    int i;
+    grub_uint32_t hash = 2166136261U ^ (grub_uint32_t)type;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (grub_uint8_t)key[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static int ventoy_plugin_path_new_rule(int type, int order, const char *key, int keylen, int wild, void *data)
+{
+    plugin_path_rule *rule = NULL;
+
+    rule = grub_zalloc(sizeof(plugin_path_rule));
+    if (!rule)
+    {
+        return 1;
+    }
+
+    rule->type = type;
+    rule->mode = g_path_type_mode[type];
+    rule->wild = wild;
+    rule->order = order;
+    rule->key = key;
+    rule->keylen = keylen;
+    rule->data = data;
+
+    if (g_path_rule_tail)
+    {
+        g_path_rule_tail->next = rule;
+    }
+    else
+    {
+        g_path_rule_head = rule;
+    }
+    g_path_rule_tail = rule;
+    g_path_rule_num++;
+
+    return 0;
+}
+
+static int ventoy_plugin_path_add(int type, int order, const char *key, void *data)
+{
+    int i;
+    int wild = 0;
+    int mode = g_path_type_mode[type];
+    int keylen = (int)grub_strlen(key);
+
+    if (mode == VTOY_PATH_MATCH_SUBSTR)
+    {
+        wild = 1;
+    }
+    else if (mode != VTOY_PATH_MATCH_EXACT && grub_strchr(key, '*'))
+    {
+        wild = 1;
+    }
+
+    if (mode == VTOY_PATH_MATCH_PREFIX && wild == 0)
+    {
+        /* every "/xxx/" directory prefix of the rule */
+        for (i = 0; i < keylen - 1; i++)
+        {
+            if (key[i] == '/')
+            {
+                ventoy_plugin_path_new_rule(type, order, key, i + 1, 0, data);
+            }
+        }
+        return 0;
+    }
+
+    return ventoy_plugin_path_new_rule(type, order, key, keylen, wild, data);
+}
+
+static int ventoy_plugin_path_match(plugin_path_rule *rule, const char *path, int len)
+{
+    switch (rule->mode)
+    {
+        case VTOY_PATH_MATCH_EXACT:
+            return (rule->keylen == len && grub_strncmp(path, rule->key, len) == 0);
+        case VTOY_PATH_MATCH_STRCMP:
+            return (rule->keylen == len && ventoy_strcmp(rule->key, path) == 0);
+        case VTOY_PATH_MATCH_STRNCMP:
+            return (rule->keylen == len && ventoy_strncmp(rule->key, path, len) == 0);
+        case VTOY_PATH_MATCH_PARENT:
+            return (rule->keylen < len && ventoy_plugin_is_parent(rule->key, rule->keylen, path));
+        case VTOY_PATH_MATCH_PREFIX:
+            return (len < rule->keylen && ventoy_strncmp(rule->key, path, len) == 0);
+        case VTOY_PATH_MATCH_SUBSTR:
+            return (rule->keylen < len && grub_strstr(path, rule->key));
+        default:
+            return 0;
+    }
+}
+
+static void ventoy_plugin_path_index_free(void)
+{
+    int i;
+    plugin_path_rule *rule = NULL;
+    plugin_path_rule *next = NULL;
+
+    for (rule = g_path_rule_head; rule; rule = next)
+    {
+        next = rule->next;
+        grub_free(rule);
+    }
+
+    grub_check_free(g_path_hash);
+    g_path_hash_mask = 0;
+    g_path_rule_num = 0;
+    g_path_rule_head = g_path_rule_tail = NULL;
+
+    for (i = 0; i < plugin_path_type_max; i++)
+    {
+        g_path_wild_head[i] = g_path_wild_tail[i] = NULL;
+    }
+}
+
+static int ventoy_plugin_path_index_build(void)
+{
+    int order;
+    grub_uint32_t size;
+    grub_uint32_t hash;
+    plugin_path_rule *rule = NULL;
+    menu_alias *alias = NULL;
+    menu_tip *tip = NULL;
+    menu_class *class = NULL;
+    image_list *imglist = NULL;
+    persistence_config *persist = NULL;
+    install_template *install = NULL;
+    injection_config *injection = NULL;
+    auto_memdisk *memdisk = NULL;
+    conf_replace *confreplace = NULL;
+    dud *dudnode = NULL;
+    menu_password *pwd = NULL;
+
+    ventoy_plugin_path_index_free();
+
+    for (order = 0, alias = g_menu_alias_head; alias; alias = alias->next, order++)
+    {
+        if (alias->pathlen)
+        {
+            ventoy_plugin_path_add((alias->type == vtoy_alias_image_file) ? plugin_path_alias_file : plugin_path_alias_dir,
+                                   order, alias->isopath, alias);
+        }
+    }
+
+    for (order = 0, tip = g_menu_tip_head; tip; tip = tip->next, order++)
+    {
+        if (tip->pathlen)
+        {
+            ventoy_plugin_path_add((tip->type == vtoy_tip_image_file) ? plugin_path_tip_file : plugin_path_tip_dir,
+                                   order, tip->isopath, tip);
+        }
+    }
+
+    for (order = 0, class = g_menu_class_head; class; class = class->next, order++)
+    {
+        if (class->type == vtoy_class_image_file)
+        {
+            ventoy_plugin_path_add(class->parent ? plugin_path_class_parent : plugin_path_class_key,
+                                   order, class->pattern, class);
+        }
+        else
+        {
+            ventoy_plugin_path_add(plugin_path_class_dir, order, class->pattern, class);
+        }
+    }
+
+    for (order = 0, imglist = g_image_list_head; imglist; imglist = imglist->next, order++)
+    {
+        ventoy_plugin_path_add(plugin_path_image_list_file, order, imglist->isopath, imglist);
+        ventoy_plugin_path_add(plugin_path_image_list_dir, order, imglist->isopath, imglist);
+    }
+
+    for (order = 0, persist = g_persistence_head; persist; persist = persist->next, order++)
+    {
+        ventoy_plugin_path_add(plugin_path_persistence, order, persist->isopath, persist);
+    }
+
+    for (order = 0, install = g_install_template_head; install; install = install->next, order++)
+    {
+        ventoy_plugin_path_add((install->type == auto_install_type_file) ? plugin_path_install_file : plugin_path_install_parent,
+                               order, install->isopath, install);
+    }
+
+    for (order = 0, injection = g_injection_head; injection; injection = injection->next, order++)
+    {
+        ventoy_plugin_path_add((injection->type == injection_type_file) ? plugin_path_injection_file : plugin_path_injection_parent,
+                               order, injection->isopath, injection);
+    }
+
+    for (order = 0, memdisk = g_auto_memdisk_head; memdisk; memdisk = memdisk->next, order++)
+    {
+        ventoy_plugin_path_add(plugin_path_memdisk, order, memdisk->isopath, memdisk);
+    }
+
+    for (order = 0, confreplace = g_conf_replace_head; confreplace; confreplace = confreplace->next, order++)
+    {
+        ventoy_plugin_path_add(plugin_path_conf_replace, order, confreplace->isopath, confreplace);
+    }
+
+    for (order = 0, dudnode = g_dud_head; dudnode; dudnode = dudnode->next, order++)
+    {
+        ventoy_plugin_path_add(plugin_path_dud, order, dudnode->isopath, dudnode);
+    }
+
+    for (order = 0, pwd = g_pwd_head; pwd; pwd = pwd->next, order++)
+    {
+        ventoy_plugin_path_add((pwd->type == vtoy_menu_pwd_file) ? plugin_path_pwd_file : plugin_path_pwd_parent,
+                               order, pwd->isopath, pwd);
+    }
+
+    for (size = 64; size < (grub_uint32_t)g_path_rule_num; size <<= 1)
+        ;
+
+    g_path_hash = grub_zalloc(size * sizeof(plugin_path_rule *));
+    if (g_path_hash)
+    {
+        g_path_hash_mask = size - 1;
+    }
+
+    for (rule = g_path_rule_head; rule; rule = rule->next)
+    {
+        if (rule->wild)
+        {
+            if (g_path_wild_tail[rule->type])
+            {
+                g_path_wild_tail[rule->type]->wnext = rule;
+            }
+            else
+            {
+                g_path_wild_head[rule->type] = rule;
+            }
+            g_path_wild_tail[rule->type] = rule;
+        }
+        else if (g_path_hash)
+        {
+            hash = ventoy_plugin_path_hash(rule->type, rule->key, rule->keylen) & g_path_hash_mask;
+            rule->hnext = g_path_hash[hash];
+            g_path_hash[hash] = rule;
+        }
+    }
+
+    debug("plugin path index: %d rules, %u buckets\n", g_path_rule_num, g_path_hash ? size : 0);
+    return 0;
+}
+
+static void ventoy_plugin_path_keep(plugin_path_rule **rules, int *num, int max, plugin_path_rule *rule)
+{
+    int i;
+
+    if (*num == max && rule->order >= rules[max - 1]->order)
+    {
+        return;
+    }
+
+    i = (*num < max) ? (*num)++ : max - 1;
+    while (i > 0 && rules[i - 1]->order > rule->order)
+    {
+        rules[i] = rules[i - 1];
+        i--;
+    }
+    rules[i] = rule;
+}
+
+/* find at most max matched rules of the type, sorted by the plugin list order */
+static int ventoy_plugin_path_find_all(int type, const char *path, plugin_path_rule **rules, int max)
+{
+    int n = 0;
+    int hash = 1;
+    int len;
+    int keylen;
+    const char *key = path;
+    const char *pos = NULL;
+    plugin_path_rule *rule = NULL;
+
+    len = keylen = (int)grub_strlen(path);
+
+    if (g_path_type_mode[type] == VTOY_PATH_MATCH_PARENT)
+    {
+        /* parent rule is the directory of the image, "/" for the root */
+        pos = grub_strrchr(path, '/');
+        if (pos && pos > path)
+        {
+            keylen = (int)(pos - path);
+            if (keylen == 1)
+            {
+                hash = 0; /* "//xxx" never match a parent rule */
+            }
+        }
+        else if (len > 1)
+        {
+            key = "/";
+            keylen = 1;
+        }
+        else
+        {
+            hash = 0; /* parent rule can not match the root itself */
+        }
+    }
+
+    if (hash == 0)
+    {
+        /* only wildcard rules need to be checked */
+    }
+    else if (g_path_hash)
+    {
+        rule = g_path_hash[ventoy_plugin_path_hash(type, key, keylen) & g_path_hash_mask];
+        for (; rule; rule = rule->hnext)
+        {
+            if (rule->type == type && rule->keylen == keylen && grub_memcmp(rule->key, key, keylen) == 0)
+            {
+                ventoy_plugin_path_keep(rules, &n, max, rule);
+            }
+        }
+    }
+    else
+    {
+        for (rule = g_path_rule_head; rule; rule = rule->next)
+        {
+            if (rule->type == type && rule->wild == 0 &&
+                rule->keylen == keylen && grub_memcmp(rule->key, key, keylen) == 0)
+            {
+                ventoy_plugin_path_keep(rules, &n, max, rule);
+            }
+        }
+    }
+
+    for (rule = g_path_wild_head[type]; rule; rule = rule->wnext)
+    {
+        if (n == max && rule->order >= rules[max - 1]->order)
+        {
+            break;
+        }
+
+        if (ventoy_plugin_path_match(rule, path, len))
+        {
+            ventoy_plugin_path_keep(rules, &n, max, rule);
+        }
+    }
+
+    return n;
+}
+
+static void * ventoy_plugin_path_find(int type, const char *path)
+{
+    plugin_path_rule *rule = NULL;
+
+    if (ventoy_plugin_path_find_all(type, path, &rule, 1) == 0)
+    {
+        return NULL;
+    }
+
+    return rule->data;
+}
+
 static plugin_entry g_plugin_entries[] =
 {
     { "control", ventoy_plugin_control_entry, ventoy_plugin_control_check, 0 },
@@ -2475,6 +2881,8 @@ grub_err_t ventoy_cmd_load_plugin(grub_extcmd_context_t ctxt, int argc, char **a
     grub_env_set("VTOY_TIP_COLOR", "blue");
     grub_env_set("VTOY_TIP_ALIGN", "left");
 
+    ventoy_perf_begin(vtoy_perf_load_plugin);
+
     file = ventoy_grub_file_open(GRUB_FILE_TYPE_LINUX_INITRD, "%s/ventoy/ventoy.json", args[0]);
     if (!file)
     {
@@ -2531,10 +2939,14 @@ grub_err_t ventoy_cmd_load_plugin(grub_extcmd_context_t ctxt, int argc, char **a
 
     ventoy_parse_plugin_config(json->pstChild, args[0]);
 
+    ventoy_plugin_path_index_build();
+
     vtoy_json_destroy(json);
 
     grub_free(buf);
 
+    ventoy_perf_end(vtoy_perf_load_plugin);
+
     if (g_boot_pwd.type)
     {
         grub_printf("\n\n======= %s ======\n\n", grub_env_get("VTOY_TEXT_MENU_VER"));
@@ -2624,7 +3036,6 @@ void ventoy_plugin_dump_persistence(void)
 
 install_template * ventoy_plugin_find_install_template(const char *isopath)
 {
-    int len;
     install_template *node = NULL;
 
     if (!g_install_template_head)
@@ -2632,30 +3043,13 @@ install_template * ventoy_plugin_find_install_template(const char *isopath)
         return NULL;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_install_template_head; node; node = node->next)
-    {
-        if (node->type == auto_install_type_file)
-        {
-            if (node->pathlen == len && ventoy_strcmp(node->isopath, isopath) == 0)
-            {
-                return node;
-            }
-        }
-    }
-
-    for (node = g_install_template_head; node; node = node->next)
+    node = ventoy_plugin_path_find(plugin_path_install_file, isopath);
+    if (!node)
     {
-        if (node->type == auto_install_type_parent)
-        {
-            if (node->pathlen < len && ventoy_plugin_is_parent(node->isopath, node->pathlen, isopath))
-            {
-                return node;
-            }
-        }
+        node = ventoy_plugin_path_find(plugin_path_install_parent, isopath);
     }
 
-    return NULL;
+    return node;
 }
 
 char * ventoy_plugin_get_cur_install_template(const char *isopath, install_template **cur)
@@ -2688,24 +3082,12 @@ char * ventoy_plugin_get_cur_install_template(const char *isopath, install_templ
 
 persistence_config * ventoy_plugin_find_persistent(const char *isopath)
 {
-    int len;
-    persistence_config *node = NULL;
-
     if (!g_persistence_head)
     {
         return NULL;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_persistence_head; node; node = node->next)
-    {
-        if ((len == node->pathlen) && (ventoy_strcmp(node->isopath, isopath) == 0))
-        {
-            return node;
-        }
-    }
-
-    return NULL;
+    return ventoy_plugin_path_find(plugin_path_persistence, isopath);
 }
 
 int ventoy_plugin_get_persistent_chunklist(const char *isopath, int index, ventoy_img_chunk_list *chunk_list)
@@ -2740,7 +3122,7 @@ int ventoy_plugin_get_persistent_chunklist(const char *isopath, int index, vento
         len = grub_strlen(path);
         if (len > 9 && grub_strncmp(path + len - 9, ".vlnk.dat", 9) == 0)
         {
-            ventoy_add_vlnk_file(NULL, path);
+            ventoy_add_vlnk_file(NULL, path, NULL);
             node->backendpath[index].vlnk_add = 1;
         }
     }
@@ -2763,9 +3145,8 @@ int ventoy_plugin_get_persistent_chunklist(const char *isopath, int index, vento
     chunk_list->cur_chunk = 0;
 
     start = file->device->disk->partition->start;
-    ventoy_get_block_list(file, chunk_list, start);
 
-    if (0 != ventoy_check_block_list(file, chunk_list, start, NULL, 0))
+    if (0 != ventoy_get_block_list_cached(file, chunk_list, start, NULL, 0))
     {
         grub_free(chunk_list->chunk);
         chunk_list->chunk = NULL;
@@ -2783,7 +3164,6 @@ end:
 
 const char * ventoy_plugin_get_injection(const char *isopath)
 {
-    int len;
     injection_config *node = NULL;
 
     if (!g_injection_head)
@@ -2791,35 +3171,17 @@ const char * ventoy_plugin_get_injection(const char *isopath)
         return NULL;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_injection_head; node; node = node->next)
-    {
-        if (node->type == injection_type_file)
-        {
-            if (node->pathlen == len && ventoy_strcmp(node->isopath, isopath) == 0)
-            {
-                return node->archive;
-            }
-        }
-    }
-
-    for (node = g_injection_head; node; node = node->next)
+    node = ventoy_plugin_path_find(plugin_path_injection_file, isopath);
+    if (!node)
     {
-        if (node->type == injection_type_parent)
-        {
-            if (node->pathlen < len && ventoy_plugin_is_parent(node->isopath, node->pathlen, isopath))
-            {
-                return node->archive;
-            }
-        }
+        node = ventoy_plugin_path_find(plugin_path_injection_parent, isopath);
     }
 
-    return NULL;
+    return node ? node->archive : NULL;
 }
 
 const char * ventoy_plugin_get_menu_alias(int type, const char *isopath)
 {
-    int len;
     menu_alias *node = NULL;
 
     if (!g_menu_alias_head)
@@ -2827,46 +3189,23 @@ const char * ventoy_plugin_get_menu_alias(int type, const char *isopath)
         return NULL;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_menu_alias_head; node; node = node->next)
-    {
-        if (node->type == type && node->pathlen &&
-            node->pathlen == len && ventoy_strcmp(node->isopath, isopath) == 0)
-        {
-            return node->alias;
-        }
-    }
+    node = ventoy_plugin_path_find((type == vtoy_alias_image_file) ? plugin_path_alias_file : plugin_path_alias_dir, isopath);
 
-    return NULL;
+    return node ? node->alias : NULL;
 }
 
 const menu_tip * ventoy_plugin_get_menu_tip(int type, const char *isopath)
 {
-    int len;
-    menu_tip *node = NULL;
-
     if (!g_menu_tip_head)
     {
         return NULL;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_menu_tip_head; node; node = node->next)
-    {
-        if (node->type == type && node->pathlen &&
-            node->pathlen == len && ventoy_strcmp(node->isopath, isopath) == 0)
-        {
-            return node;
-        }
-    }
-
-    return NULL;
+    return ventoy_plugin_path_find((type == vtoy_tip_image_file) ? plugin_path_tip_file : plugin_path_tip_dir, isopath);
 }
 
 const char * ventoy_plugin_get_menu_class(int type, const char *name, const char *path)
 {
-    int namelen;
-    int pathlen;
     menu_class *node = NULL;
 
     if (!g_menu_class_head)
@@ -2874,55 +3213,21 @@ const char * ventoy_plugin_get_menu_class(int type, const char *name, const char
         return NULL;
     }
 
-    namelen = (int)grub_strlen(name);
-    pathlen = (int)grub_strlen(path);
-
     if (vtoy_class_image_file == type)
     {
-        for (node = g_menu_class_head; node; node = node->next)
-        {
-            if (node->type != type)
-            {
-                continue;
-            }
-
-            if (node->parent == 0)
-            {
-                if ((node->patlen < namelen) && grub_strstr(name, node->pattern))
-                {
-                    return node->class;
-                }
-            }
-        }
-
-        for (node = g_menu_class_head; node; node = node->next)
+        /* key rules always take precedence over parent rules */
+        node = ventoy_plugin_path_find(plugin_path_class_key, name);
+        if (!node)
         {
-            if (node->type != type)
-            {
-                continue;
-            }
-
-            if (node->parent)
-            {
-                if ((node->patlen < pathlen) && ventoy_plugin_is_parent(node->pattern, node->patlen, path))
-                {
-                    return node->class;
-                }
-            }
+            node = ventoy_plugin_path_find(plugin_path_class_parent, path);
         }
     }
     else
     {
-        for (node = g_menu_class_head; node; node = node->next)
-        {
-            if (node->type == type && node->patlen == namelen && grub_strncmp(name, node->pattern, namelen) == 0)
-            {
-                return node->class;
-            }
-        }
+        node = ventoy_plugin_path_find(plugin_path_class_dir, name);
     }
 
-    return NULL;
+    return node ? node->class : NULL;
 }
 
 int ventoy_plugin_add_custom_boot(const char *vcfgpath)
@@ -3017,83 +3322,56 @@ grub_err_t ventoy_cmd_dump_custom_boot(grub_extcmd_context_t ctxt, int argc, cha
 
 int ventoy_plugin_check_memdisk(const char *isopath)
 {
-    int len;
-    auto_memdisk *node = NULL;
-
     if (!g_auto_memdisk_head)
     {
         return 0;
     }
 
-    len = (int)grub_strlen(isopath);
-    for (node = g_auto_memdisk_head; node; node = node->next)
-    {
-        if (node->pathlen == len && ventoy_strncmp(node->isopath, isopath, len) == 0)
-        {
-            return 1;
-        }
-    }
-
-    return 0;
+    return ventoy_plugin_path_find(plugin_path_memdisk, isopath) ? 1 : 0;
 }
 
 int ventoy_plugin_get_image_list_index(int type, const char *name)
 {
-    int len;
-    int index = 1;
-    image_list *node = NULL;
+    plugin_path_rule *rule = NULL;
 
     if (!g_image_list_head)
     {
         return 0;
     }
 
-    len = (int)grub_strlen(name);
+    if (vtoy_class_directory == type)
+    {
+        type = plugin_path_image_list_dir;
+    }
+    else
+    {
+        type = plugin_path_image_list_file;
+    }
 
-    for (node = g_image_list_head; node; node = node->next, index++)
+    if (ventoy_plugin_path_find_all(type, name, &rule, 1) == 0)
     {
-        if (vtoy_class_directory == type)
-        {
-            if (len < node->pathlen && ventoy_strncmp(node->isopath, name, len) == 0)
-            {
-                return index;
-            }
-        }
-        else
-        {
-            if (len == node->pathlen && ventoy_strncmp(node->isopath, name, len) == 0)
-            {
-                return index;
-            }
-        }
+        return 0;
     }
 
-    return 0;
+    /* index start from 1 */
+    return rule->order + 1;
 }
 
 int ventoy_plugin_find_conf_replace(const char *iso, conf_replace *nodes[VTOY_MAX_CONF_REPLACE])
 {
+    int i;
     int n = 0;
-    int len;
-    conf_replace *node;
+    plugin_path_rule *rules[VTOY_MAX_CONF_REPLACE];
 
     if (!g_conf_replace_head)
     {
         return 0;
     }
 
-    len = (int)grub_strlen(iso);
-
-    for (node = g_conf_replace_head; node; node = node->next)
+    n = ventoy_plugin_path_find_all(plugin_path_conf_replace, iso, rules, VTOY_MAX_CONF_REPLACE);
+    for (i = 0; i < n; i++)
     {
-        if (node->pathlen == len && ventoy_strncmp(node->isopath, iso, len) == 0)
-        {
-            nodes[n++] = node;
-            if (n >= VTOY_MAX_CONF_REPLACE)
-            {
-                return n;
-            }
-        }
+        nodes[i] = (conf_replace *)rules[i]->data;
     }
 
     return n;
@@ -3101,24 +3379,12 @@ int ventoy_plugin_find_conf_replace(const char *iso, conf_replace *nodes[VTOY_MA
 
 dud * ventoy_plugin_find_dud(const char *iso)
 {
-    int len;
-    dud *node;
-
     if (!g_dud_head)
     {
         return NULL;
     }
 
-    len = (int)grub_strlen(iso);
-    for (node = g_dud_head; node; node = node->next)
-    {
-        if (node->pathlen == len && ventoy_strncmp(node->isopath, iso, len) == 0)
-        {
-            return node;
-        }
-    }
-
-    return NULL;
+    return ventoy_plugin_path_find(plugin_path_dud, iso);
 }
 
 int ventoy_plugin_load_dud(dud *node, const char *isopart)
@@ -3155,7 +3421,6 @@ int ventoy_plugin_load_dud(dud *node, const char *isopart)
 static const vtoy_password * ventoy_plugin_get_password(const char *isopath)
 {
     int i;
-    int len;
     const char *pos = NULL;
     menu_password *node = NULL;
 
@@ -3166,27 +3431,15 @@ static const vtoy_password * ventoy_plugin_get_password(const char *isopath)
 
     if (g_pwd_head)
     {
-        len = (int)grub_strlen(isopath);
-        for (node = g_pwd_head; node; node = node->next)
+        node = ventoy_plugin_path_find(plugin_path_pwd_file, isopath);
+        if (!node)
         {
-            if (node->type == vtoy_menu_pwd_file)
-            {
-                if (node->pathlen == len && ventoy_strncmp(node->isopath, isopath, len) == 0)
-                {
-                    return &(node->password);
-                }
-            }
+            node = ventoy_plugin_path_find(plugin_path_pwd_parent, isopath);
         }
 
-        for (node = g_pwd_head; node; node = node->next)
+        if (node)
         {
-            if (node->type == vtoy_menu_pwd_parent)
-            {
-                if (node->pathlen < len && ventoy_plugin_is_parent(node->isopath, node->pathlen, isopath))
-                {
-                    return &(node->password);
-                }
-            }
+            return &(node->password);
         }
     }
 
@@ -1227,6 +1227,8 @@ grub_err_t ventoy_cmd_unix_chain_data(grub_extcmd_context_t ctxt, int argc, char
     disk = file->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
     chain->real_img_size_in_bytes = file->size;
     chain->virt_img_size_in_bytes = (file->size + 2047) / 2048 * 2048;
     chain->boot_catalog = boot_catlog;
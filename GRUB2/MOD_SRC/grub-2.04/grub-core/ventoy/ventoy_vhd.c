@@ -730,6 +730,8 @@ grub_err_t ventoy_cmd_raw_chain_data(grub_extcmd_context_t ctxt, int argc, char
     disk = file->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
 
     chain->real_img_size_in_bytes = file->size;
     if (g_img_trim_head_secnum > 0)
@@ -752,3 +754,107 @@ grub_err_t ventoy_cmd_raw_chain_data(grub_extcmd_context_t ctxt, int argc, char
     
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
+
+/*
+ * Build the vdisk chain for VDiskChain streaming mode, so the uncompressed
+ * vdisk is read from the ventoy disk on demand instead of loaded to memory.
+ * vt_img_sector must be called for the file first, then:
+ *   vt_vdisk_chain_data "${vdisk}"
+ *   chainloader vdiskchain_${VTOY_EFI_ARCH}.efi vdisk_chain=${vtoy_chain_mem_addr}
+ */
+grub_err_t ventoy_cmd_vdisk_chain_data(grub_extcmd_context_t ctxt, int argc, char **args)
+{
+    grub_uint32_t i = 0;
+    grub_uint32_t size = 0;
+    grub_uint32_t secnum = 0;
+    grub_file_t file;
+    grub_disk_t disk;
+    const char *pLastChain = NULL;
+    vdisk_chunk *chunk = NULL;
+    vdisk_chain_head *chain = NULL;
+    ventoy_img_chunk *img_chunk = NULL;
+
+    (void)ctxt;
+
+    if (argc != 1)
+    {
+        return grub_error(GRUB_ERR_BAD_ARGUMENT, "Usage: %s {file}", cmd_raw_name);
+    }
+
+    if (NULL == g_img_chunk_list.chunk || g_img_chunk_list.cur_chunk == 0)
+    {
+        grub_printf("ventoy not ready\n");
+        return 1;
+    }
+
+    if (g_img_trim_head_secnum > 0)
+    {
+        ventoy_raw_trim_head(g_img_trim_head_secnum);
+    }
+
+    file = ventoy_grub_file_open(VENTOY_FILE_TYPE, "%s", args[0]);
+    if (!file)
+    {
+        return 1;
+    }
+
+    size = sizeof(vdisk_chain_head) + g_img_chunk_list.cur_chunk * sizeof(vdisk_chunk);
+
+    pLastChain = grub_env_get("vtoy_chain_mem_addr");
+    if (pLastChain)
+    {
+        chain = (vdisk_chain_head *)grub_strtoul(pLastChain, NULL, 16);
+        if (chain)
+        {
+            debug("free last chain memory %p\n", chain);
+            grub_free(chain);
+        }
+    }
+
+    chain = ventoy_alloc_chain(size);
+    if (!chain)
+    {
+        grub_printf("Failed to alloc vdisk chain memory size %u\n", size);
+        grub_file_close(file);
+        return 1;
+    }
+
+    ventoy_memfile_env_set("vtoy_chain_mem", chain, (ulonglong)size);
+
+    grub_env_export("vtoy_chain_mem_addr");
+    grub_env_export("vtoy_chain_mem_size");
+
+    grub_memset(chain, 0, size);
+
+    /* VDiskChain finds the ventoy disk by these */
+    disk = file->device->disk;
+    ventoy_get_disk_guid(file->name, chain->disk_guid, chain->disk_signature);
+    chain->disk_size = disk->total_sectors * (1 << disk->log_sector_size);
+    chain->disk_sector_size = (1 << disk->log_sector_size);
+
+    chain->vdisk_size = file->size;
+    if (g_img_trim_head_secnum > 0)
+    {
+        chain->vdisk_size -= g_img_trim_head_secnum * 512;
+    }
+
+    chain->chunk_offset = sizeof(vdisk_chain_head);
+    chain->chunk_num = g_img_chunk_list.cur_chunk;
+
+    chunk = (vdisk_chunk *)((char *)chain + chain->chunk_offset);
+    for (i = 0; i < g_img_chunk_list.cur_chunk; i++)
+    {
+        img_chunk = g_img_chunk_list.chunk + i;
+        secnum = (grub_uint32_t)(img_chunk->disk_end_sector + 1 - img_chunk->disk_start_sector);
+
+        chunk[i].vdisk_start_sector = (grub_uint64_t)img_chunk->img_start_sector * 4;
+        chunk[i].vdisk_end_sector = chunk[i].vdisk_start_sector + ((grub_uint64_t)secnum << (disk->log_sector_size - 9)) - 1;
+        chunk[i].disk_start_sector = img_chunk->disk_start_sector;
+    }
+
+    debug("vdisk chain size:%llu chunk:%u\n", (ulonglong)chain->vdisk_size, chain->chunk_num);
+
+    grub_file_close(file);
+
+    VENTOY_CMD_RETURN(GRUB_ERR_NONE);
+}
@@ -1486,6 +1486,8 @@ grub_err_t ventoy_cmd_locate_wim_patch(grub_extcmd_context_t ctxt, int argc, cha
     (void)argc;
     (void)args;
 
+    ventoy_perf_begin(vtoy_perf_wim_patch);
+
     datalen = ventoy_get_windows_rtdata_len(args[1], &dataflag);
 
     while (node)
@@ -1500,6 +1502,7 @@ grub_err_t ventoy_cmd_locate_wim_patch(grub_extcmd_context_t ctxt, int argc, cha
         node = node->next;
     }
 
+    ventoy_perf_end(vtoy_perf_wim_patch);
     return 0;
 }
 
@@ -2112,6 +2115,8 @@ grub_err_t ventoy_cmd_windows_chain_data(grub_extcmd_context_t ctxt, int argc, c
 
     debug("chain data begin <%s> ...\n", args[0]);
 
+    ventoy_perf_begin(vtoy_perf_windows_chain);
+
     compatible = grub_env_get("ventoy_compatible");
     if (compatible && compatible[0] == 'Y')
     {
@@ -2217,6 +2222,8 @@ grub_err_t ventoy_cmd_windows_chain_data(grub_extcmd_context_t ctxt, int argc, c
     disk = file->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
     chain->real_img_size_in_bytes = file->size;
     chain->virt_img_size_in_bytes = (file->size + 2047) / 2048 * 2048;
     chain->boot_catalog = boot_catlog;
@@ -2232,6 +2239,8 @@ grub_err_t ventoy_cmd_windows_chain_data(grub_extcmd_context_t ctxt, int argc, c
     chain->img_chunk_num = g_img_chunk_list.cur_chunk;
     grub_memcpy((char *)chain + chain->img_chunk_offset, g_img_chunk_list.chunk, img_chunk_size);
 
+    ventoy_perf_add(vtoy_perf_cnt_chain_size, size);
+
     if (ventoy_compatible || unknown_image)
     {
         if (g_suppress_wincd_override_offset > 0)
@@ -2241,11 +2250,13 @@ grub_err_t ventoy_cmd_windows_chain_data(grub_extcmd_context_t ctxt, int argc, c
             ventoy_fill_suppress_wincd_override_data((char *)chain + chain->override_chunk_offset);
         }
 
+        ventoy_perf_end(vtoy_perf_windows_chain);
         return 0;
     }
 
     if (0 == g_wim_valid_patch_count)
     {
+        ventoy_perf_end(vtoy_perf_windows_chain);
         return 0;
     }
 
@@ -2272,6 +2283,8 @@ grub_err_t ventoy_cmd_windows_chain_data(grub_extcmd_context_t ctxt, int argc, c
         ventoy_windows_drive_map(chain, file->vlnk);        
     }
 
+    ventoy_perf_end(vtoy_perf_windows_chain);
+
     VENTOY_CMD_RETURN(GRUB_ERR_NONE);
 }
 
@@ -2502,6 +2515,8 @@ static grub_err_t ventoy_vlnk_wim_chain_data(grub_file_t wimfile)
     disk = wimfile->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
     chain->real_img_size_in_bytes = ventoy_align_2k(file->size) + ventoy_align_2k(wimsize);
     chain->virt_img_size_in_bytes = chain->real_img_size_in_bytes;
     chain->boot_catalog = boot_catlog;
@@ -2663,6 +2678,8 @@ static grub_err_t ventoy_normal_wim_chain_data(grub_file_t wimfile)
     disk = file->device->disk;
     chain->disk_drive = disk->id;
     chain->disk_sector_size = (1 << disk->log_sector_size);
+    chain->uefi_cache_size = ventoy_get_uefi_cache_size();
+    chain->io_trace_num = ventoy_get_uefi_io_trace_num();
     chain->real_img_size_in_bytes = ventoy_align_2k(file->size) + ventoy_align_2k(wimsize);
     chain->virt_img_size_in_bytes = chain->real_img_size_in_bytes;
     chain->boot_catalog = boot_catlog;
@@ -251,6 +251,12 @@ struct grub_disk_cache
 
 extern struct grub_disk_cache EXPORT_VAR(grub_disk_cache_table)[GRUB_DISK_CACHE_NUM];
 
+/* Read statistics, used by ventoy vt_perf_dump.  */
+extern grub_uint64_t EXPORT_VAR(grub_disk_read_count);
+extern grub_uint64_t EXPORT_VAR(grub_disk_read_bytes);
+extern grub_uint64_t EXPORT_VAR(grub_disk_dev_read_count);
+extern grub_uint64_t EXPORT_VAR(grub_disk_dev_read_bytes);
+
 #if defined (GRUB_UTIL)
 void grub_lvm_init (void);
 void grub_ldm_init (void);
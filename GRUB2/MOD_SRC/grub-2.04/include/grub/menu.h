@@ -84,6 +84,9 @@ struct grub_menu
 
   /* The list of menu entries.  */
   grub_menu_entry_t entry_list;
+
+  /* The last entry added by grub_normal_add_menu_entry, if still the tail.  */
+  grub_menu_entry_t entry_tail;
 };
 typedef struct grub_menu *grub_menu_t;
 
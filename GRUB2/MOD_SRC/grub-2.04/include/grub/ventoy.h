@@ -210,6 +210,9 @@ typedef struct ventoy_chain_head
 
     grub_uint32_t virt_chunk_offset;
     grub_uint32_t virt_chunk_num;
+
+    grub_uint32_t uefi_cache_size; /* UEFI read cache size in KB, 0: disabled */
+    grub_uint32_t io_trace_num;    /* UEFI I/O trace ring entries, 0: disabled */
 }ventoy_chain_head;
 
 typedef struct ventoy_image_desc
@@ -233,6 +236,78 @@ typedef struct ventoy_img_chunk
     grub_uint64_t disk_end_sector;   // included
 }ventoy_img_chunk;
 
+/*
+ * Compact image chunk map, used instead of the ventoy_img_chunk array
+ * (in the chain and in ventoy_image_map) for a heavily fragmented image.
+ * It can be told from the array by the magic, because the first chunk of
+ * an array always has img_start_sector 0.
+ *
+ * ventoy_chunk_map_head
+ * ventoy_chunk_map_index [index_num]  one for every group_size chunks
+ * record data            [data_size]  padded to 8 bytes
+ *
+ * A record is 5 varints (LEB128, signed ones zigzag encoded):
+ *     repeat      number of chunks described by this record
+ *     img_gap     img_start_sector - last img_end_sector - 1
+ *     img_len     img_end_sector - img_start_sector + 1
+ *     disk_gap    disk_start_sector - last disk_end_sector - 1  (signed)
+ *     disk_extra  disk sector count - img_len * 4              (signed)
+ * At the start of each group "last" is taken from the index entry
+ * (last img_end_sector = img_start_sector - 1, same for disk), so a
+ * decoder can start at any group. A record never crosses a group.
+ */
+#define VTOY_CHUNK_MAP_MAGIC    "VTOYCMAP"
+#define VTOY_CHUNK_MAP_VERSION  1
+#define VTOY_CHUNK_MAP_GROUP    64
+
+typedef struct ventoy_chunk_map_head
+{
+    char          magic[8];
+    grub_uint32_t version;
+    grub_uint32_t head_size;
+    grub_uint32_t chunk_num;
+    grub_uint32_t group_size;
+    grub_uint32_t index_num;
+    grub_uint32_t data_size;
+}ventoy_chunk_map_head;
+
+typedef struct ventoy_chunk_map_index
+{
+    grub_uint32_t img_start_sector;  // first chunk of the group
+    grub_uint32_t data_offset;       // offset of its record in data
+    grub_uint64_t disk_start_sector;
+}ventoy_chunk_map_index;
+
+/*
+ * Compressed memdisk, put after the chain head of a memdisk instead of
+ * the image data.
+ *
+ * ventoy_cmem_head
+ * ventoy_cmem_block [block_num]
+ *
+ * Every block_size bytes of the image are compressed on their own (LZ4
+ * block format) and stored at addr in memory. size 0 means an all zero
+ * block, size equal to the block length means the data is stored as is.
+ */
+#define VTOY_CMEM_MAGIC         "VTOYCMEM"
+#define VTOY_CMEM_BLOCK_SIZE    (64 * 1024)
+
+typedef struct ventoy_cmem_head
+{
+    char          magic[8];
+    grub_uint32_t block_size;
+    grub_uint32_t block_num;
+    grub_uint64_t img_size;
+    grub_uint64_t mem_size;   // total size of the stored blocks
+}ventoy_cmem_head;
+
+typedef struct ventoy_cmem_block
+{
+    grub_uint64_t addr;
+    grub_uint32_t size;
+    grub_uint32_t reserved;
+}ventoy_cmem_block;
+
 
 typedef struct ventoy_override_chunk
 {
@@ -296,6 +371,33 @@ typedef struct ventoy_grub_param
 
 #pragma pack()
 
+#pragma pack(1)
+
+/*
+ * VDiskChain streaming mode (vdisk_chain=0xADDR on its cmdline)
+ * Must be the same as vdisk_chain_head/vdisk_chunk in VDiskChain.h
+ */
+typedef struct vdisk_chain_head
+{
+    grub_uint8_t  disk_guid[16];       /* ventoy disk MBR 0x180 */
+    grub_uint8_t  disk_signature[4];   /* ventoy disk MBR 0x1b8 */
+    grub_uint64_t disk_size;           /* ventoy disk size in bytes */
+    grub_uint32_t disk_sector_size;    /* ventoy disk sector size */
+
+    grub_uint64_t vdisk_size;          /* virtual disk size in bytes */
+    grub_uint32_t chunk_offset;        /* vdisk_chunk array offset from this head */
+    grub_uint32_t chunk_num;           /* sorted by vdisk_start_sector */
+}vdisk_chain_head;
+
+typedef struct vdisk_chunk
+{
+    grub_uint64_t vdisk_start_sector;  /* 512 bytes sector in vdisk */
+    grub_uint64_t vdisk_end_sector;
+    grub_uint64_t disk_start_sector;   /* disk_sector_size sector in ventoy disk */
+}vdisk_chunk;
+
+#pragma pack()
+
 #define VTOY_CHUNK_BUF_SIZE          (4 * 1024 * 1024)
 
 typedef enum vtoy_chunk_err
@@ -312,6 +414,12 @@ typedef enum vtoy_chunk_err
 int grub_ext_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
 int grub_btrfs_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
 int grub_fat_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
+int grub_ntfs_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
+int grub_xfs_get_file_chunk(grub_uint64_t part_start, grub_file_t file, ventoy_img_chunk_list *chunk_list);
+grub_uint32_t grub_fat_get_file_cluster(grub_uint64_t part_start, grub_file_t file, grub_uint64_t *sector);
+grub_uint64_t grub_ext_get_file_inode(grub_file_t file);
+grub_uint64_t grub_xfs_get_file_inode(grub_file_t file);
+grub_uint64_t grub_ntfs_get_file_ref(grub_file_t file);
 void grub_iso9660_set_nojoliet(int nojoliet);
 int grub_iso9660_is_joliet(void);
 grub_uint64_t grub_iso9660_get_last_read_pos(grub_file_t file);
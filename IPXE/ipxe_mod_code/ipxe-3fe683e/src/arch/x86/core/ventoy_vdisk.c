@@ -34,6 +34,7 @@ ventoy_chain_head *g_chain;
 ventoy_img_chunk *g_chunk;
 uint32_t g_img_chunk_num;
 ventoy_img_chunk *g_cur_chunk;
+ventoy_chunk_map_head *g_chunk_map;
 uint32_t g_disk_sector_size;
 uint8_t *g_os_param_reserved;
 
@@ -57,6 +58,147 @@ uint64  g_fixup_iso9660_secover_tot_secs = 0;
 static struct int13_disk_address __bss16 ( ventoy_address );
 #define ventoy_address __use_data16 ( ventoy_address )
 
+static ventoy_chunk_map_cursor g_chunk_map_cursor;
+static ventoy_img_chunk g_chunk_map_cur;
+
+static int ventoy_chunk_map_get(ventoy_chunk_map_cursor *cursor, uint64_t *value)
+{
+    int shift = 0;
+    uint8_t byte;
+    uint64_t ret = 0;
+
+    do
+    {
+        if (cursor->pos >= cursor->head->data_size || shift > 63)
+        {
+            return 1;
+        }
+
+        byte = cursor->data[cursor->pos++];
+        ret |= ((uint64_t)(byte & 0x7F)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = ret;
+    return 0;
+}
+
+static void ventoy_chunk_map_seek_group(ventoy_chunk_map_cursor *cursor, uint32_t group)
+{
+    ventoy_chunk_map_index *index = cursor->index + group;
+
+    cursor->next = group * cursor->head->group_size;
+    cursor->pos = index->data_offset;
+    cursor->repeat = 0;
+    cursor->img_end = index->img_start_sector - 1;
+    cursor->disk_end = index->disk_start_sector - 1;
+}
+
+static int ventoy_chunk_map_next(ventoy_chunk_map_cursor *cursor, ventoy_img_chunk *chunk)
+{
+    uint64_t value[5];
+
+    if (cursor->next >= cursor->head->chunk_num)
+    {
+        return 1;
+    }
+
+    if (cursor->next % cursor->head->group_size == 0)
+    {
+        if (cursor->next / cursor->head->group_size >= cursor->head->index_num)
+        {
+            return 1;
+        }
+        ventoy_chunk_map_seek_group(cursor, cursor->next / cursor->head->group_size);
+    }
+
+    if (cursor->repeat == 0)
+    {
+        if (ventoy_chunk_map_get(cursor, value) || ventoy_chunk_map_get(cursor, value + 1) ||
+            ventoy_chunk_map_get(cursor, value + 2) || ventoy_chunk_map_get(cursor, value + 3) ||
+            ventoy_chunk_map_get(cursor, value + 4) || value[0] == 0 || value[2] == 0)
+        {
+            return 1;
+        }
+
+        cursor->repeat = (uint32_t)value[0];
+        cursor->img_gap = (uint32_t)value[1];
+        cursor->img_len = (uint32_t)value[2];
+        cursor->disk_gap = (int64_t)(value[3] >> 1) ^ (-(int64_t)(value[3] & 1));
+        cursor->disk_extra = (int64_t)(value[4] >> 1) ^ (-(int64_t)(value[4] & 1));
+    }
+
+    chunk->img_start_sector = cursor->img_end + 1 + cursor->img_gap;
+    chunk->img_end_sector = chunk->img_start_sector + cursor->img_len - 1;
+    chunk->disk_start_sector = cursor->disk_end + 1 + (uint64_t)cursor->disk_gap;
+    chunk->disk_end_sector = chunk->disk_start_sector + (uint64_t)((int64_t)cursor->img_len * 4 + cursor->disk_extra) - 1;
+
+    cursor->img_end = chunk->img_end_sector;
+    cursor->disk_end = chunk->disk_end_sector;
+    cursor->repeat--;
+    cursor->next++;
+    return 0;
+}
+
+/*
+ * Find the chunk of the 2KB image sector in the compact chunk map.
+ * Sequential read only decode the next chunk, otherwise binary search
+ * the group index and decode at most one group.
+ */
+static ventoy_img_chunk * ventoy_chunk_map_find(uint32_t sector)
+{
+    uint32_t low = 0;
+    uint32_t mid = 0;
+    uint32_t high = 0;
+    ventoy_img_chunk chunk;
+    ventoy_chunk_map_cursor *cursor = &g_chunk_map_cursor;
+
+    if (cursor->next > 0 && sector > cursor->img_end && ventoy_chunk_map_next(cursor, &chunk) == 0 &&
+        sector >= chunk.img_start_sector && sector <= chunk.img_end_sector)
+    {
+        goto found;
+    }
+
+    high = cursor->head->index_num;
+    while (low + 1 < high)
+    {
+        mid = low + (high - low) / 2;
+        if (cursor->index[mid].img_start_sector <= sector)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    ventoy_chunk_map_seek_group(cursor, low);
+    while (ventoy_chunk_map_next(cursor, &chunk) == 0)
+    {
+        if (sector < chunk.img_start_sector)
+        {
+            break;
+        }
+
+        if (sector <= chunk.img_end_sector)
+        {
+            goto found;
+        }
+    }
+
+    return NULL;
+
+found:
+    memcpy(&g_chunk_map_cur, &chunk, sizeof(chunk));
+    if (g_hddmode)
+    {
+        g_chunk_map_cur.img_start_sector *= 4;
+        g_chunk_map_cur.img_end_sector = g_chunk_map_cur.img_end_sector * 4 + 3;
+    }
+    return &g_chunk_map_cur;
+}
+
 static uint64_t ventoy_remap_lba_hdd(uint64_t lba, uint32_t *count)
 {
     uint32_t i;
@@ -67,7 +209,12 @@ static uint64_t ventoy_remap_lba_hdd(uint64_t lba, uint32_t *count)
         (lba > g_cur_chunk->img_end_sector))
     {
         g_cur_chunk = NULL;
-        for (i = 0; i < g_img_chunk_num; i++)
+        if (g_chunk_map)
+        {
+            g_cur_chunk = ventoy_chunk_map_find((uint32_t)(lba >> 2));
+        }
+
+        for (i = 0; g_chunk_map == NULL && i < g_img_chunk_num; i++)
         {
             cur = g_chunk + i;
             if (lba >= cur->img_start_sector && lba <= cur->img_end_sector)
@@ -100,7 +247,12 @@ static uint64_t ventoy_remap_lba(uint64_t lba, uint32_t *count)
     if ((NULL == g_cur_chunk) || ((lba) < g_cur_chunk->img_start_sector) || ((lba) > g_cur_chunk->img_end_sector))
     {
         g_cur_chunk = NULL;
-        for (i = 0; i < g_img_chunk_num; i++)
+        if (g_chunk_map)
+        {
+            g_cur_chunk = ventoy_chunk_map_find((uint32_t)lba);
+        }
+
+        for (i = 0; g_chunk_map == NULL && i < g_img_chunk_num; i++)
         {
             cur = g_chunk + i;
             if (lba >= cur->img_start_sector && lba <= cur->img_end_sector)
@@ -535,6 +687,14 @@ static void ventoy_dump_img_chunk(ventoy_chain_head *chain)
 
     printf("##################### ventoy_dump_img_chunk #######################\n");
 
+    if (g_chunk_map)
+    {
+        printf("compact chunk map: chunk:%u index:%u data:%u\n", g_chunk_map->chunk_num,
+               g_chunk_map->index_num, g_chunk_map->data_size);
+        ventoy_debug_pause();
+        return;
+    }
+
     for (i = 0; i < chain->img_chunk_num; i++)
     {
         printf("%2u: [ %u - %u ] <==> [ %llu - %llu ]\n",
@@ -651,6 +811,7 @@ static int ventoy_update_image_location(ventoy_os_param *param)
     ventoy_image_location *location = NULL;
     ventoy_image_disk_region *region = NULL;
     ventoy_img_chunk *chunk = g_chunk;
+    ventoy_img_chunk mapchunk;
 
     length = sizeof(ventoy_image_location) + (g_img_chunk_num - 1) * sizeof(ventoy_image_disk_region);
 
@@ -689,25 +850,35 @@ static int ventoy_update_image_location(ventoy_os_param *param)
 
     region = location->regions;
 
-    if (g_hddmode)
+    if (g_chunk_map)
     {
-        for (i = 0; i < g_img_chunk_num; i++)
+        ventoy_chunk_map_seek_group(&g_chunk_map_cursor, 0);
+        chunk = &mapchunk;
+    }
+
+    for (i = 0; i < g_img_chunk_num; i++)
+    {
+        if (g_chunk_map && ventoy_chunk_map_next(&g_chunk_map_cursor, chunk))
+        {
+            break;
+        }
+
+        if (g_hddmode)
         {
             region->image_sector_count = chunk->disk_end_sector - chunk->disk_start_sector + 1;
             region->image_start_sector = chunk->img_start_sector * 4;
-            region->disk_start_sector  = chunk->disk_start_sector;
-            region++;
-            chunk++;
         }
-    }
-    else
-    {
-        for (i = 0; i < g_img_chunk_num; i++)
+        else
         {
             region->image_sector_count = chunk->img_end_sector - chunk->img_start_sector + 1;
             region->image_start_sector = chunk->img_start_sector;
-            region->disk_start_sector  = chunk->disk_start_sector;        
-            region++;
+        }
+
+        region->disk_start_sector = chunk->disk_start_sector;
+        region++;
+
+        if (NULL == g_chunk_map)
+        {
             chunk++;
         }
     }
@@ -750,6 +921,16 @@ int ventoy_boot_vdisk(void *data)
     g_disk_sector_size = g_chain->disk_sector_size;
     g_cur_chunk = g_chunk;
 
+    /* heavily fragmented image use the compact chunk map */
+    if (memcmp(g_chunk, VTOY_CHUNK_MAP_MAGIC, 8) == 0)
+    {
+        g_chunk_map = (ventoy_chunk_map_head *)g_chunk;
+        g_chunk_map_cursor.head = g_chunk_map;
+        g_chunk_map_cursor.index = (ventoy_chunk_map_index *)(g_chunk_map + 1);
+        g_chunk_map_cursor.data = (uint8_t *)(g_chunk_map_cursor.index + g_chunk_map->index_num);
+        g_cur_chunk = NULL;
+    }
+
     g_os_param_reserved = (uint8_t *)(g_chain->os_param.vtoy_reserved);
 
     /* Workaround for Windows & ISO9660 */
@@ -780,7 +961,7 @@ int ventoy_boot_vdisk(void *data)
         ventoy_dump_chain(g_chain);
     }
 
-    if (g_hddmode)
+    if (g_hddmode && NULL == g_chunk_map)
     {
         for (i = 0; i < g_img_chunk_num; i++)
         {
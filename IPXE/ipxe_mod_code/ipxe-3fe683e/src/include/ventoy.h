@@ -135,6 +135,9 @@ typedef struct ventoy_chain_head
 
     grub_uint32_t virt_chunk_offset;
     grub_uint32_t virt_chunk_num;
+
+    grub_uint32_t uefi_cache_size; /* UEFI read cache size in KB, 0: disabled */
+    grub_uint32_t io_trace_num;    /* UEFI I/O trace ring entries, 0: disabled */
 }ventoy_chain_head;
 
 
@@ -147,6 +150,28 @@ typedef struct ventoy_img_chunk
     grub_uint64_t disk_end_sector;
 }ventoy_img_chunk;
 
+/* compact image chunk map, same format as grub/ventoy.h in GRUB2 */
+#define VTOY_CHUNK_MAP_MAGIC    "VTOYCMAP"
+#define VTOY_CHUNK_MAP_VERSION  1
+
+typedef struct ventoy_chunk_map_head
+{
+    char          magic[8];
+    grub_uint32_t version;
+    grub_uint32_t head_size;
+    grub_uint32_t chunk_num;
+    grub_uint32_t group_size;
+    grub_uint32_t index_num;
+    grub_uint32_t data_size;
+}ventoy_chunk_map_head;
+
+typedef struct ventoy_chunk_map_index
+{
+    grub_uint32_t img_start_sector;
+    grub_uint32_t data_offset;
+    grub_uint64_t disk_start_sector;
+}ventoy_chunk_map_index;
+
 
 typedef struct ventoy_override_chunk
 {
@@ -176,6 +201,22 @@ typedef struct ventoy_virt_chunk
     printf("\n");\
 }
 
+typedef struct ventoy_chunk_map_cursor
+{
+    ventoy_chunk_map_head *head;
+    ventoy_chunk_map_index *index;
+    uint8_t *data;
+    uint32_t next;
+    uint32_t pos;
+    uint32_t repeat;
+    uint32_t img_gap;
+    uint32_t img_len;
+    int64_t  disk_gap;
+    int64_t  disk_extra;
+    uint32_t img_end;
+    uint64_t disk_end;
+}ventoy_chunk_map_cursor;
+
 typedef struct ventoy_sector_flag
 {
     uint8_t flag; // 0:init   1:mem  2:remap
@@ -52,6 +52,27 @@ typedef struct ventoy_disk_map
     u64_t disk_start_sector;
     u64_t disk_end_sector;
 }ventoy_disk_map;
+
+#define VTOY_CHUNK_MAP_MAGIC    "VTOYCMAP"
+#define VTOY_CHUNK_MAP_VERSION  1
+
+typedef struct ventoy_chunk_map_head
+{
+    char  magic[8];
+    u32_t version;
+    u32_t head_size;
+    u32_t chunk_num;
+    u32_t group_size;
+    u32_t index_num;
+    u32_t data_size;
+}ventoy_chunk_map_head;
+
+typedef struct ventoy_chunk_map_index
+{
+    u32_t img_start_sector;
+    u32_t data_offset;
+    u64_t disk_start_sector;
+}ventoy_chunk_map_index;
 #pragma pack()
 
 static int verbose = 0;
@@ -59,6 +80,112 @@ static u64_t g_iso_file_size = 0;
 static int g_img_map_num = 0;
 static ventoy_disk_map *g_img_map = NULL;
 
+static int vtoydm_chunk_map_get(unsigned char *data, u32_t size, u32_t *pos, u64_t *value)
+{
+    int shift = 0;
+    unsigned char byte;
+    u64_t ret = 0;
+
+    do
+    {
+        if (*pos >= size || shift > 63)
+        {
+            return 1;
+        }
+
+        byte = data[(*pos)++];
+        ret |= ((u64_t)(byte & 0x7F)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = ret;
+    return 0;
+}
+
+/* decode the compact chunk map (format in grub/ventoy.h of GRUB2) to a plain chunk array */
+static ventoy_img_chunk * vtoydm_decode_chunk_map(void *buf, int len, int *plen)
+{
+    u32_t i = 0;
+    u32_t j = 0;
+    u32_t pos = 0;
+    u32_t img_end = 0;
+    u64_t disk_end = 0;
+    u64_t value[5];
+    long long disk_gap = 0;
+    long long disk_extra = 0;
+    unsigned char *data = NULL;
+    ventoy_img_chunk *chunk = NULL;
+    ventoy_chunk_map_head *head = (ventoy_chunk_map_head *)buf;
+    ventoy_chunk_map_index *index = (ventoy_chunk_map_index *)(head + 1);
+
+    if (head->version != VTOY_CHUNK_MAP_VERSION || head->head_size != sizeof(ventoy_chunk_map_head) ||
+        head->group_size == 0 || head->chunk_num == 0 ||
+        (long long)len < (long long)sizeof(ventoy_chunk_map_head) + (long long)head->index_num * sizeof(ventoy_chunk_map_index) + head->data_size)
+    {
+        fprintf(stderr, "invalid chunk map len:%d\n", len);
+        return NULL;
+    }
+
+    data = (unsigned char *)(index + head->index_num);
+
+    chunk = (ventoy_img_chunk *)malloc(head->chunk_num * sizeof(ventoy_img_chunk));
+    if (NULL == chunk)
+    {
+        fprintf(stderr, "Failed to malloc memory chunk:%u\n", head->chunk_num);
+        return NULL;
+    }
+
+    while (i < head->chunk_num)
+    {
+        /* a record never cross a group */
+        if (i % head->group_size == 0)
+        {
+            if (i / head->group_size >= head->index_num)
+            {
+                goto fail;
+            }
+
+            pos = index[i / head->group_size].data_offset;
+            img_end = index[i / head->group_size].img_start_sector - 1;
+            disk_end = index[i / head->group_size].disk_start_sector - 1;
+        }
+
+        for (j = 0; j < 5; j++)
+        {
+            if (vtoydm_chunk_map_get(data, head->data_size, &pos, value + j))
+            {
+                goto fail;
+            }
+        }
+
+        if (value[0] == 0 || value[2] == 0 || value[0] > head->chunk_num - i)
+        {
+            goto fail;
+        }
+
+        disk_gap = (long long)(value[3] >> 1) ^ (-(long long)(value[3] & 1));
+        disk_extra = (long long)(value[4] >> 1) ^ (-(long long)(value[4] & 1));
+
+        for (j = 0; j < (u32_t)value[0]; j++, i++)
+        {
+            chunk[i].img_start_sector = img_end + 1 + (u32_t)value[1];
+            chunk[i].img_end_sector = chunk[i].img_start_sector + (u32_t)value[2] - 1;
+            chunk[i].disk_start_sector = disk_end + 1 + (u64_t)disk_gap;
+            chunk[i].disk_end_sector = chunk[i].disk_start_sector + (u64_t)((long long)value[2] * 4 + disk_extra) - 1;
+            img_end = chunk[i].img_end_sector;
+            disk_end = chunk[i].disk_end_sector;
+        }
+    }
+
+    *plen = (int)(head->chunk_num * sizeof(ventoy_img_chunk));
+    return chunk;
+
+fail:
+    fprintf(stderr, "invalid chunk map data at %u\n", i);
+    free(chunk);
+    return NULL;
+}
+
 static ventoy_disk_map * vtoydm_get_img_map_data(const char *img_map_file, int *plen)
 {
     int i;
@@ -66,6 +193,7 @@ static ventoy_disk_map * vtoydm_get_img_map_data(const char *img_map_file, int *
     int rc = 1;
     u64_t sector_num;
     FILE *fp = NULL;
+    void *cmap = NULL;
     ventoy_img_chunk *chunk = NULL;
     ventoy_disk_map *map = NULL;
     
@@ -93,6 +221,17 @@ static ventoy_disk_map * vtoydm_get_img_map_data(const char *img_map_file, int *
         goto end;
     }
 
+    if (len >= (int)sizeof(ventoy_chunk_map_head) && memcmp(chunk, VTOY_CHUNK_MAP_MAGIC, 8) == 0)
+    {
+        cmap = chunk;
+        chunk = vtoydm_decode_chunk_map(cmap, len, &len);
+        free(cmap);
+        if (NULL == chunk)
+        {
+            goto end;
+        }
+    }
+
     if (len % sizeof(ventoy_img_chunk))
     {
         fprintf(stderr, "image map file size %d is not aligned with %d\n", 
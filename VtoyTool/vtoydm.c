@@ -58,6 +58,27 @@ typedef struct ventoy_img_chunk
     uint64_t disk_start_sector; // in disk_sector_size
     uint64_t disk_end_sector;   // included
 }ventoy_img_chunk;
+
+#define VTOY_CHUNK_MAP_MAGIC    "VTOYCMAP"
+#define VTOY_CHUNK_MAP_VERSION  1
+
+typedef struct ventoy_chunk_map_head
+{
+    char  magic[8];
+    uint32_t version;
+    uint32_t head_size;
+    uint32_t chunk_num;
+    uint32_t group_size;
+    uint32_t index_num;
+    uint32_t data_size;
+}ventoy_chunk_map_head;
+
+typedef struct ventoy_chunk_map_index
+{
+    uint32_t img_start_sector;
+    uint32_t data_offset;
+    uint64_t disk_start_sector;
+}ventoy_chunk_map_index;
 #pragma pack()
 
 static int verbose = 0;
@@ -76,11 +97,118 @@ static int g_img_chunk_num = 0;
 static ventoy_img_chunk *g_img_chunk = NULL;
 static unsigned char g_iso_sector_buf[2048];
 
+static int vtoydm_chunk_map_get(unsigned char *data, uint32_t size, uint32_t *pos, uint64_t *value)
+{
+    int shift = 0;
+    unsigned char byte;
+    uint64_t ret = 0;
+
+    do
+    {
+        if (*pos >= size || shift > 63)
+        {
+            return 1;
+        }
+
+        byte = data[(*pos)++];
+        ret |= ((uint64_t)(byte & 0x7F)) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = ret;
+    return 0;
+}
+
+/* decode the compact chunk map (format in grub/ventoy.h of GRUB2) to a plain chunk array */
+static ventoy_img_chunk * vtoydm_decode_chunk_map(void *buf, int len, int *plen)
+{
+    uint32_t i = 0;
+    uint32_t j = 0;
+    uint32_t pos = 0;
+    uint32_t img_end = 0;
+    uint64_t disk_end = 0;
+    uint64_t value[5];
+    long long disk_gap = 0;
+    long long disk_extra = 0;
+    unsigned char *data = NULL;
+    ventoy_img_chunk *chunk = NULL;
+    ventoy_chunk_map_head *head = (ventoy_chunk_map_head *)buf;
+    ventoy_chunk_map_index *index = (ventoy_chunk_map_index *)(head + 1);
+
+    if (head->version != VTOY_CHUNK_MAP_VERSION || head->head_size != sizeof(ventoy_chunk_map_head) ||
+        head->group_size == 0 || head->chunk_num == 0 ||
+        (long long)len < (long long)sizeof(ventoy_chunk_map_head) + (long long)head->index_num * sizeof(ventoy_chunk_map_index) + head->data_size)
+    {
+        fprintf(stderr, "invalid chunk map len:%d\n", len);
+        return NULL;
+    }
+
+    data = (unsigned char *)(index + head->index_num);
+
+    chunk = (ventoy_img_chunk *)malloc(head->chunk_num * sizeof(ventoy_img_chunk));
+    if (NULL == chunk)
+    {
+        fprintf(stderr, "Failed to malloc memory chunk:%u\n", head->chunk_num);
+        return NULL;
+    }
+
+    while (i < head->chunk_num)
+    {
+        /* a record never cross a group */
+        if (i % head->group_size == 0)
+        {
+            if (i / head->group_size >= head->index_num)
+            {
+                goto fail;
+            }
+
+            pos = index[i / head->group_size].data_offset;
+            img_end = index[i / head->group_size].img_start_sector - 1;
+            disk_end = index[i / head->group_size].disk_start_sector - 1;
+        }
+
+        for (j = 0; j < 5; j++)
+        {
+            if (vtoydm_chunk_map_get(data, head->data_size, &pos, value + j))
+            {
+                goto fail;
+            }
+        }
+
+        if (value[0] == 0 || value[2] == 0 || value[0] > head->chunk_num - i)
+        {
+            goto fail;
+        }
+
+        disk_gap = (long long)(value[3] >> 1) ^ (-(long long)(value[3] & 1));
+        disk_extra = (long long)(value[4] >> 1) ^ (-(long long)(value[4] & 1));
+
+        for (j = 0; j < (uint32_t)value[0]; j++, i++)
+        {
+            chunk[i].img_start_sector = img_end + 1 + (uint32_t)value[1];
+            chunk[i].img_end_sector = chunk[i].img_start_sector + (uint32_t)value[2] - 1;
+            chunk[i].disk_start_sector = disk_end + 1 + (uint64_t)disk_gap;
+            chunk[i].disk_end_sector = chunk[i].disk_start_sector + (uint64_t)((long long)value[2] * 4 + disk_extra) - 1;
+            img_end = chunk[i].img_end_sector;
+            disk_end = chunk[i].disk_end_sector;
+        }
+    }
+
+    *plen = (int)(head->chunk_num * sizeof(ventoy_img_chunk));
+    return chunk;
+
+fail:
+    fprintf(stderr, "invalid chunk map data at %u\n", i);
+    free(chunk);
+    return NULL;
+}
+
 ventoy_img_chunk * vtoydm_get_img_map_data(const char *img_map_file, int *plen)
 {
     int len;
     int rc = 1;
     FILE *fp = NULL;
+    void *map = NULL;
     ventoy_img_chunk *chunk = NULL;
     
     fp = fopen(img_map_file, "rb");
@@ -109,6 +237,18 @@ ventoy_img_chunk * vtoydm_get_img_map_data(const char *img_map_file, int *plen)
         goto end;
     }
 
+    if (len >= (int)sizeof(ventoy_chunk_map_head) && memcmp(chunk, VTOY_CHUNK_MAP_MAGIC, 8) == 0)
+    {
+        map = chunk;
+        chunk = vtoydm_decode_chunk_map(map, len, &len);
+        free(map);
+        if (NULL == chunk)
+        {
+            goto end;
+        }
+        debug("compact chunk map decoded, len:%d\n", len);
+    }
+
     if (len % sizeof(ventoy_img_chunk))
     {
         fprintf(stderr, "image map file size %d is not aligned with %d\n", 
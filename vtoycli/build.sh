@@ -5,18 +5,20 @@ rm -f vtoycli_32
 rm -f vtoycli_aa64
 rm -f vtoycli_m64e
 
-SRCS="vtoycli.c vtoyfat.c vtoygpt.c crc32.c partresize.c"
+EXFAT_DIR=../LinuxGUI/Ventoy2Disk/Lib/exfat/src/libexfat
 
-gcc -specs "/usr/local/musl/lib/musl-gcc.specs" -Os -static -D_FILE_OFFSET_BITS=64 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_64.a -o vtoycli_64
+SRCS="vtoycli.c vtoyfat.c vtoygpt.c crc32.c partresize.c imgindex.c defrag.c lz4bench.c $EXFAT_DIR/*.c"
 
-/opt/diet32/bin/diet -Os gcc -D_FILE_OFFSET_BITS=64 -m32 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_32.a -o vtoycli_32
+gcc -specs "/usr/local/musl/lib/musl-gcc.specs" -Os -static -D_FILE_OFFSET_BITS=64 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_64.a -o vtoycli_64
 
+/opt/diet32/bin/diet -Os gcc -D_FILE_OFFSET_BITS=64 -m32 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_32.a -o vtoycli_32
 
-#gcc -O2 -D_FILE_OFFSET_BITS=64 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_64.a -o vtoycli_64
-#gcc -m32 -O2 -D_FILE_OFFSET_BITS=64 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_32.a -o vtoycli_32
 
-aarch64-buildroot-linux-uclibc-gcc -static -O2 -D_FILE_OFFSET_BITS=64 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_aa64.a -o vtoycli_aa64
-mips64el-linux-musl-gcc -mips64r2 -mabi=64 -static -O2 -D_FILE_OFFSET_BITS=64 $SRCS -Ifat_io_lib/include fat_io_lib/lib/libfat_io_m64e.a -o vtoycli_m64e
+#gcc -O2 -D_FILE_OFFSET_BITS=64 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_64.a -o vtoycli_64
+#gcc -m32 -O2 -D_FILE_OFFSET_BITS=64 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_32.a -o vtoycli_32
+
+aarch64-buildroot-linux-uclibc-gcc -static -O2 -D_FILE_OFFSET_BITS=64 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_aa64.a -o vtoycli_aa64
+mips64el-linux-musl-gcc -mips64r2 -mabi=64 -static -O2 -D_FILE_OFFSET_BITS=64 $SRCS -I$EXFAT_DIR -Ifat_io_lib/include fat_io_lib/lib/libfat_io_m64e.a -o vtoycli_m64e
 
 
 if [ -e vtoycli_64 ] && [ -e vtoycli_32 ] && [ -e vtoycli_aa64 ] && [ -e vtoycli_m64e ]; then
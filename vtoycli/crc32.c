@@ -303,3 +303,61 @@ UINT32 VtoyCrc32(VOID *Buffer, UINT32 Length)
     return Crc ^ 0xffffffff;
 }
 
+
+static UINT32 crc32c_table[256];
+
+/* Helper for init_crc32c_table.  */
+static UINT32 reflect(UINT32 ref, int len)
+{
+    int i;
+    UINT32 result = 0;
+
+    for (i = 1; i <= len; i++)
+    {
+        if (ref & 1)
+        {
+            result |= 1 << (len - i);
+        }
+        ref >>= 1;
+    }
+
+    return result;
+}
+
+static void init_crc32c_table(void)
+{
+    int i, j;
+    UINT32 polynomial = 0x1edc6f41;
+
+    for (i = 0; i < 256; i++)
+    {
+        crc32c_table[i] = reflect(i, 8) << 24;
+        for (j = 0; j < 8; j++)
+        {
+            crc32c_table[i] = (crc32c_table[i] << 1) ^ (crc32c_table[i] & (1U << 31) ? polynomial : 0);
+        }
+        crc32c_table[i] = reflect(crc32c_table[i], 32);
+    }
+}
+
+/* same as grub_getcrc32c */
+UINT32 ventoy_getcrc32c(UINT32 crc, const VOID *buf, int size)
+{
+    int i;
+    const UINT8 *data = buf;
+
+    if (!crc32c_table[1])
+    {
+        init_crc32c_table();
+    }
+
+    crc ^= 0xffffffff;
+
+    for (i = 0; i < size; i++)
+    {
+        crc = (crc >> 8) ^ crc32c_table[(crc & 0xFF) ^ *data];
+        data++;
+    }
+
+    return crc ^ 0xffffffff;
+}
@@ -0,0 +1,569 @@
+/******************************************************************************
+ * defrag.c  ---- ventoy exfat image defrag util
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <exfat.h>
+#include "vtoycli.h"
+
+/*
+ * Every fragment of an image file is a chunk in the ventoy chunk list, so a
+ * fragmented image makes the chunk list (and the lookup at boot time) bigger.
+ * This util reports the fragment count of the files on the (unmounted) Ventoy
+ * exFAT partition and moves the selected files into one contiguous free run.
+ *
+ * The order of a relocation is:
+ *   1. copy the data into free clusters (not marked in the bitmap yet)
+ *   2. mark the new clusters in the bitmap
+ *   3. switch the directory entry to the new run
+ *   4. free the old clusters in the bitmap
+ * with a sync after each step. A power loss at any point leaves either the
+ * old file or the new file, at worst with some lost clusters.
+ */
+
+#define DEFRAG_IO_SIZE      (4 * SIZE_1MB)
+#define DEFRAG_FAT_WIN      (256 * 1024)  /* FAT entries per read */
+
+typedef struct DEFRAG_EXTENT
+{
+    UINT32 Start;
+    UINT32 Count;
+}DEFRAG_EXTENT;
+
+extern uint64_t g_vtoy_exfat_part_size;
+
+static int g_verbose = 0;
+static int g_dryrun = 0;
+static int g_all = 0;
+
+static UINT8 *g_io_buf = NULL;
+static le32_t *g_fat_buf = NULL;
+static UINT32 g_fat_first = 0;
+static UINT32 g_fat_num = 0;
+
+static UINT32 g_file_num = 0;
+static UINT32 g_frag_file_num = 0;
+static UINT64 g_chunk_before = 0;
+static UINT64 g_chunk_after = 0;
+
+void ventoy_syslog_newline(int level, const char *Fmt, ...)
+{
+    va_list arg;
+
+    if (level == VLOG_DEBUG && g_verbose == 0)
+    {
+        return;
+    }
+
+    va_start(arg, Fmt);
+    vprintf(Fmt, arg);
+    va_end(arg);
+    printf("\n");
+}
+
+static cluster_t defrag_next_cluster(struct exfat *ef, cluster_t cluster)
+{
+    UINT32 total;
+    off_t offset;
+
+    if (cluster < g_fat_first || cluster >= g_fat_first + g_fat_num)
+    {
+        total = le32_to_cpu(ef->sb->cluster_count) + EXFAT_FIRST_DATA_CLUSTER;
+        offset = ((off_t)le32_to_cpu(ef->sb->fat_sector_start) << ef->sb->sector_bits) + (off_t)cluster * sizeof(le32_t);
+
+        g_fat_first = cluster;
+        g_fat_num = MIN(DEFRAG_FAT_WIN, total - cluster);
+        if (exfat_pread(ef->dev, g_fat_buf, g_fat_num * sizeof(le32_t), offset) != (ssize_t)(g_fat_num * sizeof(le32_t)))
+        {
+            g_fat_num = 0;
+            return EXFAT_CLUSTER_BAD;
+        }
+    }
+
+    return le32_to_cpu(g_fat_buf[cluster - g_fat_first]);
+}
+
+static int defrag_get_extents(struct exfat *ef, struct exfat_node *node, DEFRAG_EXTENT **extents, UINT32 *num)
+{
+    UINT32 i;
+    UINT32 n = 0;
+    UINT32 max = 0;
+    UINT32 clusters;
+    cluster_t cluster;
+    DEFRAG_EXTENT *ext = NULL;
+    DEFRAG_EXTENT *newext = NULL;
+
+    *extents = NULL;
+    *num = 0;
+
+    clusters = (UINT32)DIV_ROUND_UP(node->size, CLUSTER_SIZE(*ef->sb));
+    if (clusters == 0)
+    {
+        return 0;
+    }
+
+    cluster = node->start_cluster;
+    for (i = 0; i < clusters; i++)
+    {
+        if (CLUSTER_INVALID(*ef->sb, cluster))
+        {
+            printf("Invalid cluster 0x%x in cluster chain\n", cluster);
+            check_free(ext);
+            return 1;
+        }
+
+        if (n > 0 && ext[n - 1].Start + ext[n - 1].Count == cluster)
+        {
+            ext[n - 1].Count++;
+        }
+        else
+        {
+            if (n == max)
+            {
+                max = max ? max * 2 : 64;
+                newext = realloc(ext, max * sizeof(DEFRAG_EXTENT));
+                if (!newext)
+                {
+                    check_free(ext);
+                    return 1;
+                }
+                ext = newext;
+            }
+
+            ext[n].Start = cluster;
+            ext[n].Count = 1;
+            n++;
+        }
+
+        if (node->is_contiguous)
+        {
+            /* no FAT chain, the whole file is one extent */
+            ext[0].Count = clusters;
+            break;
+        }
+
+        if (i + 1 < clusters)
+        {
+            cluster = defrag_next_cluster(ef, cluster);
+        }
+    }
+
+    *extents = ext;
+    *num = n;
+    return 0;
+}
+
+static cluster_t defrag_find_run(struct exfat *ef, UINT32 count)
+{
+    UINT32 i = 0;
+    UINT32 run = 0;
+    const UINT32 bits = sizeof(bitmap_t) * 8;
+    bitmap_t *bitmap = ef->cmap.chunk;
+
+    while (i < ef->cmap.chunk_size)
+    {
+        if ((i % bits) == 0 && i + bits <= ef->cmap.chunk_size)
+        {
+            if (bitmap[i / bits] == ~((bitmap_t)0))
+            {
+                run = 0;
+                i += bits;
+                continue;
+            }
+            else if (bitmap[i / bits] == 0)
+            {
+                run += bits;
+                i += bits;
+                if (run >= count)
+                {
+                    return i - run + EXFAT_FIRST_DATA_CLUSTER;
+                }
+                continue;
+            }
+        }
+
+        if (BMAP_GET(bitmap, i))
+        {
+            run = 0;
+        }
+        else if (++run >= count)
+        {
+            return i + 1 - run + EXFAT_FIRST_DATA_CLUSTER;
+        }
+        i++;
+    }
+
+    return EXFAT_CLUSTER_END;
+}
+
+static void defrag_mark_run(struct exfat *ef, cluster_t start, UINT32 count, int used)
+{
+    UINT32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (used)
+        {
+            BMAP_SET(ef->cmap.chunk, start + i - EXFAT_FIRST_DATA_CLUSTER);
+        }
+        else
+        {
+            BMAP_CLR(ef->cmap.chunk, start + i - EXFAT_FIRST_DATA_CLUSTER);
+        }
+    }
+
+    /* the dry run only simulates the allocation, never write the bitmap back */
+    if (!g_dryrun)
+    {
+        ef->cmap.dirty = true;
+    }
+}
+
+static int defrag_copy(struct exfat *ef, DEFRAG_EXTENT *ext, UINT32 num, cluster_t dst)
+{
+    UINT32 i;
+    size_t len;
+    off_t src;
+    off_t dstoff;
+    UINT64 remain;
+
+    dstoff = exfat_c2o(ef, dst);
+    for (i = 0; i < num; i++)
+    {
+        src = exfat_c2o(ef, ext[i].Start);
+        remain = (UINT64)ext[i].Count * CLUSTER_SIZE(*ef->sb);
+
+        while (remain > 0)
+        {
+            len = (size_t)MIN(remain, DEFRAG_IO_SIZE);
+            if (exfat_pread(ef->dev, g_io_buf, len, src) != (ssize_t)len)
+            {
+                printf("Failed to read at %llu errno:%d\n", (UINT64)src, errno);
+                return 1;
+            }
+
+            if (exfat_pwrite(ef->dev, g_io_buf, len, dstoff) != (ssize_t)len)
+            {
+                printf("Failed to write at %llu errno:%d\n", (UINT64)dstoff, errno);
+                return 1;
+            }
+
+            src += len;
+            dstoff += len;
+            remain -= len;
+        }
+    }
+
+    return exfat_fsync(ef->dev);
+}
+
+static int defrag_relocate(struct exfat *ef, struct exfat_node *node, DEFRAG_EXTENT *ext, UINT32 num, UINT32 *after)
+{
+    UINT32 i;
+    UINT32 clusters = 0;
+    cluster_t start;
+
+    *after = num;
+
+    for (i = 0; i < num; i++)
+    {
+        clusters += ext[i].Count;
+    }
+
+    start = defrag_find_run(ef, clusters);
+    if (start == EXFAT_CLUSTER_END)
+    {
+        printf("  no contiguous free space for %u clusters\n", clusters);
+        return 0;
+    }
+
+    if (g_dryrun)
+    {
+        defrag_mark_run(ef, start, clusters, 1);
+        for (i = 0; i < num; i++)
+        {
+            defrag_mark_run(ef, ext[i].Start, ext[i].Count, 0);
+        }
+        *after = 1;
+        return 0;
+    }
+
+    if (defrag_copy(ef, ext, num, start))
+    {
+        return 1;
+    }
+
+    defrag_mark_run(ef, start, clusters, 1);
+    if (exfat_flush(ef) || exfat_fsync(ef->dev))
+    {
+        return 1;
+    }
+
+    /* the new mtime also invalidates the chunk cache entry of this file */
+    node->start_cluster = start;
+    node->is_contiguous = true;
+    node->fptr_index = 0;
+    node->fptr_cluster = start;
+    exfat_update_mtime(node);
+    if (exfat_flush_node(ef, node) || exfat_fsync(ef->dev))
+    {
+        return 1;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        defrag_mark_run(ef, ext[i].Start, ext[i].Count, 0);
+    }
+    if (exfat_flush(ef) || exfat_fsync(ef->dev))
+    {
+        return 1;
+    }
+
+    *after = 1;
+    return 0;
+}
+
+static int defrag_file(struct exfat *ef, struct exfat_node *node, const char *path, int relocate)
+{
+    int rc = 0;
+    UINT32 num = 0;
+    UINT32 after = 0;
+    DEFRAG_EXTENT *ext = NULL;
+
+    if (defrag_get_extents(ef, node, &ext, &num))
+    {
+        printf("Failed to get cluster chain of %s\n", path);
+        return 1;
+    }
+
+    g_file_num++;
+    if (num > 1)
+    {
+        g_frag_file_num++;
+    }
+
+    after = num;
+    if (relocate && num > 1)
+    {
+        printf("%8u %12llu  %s\n", num, (UINT64)node->size, path);
+        rc = defrag_relocate(ef, node, ext, num, &after);
+        printf("  %u -> %u fragments%s\n", num, after, rc ? " (failed)" : "");
+    }
+    else if (g_verbose || num > 1)
+    {
+        printf("%8u %12llu  %s\n", num, (UINT64)node->size, path);
+    }
+
+    g_chunk_before += num;
+    g_chunk_after += after;
+
+    check_free(ext);
+    return rc;
+}
+
+static int defrag_scan_dir(struct exfat *ef, struct exfat_node *dir, const char *path)
+{
+    int rc = 0;
+    struct exfat_iterator it;
+    struct exfat_node *node = NULL;
+    char name[EXFAT_UTF8_NAME_BUFFER_MAX];
+    char fullpath[4096];
+
+    if (exfat_opendir(ef, dir, &it) != 0)
+    {
+        printf("Failed to open directory %s\n", path);
+        return 1;
+    }
+
+    while (rc == 0 && (node = exfat_readdir(&it)) != NULL)
+    {
+        exfat_get_name(node, name);
+        snprintf(fullpath, sizeof(fullpath), "%s/%s", path, name);
+
+        if (node->attrib & EXFAT_ATTRIB_DIR)
+        {
+            rc = defrag_scan_dir(ef, node, fullpath);
+        }
+        else
+        {
+            rc = defrag_file(ef, node, fullpath, g_all);
+        }
+
+        exfat_put_node(ef, node);
+    }
+
+    exfat_closedir(ef, &it);
+    return rc;
+}
+
+static int defrag_path(struct exfat *ef, const char *path)
+{
+    int rc;
+    struct exfat_node *node = NULL;
+
+    if (exfat_lookup(ef, &node, path) != 0)
+    {
+        printf("%s not found\n", path);
+        return 1;
+    }
+
+    if (node->attrib & EXFAT_ATTRIB_DIR)
+    {
+        printf("%s is a directory\n", path);
+        rc = 1;
+    }
+    else
+    {
+        rc = defrag_file(ef, node, path, 1);
+    }
+
+    exfat_put_node(ef, node);
+    return rc;
+}
+
+static int defrag_check_device(const char *dev)
+{
+    int fd;
+    off_t size;
+
+    /* O_EXCL on a block device fails with EBUSY when it's mounted */
+    fd = open(dev, O_RDONLY | O_EXCL);
+    if (fd < 0)
+    {
+        printf("Failed to open %s errno:%d%s\n", dev, errno, (errno == EBUSY) ? " (mounted?)" : "");
+        return 1;
+    }
+
+    size = lseek(fd, 0, SEEK_END);
+    close(fd);
+
+    if (size <= 0)
+    {
+        printf("Failed to get size of %s\n", dev);
+        return 1;
+    }
+
+    g_vtoy_exfat_part_size = (uint64_t)size;
+    return 0;
+}
+
+int defrag_main(int argc, char **argv)
+{
+    int i;
+    int rc = 0;
+    int pathnum = 0;
+    const char *dev = NULL;
+    struct exfat ef;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            g_verbose = 1;
+        }
+        else if (strcmp(argv[i], "-n") == 0)
+        {
+            g_dryrun = 1;
+        }
+        else if (strcmp(argv[i], "-a") == 0)
+        {
+            g_all = 1;
+        }
+        else if (!dev)
+        {
+            dev = argv[i];
+        }
+        else
+        {
+            pathnum++;
+        }
+    }
+
+    if (!dev)
+    {
+        printf("Usage: vtoycli defrag [-v] [-n] [-a] partition [file ...]\n");
+        printf("  no file   report the fragment count of the fragmented files\n");
+        printf("  file      relocate the file into a contiguous free run\n");
+        printf("  -a        relocate all the fragmented files\n");
+        printf("  -n        dry run, only print the predicted chunk count\n");
+        return 1;
+    }
+
+    if (defrag_check_device(dev))
+    {
+        return 1;
+    }
+
+    g_io_buf = malloc(DEFRAG_IO_SIZE);
+    g_fat_buf = malloc(DEFRAG_FAT_WIN * sizeof(le32_t));
+    if (!g_io_buf || !g_fat_buf)
+    {
+        check_free(g_io_buf);
+        check_free(g_fat_buf);
+        return 1;
+    }
+
+    /* report only and dry run never write the partition */
+    if (exfat_mount(&ef, dev, (g_dryrun || (pathnum == 0 && g_all == 0)) ? "ro" : "") != 0)
+    {
+        printf("Failed to mount exfat %s\n", dev);
+        free(g_io_buf);
+        free(g_fat_buf);
+        return 1;
+    }
+
+    printf("%8s %12s  %s\n", "frags", "size", "file");
+
+    if (pathnum > 0)
+    {
+        for (i = 1; i < argc; i++)
+        {
+            if (argv[i][0] == '-' || argv[i] == dev)
+            {
+                continue;
+            }
+
+            rc |= defrag_path(&ef, argv[i]);
+        }
+    }
+    else
+    {
+        rc = defrag_scan_dir(&ef, ef.root, "");
+    }
+
+    exfat_unmount(&ef);
+
+    printf("\nfiles: %u  fragmented: %u\n", g_file_num, g_frag_file_num);
+    if (pathnum > 0 || g_all)
+    {
+        printf("chunk count: %llu -> %llu%s\n", g_chunk_before, g_chunk_after, g_dryrun ? " (dry run)" : "");
+    }
+
+    free(g_io_buf);
+    free(g_fat_buf);
+    return rc;
+}
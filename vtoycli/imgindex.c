@@ -0,0 +1,418 @@
+/******************************************************************************
+ * imgindex.c  ---- ventoy image index util
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "vtoycli.h"
+
+/*
+ * Generate /ventoy/ventoy_img_index.dat for the mounted Ventoy partition.
+ * The layout must be the same as ventoy_img_index_xxx in grub ventoy_def.h
+ */
+
+#define IMG_INDEX_MAGIC      "VTOYIDX"
+#define IMG_INDEX_VERSION    1
+#define IMG_INDEX_FILE       "/ventoy/ventoy_img_index.dat"
+#define IMG_INDEX_DIR_IGNORE 0x00000001
+#define IMG_INDEX_ENT_DIR    0x00000001
+
+#pragma pack(1)
+
+typedef struct IMG_INDEX_HEAD
+{
+    CHAR   Magic[8];
+    UINT32 Version;
+    UINT32 HeadSize;
+    UINT32 DirNum;
+    UINT32 EntNum;
+    UINT32 StrSize;
+    UINT32 Crc32;
+    UINT8  Reserved[32];
+}IMG_INDEX_HEAD;
+
+typedef struct IMG_INDEX_DIR
+{
+    UINT32 PathOff;
+    UINT32 Flag;
+    int    Mtime;
+    UINT32 FirstEnt;
+    UINT32 EntNum;
+}IMG_INDEX_DIR;
+
+typedef struct IMG_INDEX_ENT
+{
+    UINT32 NameOff;
+    UINT32 Flag;
+    int    Mtime;
+    UINT64 Size;
+}IMG_INDEX_ENT;
+
+#pragma pack()
+
+COMPILE_ASSERT(sizeof(IMG_INDEX_HEAD) == 64);
+COMPILE_ASSERT(sizeof(IMG_INDEX_DIR) == 20);
+COMPILE_ASSERT(sizeof(IMG_INDEX_ENT) == 20);
+
+static IMG_INDEX_DIR *g_dirs = NULL;
+static UINT32 g_dir_num = 0;
+static UINT32 g_dir_max = 0;
+
+static IMG_INDEX_ENT *g_ents = NULL;
+static UINT32 g_ent_num = 0;
+static UINT32 g_ent_max = 0;
+
+static char *g_strtab = NULL;
+static UINT32 g_str_size = 0;
+static UINT32 g_str_max = 0;
+
+static int g_verbose = 0;
+
+static int grow(void **buf, UINT32 *max, UINT32 need, UINT32 unit)
+{
+    void *newbuf = NULL;
+    UINT32 newmax = *max;
+
+    if (need <= *max)
+    {
+        return 0;
+    }
+
+    while (newmax < need)
+    {
+        newmax = newmax ? newmax * 2 : 1024;
+    }
+
+    newbuf = realloc(*buf, (size_t)newmax * unit);
+    if (!newbuf)
+    {
+        printf("Failed to alloc memory\n");
+        return 1;
+    }
+
+    *buf = newbuf;
+    *max = newmax;
+    return 0;
+}
+
+static int add_str(const char *str, UINT32 *off)
+{
+    UINT32 len = (UINT32)strlen(str) + 1;
+
+    if (grow((void **)&g_strtab, &g_str_max, g_str_size + len, 1))
+    {
+        return 1;
+    }
+
+    memcpy(g_strtab + g_str_size, str, len);
+    *off = g_str_size;
+    g_str_size += len;
+    return 0;
+}
+
+static int is_img_file(const char *name)
+{
+    int len = (int)strlen(name);
+
+    if (len < 4)
+    {
+        return 0;
+    }
+
+    if (strcasecmp(name + len - 4, ".iso") == 0 ||
+        strcasecmp(name + len - 4, ".wim") == 0 ||
+        strcasecmp(name + len - 4, ".efi") == 0 ||
+        strcasecmp(name + len - 4, ".img") == 0 ||
+        strcasecmp(name + len - 4, ".vhd") == 0)
+    {
+        return 1;
+    }
+
+    if (len >= 5 && (strcasecmp(name + len - 5, ".vhdx") == 0 ||
+                     strcasecmp(name + len - 5, ".vtoy") == 0 ||
+                     strcasecmp(name + len - 5, ".vcfg") == 0))
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/* hostpath: real path on the host   path: path relative to the partition root, end with '/' */
+static int scan_dir(const char *hostpath, const char *path, int mtime)
+{
+    int rc = 0;
+    UINT32 i;
+    UINT32 first;
+    UINT32 diridx;
+    DIR *dir = NULL;
+    struct dirent *ent = NULL;
+    struct stat st;
+    char *sub = NULL;
+    char *subpath = NULL;
+
+    dir = opendir(hostpath);
+    if (!dir)
+    {
+        printf("Failed to open dir %s errno:%d\n", hostpath, errno);
+        return 1;
+    }
+
+    if (grow((void **)&g_dirs, &g_dir_max, g_dir_num + 1, sizeof(IMG_INDEX_DIR)))
+    {
+        closedir(dir);
+        return 1;
+    }
+
+    diridx = g_dir_num++;
+    memset(g_dirs + diridx, 0, sizeof(IMG_INDEX_DIR));
+    g_dirs[diridx].Mtime = mtime;
+    if (add_str(path, &g_dirs[diridx].PathOff))
+    {
+        closedir(dir);
+        return 1;
+    }
+
+    sub = malloc(4096);
+    subpath = malloc(4096);
+    if (!sub || !subpath)
+    {
+        check_free(sub);
+        check_free(subpath);
+        closedir(dir);
+        return 1;
+    }
+
+    /* entries of one dir must be contiguous, so recursion is done after the loop */
+    first = g_ent_num;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        if (strcmp(ent->d_name, ".ventoyignore") == 0)
+        {
+            g_dirs[diridx].Flag |= IMG_INDEX_DIR_IGNORE;
+            break;
+        }
+
+        snprintf(sub, 4096, "%s/%s", hostpath, ent->d_name);
+        if (lstat(sub, &st) < 0)
+        {
+            continue;
+        }
+
+        if (!S_ISDIR(st.st_mode) && !(S_ISREG(st.st_mode) && is_img_file(ent->d_name)))
+        {
+            continue;
+        }
+
+        if (grow((void **)&g_ents, &g_ent_max, g_ent_num + 1, sizeof(IMG_INDEX_ENT)))
+        {
+            rc = 1;
+            break;
+        }
+
+        memset(g_ents + g_ent_num, 0, sizeof(IMG_INDEX_ENT));
+        g_ents[g_ent_num].Flag = S_ISDIR(st.st_mode) ? IMG_INDEX_ENT_DIR : 0;
+        g_ents[g_ent_num].Mtime = (int)st.st_mtime;
+        g_ents[g_ent_num].Size = S_ISDIR(st.st_mode) ? 0 : (UINT64)st.st_size;
+        if (add_str(ent->d_name, &g_ents[g_ent_num].NameOff))
+        {
+            rc = 1;
+            break;
+        }
+        g_ent_num++;
+    }
+    closedir(dir);
+
+    if (g_dirs[diridx].Flag & IMG_INDEX_DIR_IGNORE)
+    {
+        /* the whole dir is ignored, no need to record the entries */
+        g_ent_num = first;
+    }
+
+    g_dirs[diridx].FirstEnt = first;
+    g_dirs[diridx].EntNum = g_ent_num - first;
+
+    for (i = first; rc == 0 && i < first + g_dirs[diridx].EntNum; i++)
+    {
+        if (g_ents[i].Flag & IMG_INDEX_ENT_DIR)
+        {
+            snprintf(sub, 4096, "%s/%s", hostpath, g_strtab + g_ents[i].NameOff);
+            snprintf(subpath, 4096, "%s%s/", path, g_strtab + g_ents[i].NameOff);
+            rc = scan_dir(sub, subpath, g_ents[i].Mtime);
+        }
+    }
+
+    if (g_verbose)
+    {
+        printf("%s entry:%u%s\n", path, g_dirs[diridx].EntNum,
+               (g_dirs[diridx].Flag & IMG_INDEX_DIR_IGNORE) ? " (ignore)" : "");
+    }
+
+    free(sub);
+    free(subpath);
+    return rc;
+}
+
+static int dir_cmp(const void *a, const void *b)
+{
+    const IMG_INDEX_DIR *dir1 = (const IMG_INDEX_DIR *)a;
+    const IMG_INDEX_DIR *dir2 = (const IMG_INDEX_DIR *)b;
+
+    return strcmp(g_strtab + dir1->PathOff, g_strtab + dir2->PathOff);
+}
+
+static int write_index(const char *mntpoint)
+{
+    int fd;
+    int rc = 1;
+    UINT32 size;
+    UINT8 *buf = NULL;
+    UINT8 *pos = NULL;
+    IMG_INDEX_HEAD *head = NULL;
+    char file[4096];
+
+    size = sizeof(IMG_INDEX_HEAD) + g_dir_num * sizeof(IMG_INDEX_DIR) +
+           g_ent_num * sizeof(IMG_INDEX_ENT) + g_str_size;
+
+    buf = malloc(size);
+    if (!buf)
+    {
+        printf("Failed to alloc memory %u\n", size);
+        return 1;
+    }
+
+    head = (IMG_INDEX_HEAD *)buf;
+    memset(head, 0, sizeof(IMG_INDEX_HEAD));
+    memcpy(head->Magic, IMG_INDEX_MAGIC, sizeof(IMG_INDEX_MAGIC));
+    head->Version = IMG_INDEX_VERSION;
+    head->HeadSize = sizeof(IMG_INDEX_HEAD);
+    head->DirNum = g_dir_num;
+    head->EntNum = g_ent_num;
+    head->StrSize = g_str_size;
+
+    pos = buf + sizeof(IMG_INDEX_HEAD);
+    memcpy(pos, g_dirs, g_dir_num * sizeof(IMG_INDEX_DIR));
+    pos += g_dir_num * sizeof(IMG_INDEX_DIR);
+    memcpy(pos, g_ents, g_ent_num * sizeof(IMG_INDEX_ENT));
+    pos += g_ent_num * sizeof(IMG_INDEX_ENT);
+    memcpy(pos, g_strtab, g_str_size);
+
+    head->Crc32 = ventoy_getcrc32c(0, buf + sizeof(IMG_INDEX_HEAD), (int)(size - sizeof(IMG_INDEX_HEAD)));
+
+    /*
+     * Overwrite the file in place instead of create + rename,
+     * so that the mtime of the /ventoy directory is kept unchanged.
+     */
+    snprintf(file, sizeof(file), "%s%s", mntpoint, IMG_INDEX_FILE);
+    fd = open(file, O_WRONLY | O_TRUNC);
+    if (fd < 0)
+    {
+        printf("Failed to open %s errno:%d\n", file, errno);
+        goto end;
+    }
+
+    if (write(fd, buf, size) == (ssize_t)size)
+    {
+        rc = 0;
+    }
+    else
+    {
+        printf("Failed to write %s errno:%d\n", file, errno);
+    }
+
+    fsync(fd);
+    close(fd);
+
+    printf("Image index %s dir:%u entry:%u size:%u\n", rc ? "failed" : "success", g_dir_num, g_ent_num, size);
+
+end:
+    free(buf);
+    return rc;
+}
+
+int imgindex_main(int argc, char **argv)
+{
+    int i;
+    int fd;
+    int rc;
+    const char *mntpoint = NULL;
+    struct stat st;
+    char file[4096];
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            g_verbose = 1;
+        }
+        else
+        {
+            mntpoint = argv[i];
+        }
+    }
+
+    if (!mntpoint)
+    {
+        printf("Usage: vtoycli imgindex [-v] mountpoint\n");
+        return 1;
+    }
+
+    if (stat(mntpoint, &st) < 0 || !S_ISDIR(st.st_mode))
+    {
+        printf("%s is not a directory\n", mntpoint);
+        return 1;
+    }
+
+    /* create the index file before scan, creating it later would change the mtime of /ventoy */
+    snprintf(file, sizeof(file), "%s/ventoy", mntpoint);
+    mkdir(file, 0755);
+    snprintf(file, sizeof(file), "%s%s", mntpoint, IMG_INDEX_FILE);
+    fd = open(file, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        printf("Failed to create %s errno:%d\n", file, errno);
+        return 1;
+    }
+    close(fd);
+
+    rc = scan_dir(mntpoint, "/", (int)st.st_mtime);
+    if (rc == 0)
+    {
+        qsort(g_dirs, g_dir_num, sizeof(IMG_INDEX_DIR), dir_cmp);
+        rc = write_index(mntpoint);
+    }
+
+    check_free(g_dirs);
+    check_free(g_ents);
+    check_free(g_strtab);
+    return rc;
+}
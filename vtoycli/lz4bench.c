@@ -0,0 +1,280 @@
+/******************************************************************************
+ * lz4bench.c  ---- ventoy compressed memdisk benchmark
+ *
+ * Copyright (c) 2021, longpanda <admin@ventoy.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "vtoycli.h"
+
+/*
+ * Run the VTOY_MEMDISK_COMPRESS=1 path over image files on the host:
+ * every 64KB block goes through the grub compressor (ventoy_lz4.c) and
+ * back through the Ventoy.efi decoder (VentoyLz4.c), with the same zero
+ * and raw block rules as ventoy_load_cmem in grub.
+ * Both files are built here as they are, VTOY_LZ4_HOST skips their
+ * grub/EDK2 headers and the few helpers they use are mapped below.
+ */
+
+#define VTOY_LZ4_HOST
+
+#define grub_uint8_t            uint8_t
+#define grub_uint32_t           uint32_t
+#define grub_memset             memset
+#define grub_memcpy             memcpy
+
+static inline uint32_t grub_get_unaligned32(const void *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#define INT32   int
+#define CONST   const
+#define IN
+#define OUT
+#define EFIAPI
+#define CopyMem(Dst, Src, Len)  memcpy((Dst), (Src), (Len))
+
+#include "../GRUB2/MOD_SRC/grub-2.04/grub-core/ventoy/ventoy_lz4.c"
+#include "../EDK2/edk2_mod/edk2-edk2-stable201911/MdeModulePkg/Application/Ventoy/VentoyLz4.c"
+
+#define LZ4BENCH_BLOCK_SIZE     (64 * 1024)
+#define LZ4BENCH_BOUND(n)       ((n) + (n) / 255 + 16)
+
+typedef struct LZ4BENCH_STAT
+{
+    UINT64 ImgSize;
+    UINT64 StoreSize;
+    UINT32 BlockNum;
+    UINT32 ZeroNum;
+    UINT32 RawNum;
+    UINT32 Lz4Num;
+    UINT64 CompSize;     /* bytes of the non zero blocks */
+    UINT64 Lz4Size;      /* decoded bytes of the LZ4 blocks */
+    UINT64 CompNs;
+    UINT64 DecodeNs;
+}LZ4BENCH_STAT;
+
+static UINT64 lz4bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (UINT64)ts.tv_sec * 1000000000ULL + (UINT64)ts.tv_nsec;
+}
+
+static double lz4bench_mbps(UINT64 size, UINT64 ns)
+{
+    if (ns == 0)
+    {
+        return 0.0;
+    }
+
+    return ((double)size / (1024.0 * 1024.0)) / ((double)ns / 1000000000.0);
+}
+
+static int lz4bench_is_zero(const UINT8 *data, UINT32 len)
+{
+    UINT32 i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static ssize_t lz4bench_read(int fd, UINT8 *buf, UINT32 len)
+{
+    ssize_t rc;
+    UINT32 pos = 0;
+
+    while (pos < len)
+    {
+        rc = read(fd, buf + pos, len - pos);
+        if (rc < 0)
+        {
+            return -1;
+        }
+        else if (rc == 0)
+        {
+            break;
+        }
+        pos += (UINT32)rc;
+    }
+
+    return (ssize_t)pos;
+}
+
+static void lz4bench_print(const char *name, LZ4BENCH_STAT *stat)
+{
+    printf("%s\n", name);
+    printf("  size:%llu stored:%llu ratio:%.2f%%\n", stat->ImgSize, stat->StoreSize,
+           stat->ImgSize ? (double)stat->StoreSize * 100.0 / (double)stat->ImgSize : 0.0);
+    printf("  blocks:%u zero:%u raw:%u lz4:%u\n", stat->BlockNum, stat->ZeroNum, stat->RawNum, stat->Lz4Num);
+    printf("  compress:%.1f MB/s decode:%.1f MB/s\n",
+           lz4bench_mbps(stat->CompSize, stat->CompNs),
+           lz4bench_mbps(stat->Lz4Size, stat->DecodeNs));
+}
+
+static int lz4bench_file(const char *path, UINT8 *data, UINT8 *comp, UINT8 *dec, LZ4BENCH_STAT *stat)
+{
+    int fd;
+    int clen;
+    INT32 dlen;
+    ssize_t len;
+    UINT64 t1;
+    UINT64 t2;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Failed to open %s errno:%d\n", path, errno);
+        return 1;
+    }
+
+    memset(stat, 0, sizeof(LZ4BENCH_STAT));
+
+    while ((len = lz4bench_read(fd, data, LZ4BENCH_BLOCK_SIZE)) > 0)
+    {
+        stat->BlockNum++;
+        stat->ImgSize += (UINT64)len;
+
+        if (lz4bench_is_zero(data, (UINT32)len))
+        {
+            stat->ZeroNum++;
+            continue;
+        }
+
+        t1 = lz4bench_now_ns();
+        clen = ventoy_lz4_compress(data, (int)len, comp);
+        t2 = lz4bench_now_ns();
+        stat->CompNs += t2 - t1;
+        stat->CompSize += (UINT64)len;
+
+        if (clen <= 0 || clen >= len)
+        {
+            stat->RawNum++;
+            stat->StoreSize += (UINT64)len;
+            continue;
+        }
+
+        t1 = lz4bench_now_ns();
+        dlen = ventoy_lz4_decompress(comp, (UINT32)clen, dec, LZ4BENCH_BLOCK_SIZE);
+        t2 = lz4bench_now_ns();
+        stat->DecodeNs += t2 - t1;
+
+        if (dlen != (INT32)len || memcmp(data, dec, (size_t)len) != 0)
+        {
+            printf("%s block %u decode mismatch %d %d\n", path, stat->BlockNum - 1, dlen, (int)len);
+            close(fd);
+            return 1;
+        }
+
+        stat->Lz4Num++;
+        stat->Lz4Size += (UINT64)len;
+        stat->StoreSize += (UINT64)clen;
+    }
+
+    close(fd);
+
+    if (len < 0)
+    {
+        printf("Failed to read %s errno:%d\n", path, errno);
+        return 1;
+    }
+
+    return 0;
+}
+
+int lz4bench_main(int argc, char **argv)
+{
+    int i;
+    int rc = 0;
+    UINT8 *data = NULL;
+    UINT8 *comp = NULL;
+    UINT8 *dec = NULL;
+    LZ4BENCH_STAT stat;
+    LZ4BENCH_STAT total;
+
+    if (argc < 2)
+    {
+        printf("Usage: vtoycli lz4bench file ...\n");
+        printf("  compress every 64KB block the way VTOY_MEMDISK_COMPRESS=1 does and\n");
+        printf("  report the ratio, zero/raw block count and the decode speed\n");
+        return 1;
+    }
+
+    data = malloc(LZ4BENCH_BLOCK_SIZE);
+    comp = malloc(LZ4BENCH_BOUND(LZ4BENCH_BLOCK_SIZE));
+    dec = malloc(LZ4BENCH_BLOCK_SIZE);
+    if (!data || !comp || !dec)
+    {
+        printf("Failed to alloc memory\n");
+        rc = 1;
+        goto end;
+    }
+
+    memset(&total, 0, sizeof(total));
+
+    for (i = 1; i < argc; i++)
+    {
+        if (lz4bench_file(argv[i], data, comp, dec, &stat))
+        {
+            rc = 1;
+            continue;
+        }
+
+        lz4bench_print(argv[i], &stat);
+
+        total.ImgSize += stat.ImgSize;
+        total.StoreSize += stat.StoreSize;
+        total.BlockNum += stat.BlockNum;
+        total.ZeroNum += stat.ZeroNum;
+        total.RawNum += stat.RawNum;
+        total.Lz4Num += stat.Lz4Num;
+        total.CompSize += stat.CompSize;
+        total.Lz4Size += stat.Lz4Size;
+        total.CompNs += stat.CompNs;
+        total.DecodeNs += stat.DecodeNs;
+    }
+
+    if (argc > 2)
+    {
+        lz4bench_print("total", &total);
+    }
+
+end:
+    check_free(data);
+    check_free(comp);
+    check_free(dec);
+    return rc;
+}
@@ -112,6 +112,18 @@ int main(int argc, char **argv)
     {
         return partresize_main(argc - 1, argv + 1);
     }
+    else if (strcmp(argv[1], "imgindex") == 0)
+    {
+        return imgindex_main(argc - 1, argv + 1);
+    }
+    else if (strcmp(argv[1], "defrag") == 0)
+    {
+        return defrag_main(argc - 1, argv + 1);
+    }
+    else if (strcmp(argv[1], "lz4bench") == 0)
+    {
+        return lz4bench_main(argc - 1, argv + 1);
+    }
     else
     {
         return 1;
@@ -131,6 +131,10 @@ UINT32 VtoyCrc32(VOID *Buffer, UINT32 Length);
 int vtoygpt_main(int argc, char **argv);
 int vtoyfat_main(int argc, char **argv);
 int partresize_main(int argc, char **argv);
+int imgindex_main(int argc, char **argv);
+int defrag_main(int argc, char **argv);
+int lz4bench_main(int argc, char **argv);
+UINT32 ventoy_getcrc32c(UINT32 crc, const VOID *buf, int size);
 void ventoy_gen_preudo_uuid(void *uuid);
 UINT64 get_disk_size_in_byte(const char *disk);
     